@@ -4,6 +4,22 @@
 
 #include "includes.h"
 
+/*
+ *================================================================
+ *
+ *  Constants.
+ *
+ *================================================================
+ */
+
+#define HEAP_PAGE      256            /* Slots */
+#define MAX_HEAP_PAGES ((MAX_ALARMS + HEAP_PAGE - 1) / HEAP_PAGE)
+
+/*
+ *  Enough for every alarm plus a part-filled page for each display.
+ */
+#define NUM_HEAP_PAGES (MAX_HEAP_PAGES + MAX_DISPLAYS)
+
 /*
  *================================================================
  *
@@ -12,7 +28,39 @@
  *================================================================
  */
 
-static t_LL_Header anchor = LL_EMPTY;
+/*
+ *  Alarms live in a fixed pool rather than being individually allocated
+ *  so that nothing on the steady-state path needs to touch the heap.
+ *  The pool is kept packed - removing an alarm moves the last one into
+ *  its place.
+ *
+ *  Alongside it each display has an index, a binary min-heap of its
+ *  alarms' pool entries ordered by when they next go off.  Adding,
+ *  removing or rescheduling one alarm is then O(log n) and a display's
+ *  next alarm is always at the top of its index.
+ *
+ *  However the alarms are spread over the displays there are never more
+ *  than MAX_ALARMS of them in all, so rather than each heap having room
+ *  for them all the heaps share one set of slots, handed out a page at
+ *  a time.  Position n of a heap is slot n % HEAP_PAGE of its page
+ *  n / HEAP_PAGE.
+ */
+typedef struct {
+  int    pages[MAX_HEAP_PAGES];
+  int    num_pages;
+  int    size;
+  time_t snooze_until;        /* A snoozed alarm goes off again then */
+} t_index;
+
+static t_individual_alarm alarm_pool[MAX_ALARMS];
+static int                heap_slots[NUM_HEAP_PAGES * HEAP_PAGE];
+static int                free_pages[NUM_HEAP_PAGES];
+static int                num_free_pages = 0;
+static int                pages_used = 0;    /* Ever */
+static int                num_alarms = 0;
+static t_index            indexes[MAX_DISPLAYS];
+static int                num_displays = MAX_DISPLAYS;  /* Until we know */
+static int                next_id = 1;
 
 static const char *known_days[] = {
   "Sunday",
@@ -32,7 +80,33 @@ static const char *known_days[] = {
  *================================================================
  */
 
-static void dump_alarm(t_individual_alarm *alarm);
+static void dump_alarm(const t_individual_alarm *alarm);
+
+static time_t next_trigger(const t_individual_alarm *alarm, time_t after);
+
+static int alarm_key(const t_individual_alarm *alarm);
+
+static void rebuild_index(time_t now);
+
+static int *heap_slot(const t_index *index, int position);
+
+static void grow_index(t_index *index);
+
+static void shrink_index(t_index *index);
+
+static time_t heap_time(const t_index *index, int position);
+
+static void heap_swap(t_index *index, int first, int second);
+
+static void sift_up(t_index *index, int position);
+
+static void sift_down(t_index *index, int position);
+
+static void reposition(t_index *index, int position);
+
+static const t_individual_alarm *next_alarm(int display);
+
+static void free_rule(const t_recurrence *rule);
 
 /*
  *================================================================
@@ -42,31 +116,135 @@ static void dump_alarm(t_individual_alarm *alarm);
  *================================================================
  */
 
-bool add_alarm(t_individual_alarm new_alarm) {
-
+int add_alarm(t_individual_alarm new_alarm) {
+  /*
+   * Returns the new alarm's id, or -1 if it couldn't be added.
+   */
   t_individual_alarm *alarm;
   int                 i;
-  bool                result = FALSE;
+  int                 result = -1;
+
+  t_index            *index;
 
   /*
-   *  No validation as yet.
+   *  No validation as yet, beyond the display.
    */
-  alarm = LL_Malloc(sizeof(t_individual_alarm));
-  if (alarm) {
+  if ((new_alarm.display < 0) || (new_alarm.display >= num_displays)) {
+    LOG_Error("No display %d for an alarm - there are %d.\n",
+              new_alarm.display,
+              num_displays);
+  } else if (num_alarms < MAX_ALARMS) {
+    alarm = alarm_pool + num_alarms;
+    index = indexes + new_alarm.display;
     alarm->trigger_time = new_alarm.trigger_time;
     for (i = 0; i < 7; i++) {
       alarm->days[i] = new_alarm.days[i];
     }
-    LL_AddToTail(&anchor, &alarm->header);
-    LOG_Debug("Added alarm.\n");
-    result = TRUE;
+    alarm->rule = new_alarm.rule;
+    recurrence_compile(&alarm->rule);
+    alarm->display = new_alarm.display;
+    alarm->id = next_id++;
+    alarm->skipped = 0;
+    alarm->next = next_trigger(alarm, vclock_now());
+    grow_index(index);
+    alarm->position = index->size;
+    *heap_slot(index, index->size++) = num_alarms;
+    num_alarms++;
+    sift_up(index, alarm->position);
+    QLOG_Debug(("Added alarm %d.\n", alarm->id));
+    result = alarm->id;
   } else {
-    LOG_Error("Failed to allocate memory for alarm.\n");
+    LOG_Error("Too many alarms - limit is %d.\n", MAX_ALARMS);
+  }
+  if (result == -1) {
+    free_rule(&new_alarm.rule);
   }
   return result;
 }
 
 
+bool remove_alarm(int id) {
+  t_individual_alarm *alarm;
+  int                 i;
+  t_index            *index;
+  int                 last;
+  int                 position;
+  bool                result = FALSE;
+
+  for (i = 0; i < num_alarms; i++) {
+    alarm = alarm_pool + i;
+    if (alarm->id == id) {
+      /*
+       * Out of its display's index first, replacing it with the last
+       * entry...
+       */
+      index = indexes + alarm->display;
+      position = alarm->position;
+      heap_swap(index, position, index->size - 1);
+      index->size--;
+      shrink_index(index);
+      if (position < index->size) {
+        reposition(index, position);
+      }
+      /*
+       * ...then out of the pool, likewise, along with its dates and
+       * skips.
+       */
+      free_rule(&alarm->rule);
+      last = num_alarms - 1;
+      if (i != last) {
+        alarm_pool[i] = alarm_pool[last];
+        *heap_slot(indexes + alarm_pool[i].display,
+                   alarm_pool[i].position) = i;
+      }
+      num_alarms--;
+      QLOG_Debug(("Removed alarm %d.\n", id));
+      result = TRUE;
+      break;
+    }
+  }
+  return result;
+}
+
+
+void alarms_set_displays(int count) {
+  /*
+   * The configuration can list alarms before the displays they're for,
+   * so until it's been read any display up to MAX_DISPLAYS is taken.
+   * Once the real number's known, alarms for displays beyond it would
+   * never go off - drop them, and refuse any more.
+   */
+  const t_individual_alarm *alarm;
+  int                       i;
+
+  num_displays = count;
+  for (i = num_alarms - 1; i >= 0; i--) {
+    alarm = alarm_pool + i;
+    if (alarm->display >= num_displays) {
+      LOG_Error("No display %d for alarm %d - there are %d.\n",
+                alarm->display,
+                alarm->id,
+                num_displays);
+      remove_alarm(alarm->id);
+    }
+  }
+}
+
+
+int alarm_count(void) {
+  return num_alarms;
+}
+
+
+const t_individual_alarm *alarm_at(int index) {
+  /*
+   * For walking through all the alarms.  The order is arbitrary and
+   * changes when alarms are removed.
+   */
+  return ((index >= 0) && (index < num_alarms)) ? alarm_pool + index : NULL;
+}
+
+
 int identify_alarm_day(yaml_char_t *candidate) {
   int   i;
   char *ptr;
@@ -93,31 +271,194 @@ int interpret_alarm_time(yaml_char_t *candidate) {
    */
   ptr = (char *) candidate;
   if (strchr(ptr, ':') == NULL) {
-    LOG_Debug("A number of seconds from midnight.\n");
+    QLOG_Debug(("A number of seconds from midnight.\n"));
     result = (int) strtol(ptr, NULL, 10);
   } else {
-    LOG_Debug("A formatted time.\n");
+    QLOG_Debug(("A formatted time.\n"));
     tm.tm_hour = 0;
     tm.tm_min  = 0;
     tm.tm_sec  = 0;
     strptime(ptr, "%H:%M:%S", &tm);
-    LOG_Debug("Hours %d, minutes %d, seconds %d\n",
-              tm.tm_hour, tm.tm_min, tm.tm_sec);
+    QLOG_Debug(("Hours %d, minutes %d, seconds %d\n",
+               tm.tm_hour, tm.tm_min, tm.tm_sec));
     result = (((tm.tm_hour * 60) + tm.tm_min) * 60) + tm.tm_sec;
   }
   return result;
 }
 
+bool alarms_due(time_t previous, time_t now, bool *due) {
+  /*
+   * Has any alarm (or a snooze) come due since we last looked?  due[]
+   * gets which displays it was on.  Called from the main loop on every
+   * wake-up so it must not allocate.  Each alarm which has gone off is
+   * rescheduled, so if we've been asleep for days it still only goes
+   * off once.
+   */
+  t_individual_alarm *alarm;
+  int                 display;
+  t_index            *index;
+  bool                result = FALSE;
+
+  if (now < previous) {
+    /*
+     * The clock's been put back - work everything out afresh.
+     */
+    rebuild_index(now);
+  }
+  for (display = 0; display < MAX_DISPLAYS; display++) {
+    index = indexes + display;
+    due[display] = FALSE;
+    while ((index->size > 0) && (heap_time(index, 0) <= now)) {
+      alarm = alarm_pool + *heap_slot(index, 0);
+      QLOG_Debug(("Alarm %d due.\n", alarm->id));
+      journal_fired(alarm->id, alarm->next);
+      alarm->next = next_trigger(alarm, now);
+      sift_down(index, 0);
+      due[display] = TRUE;
+    }
+    if ((index->snooze_until != 0) && (index->snooze_until <= now)) {
+      journal_fired(SNOOZE_ALARM(display), index->snooze_until);
+      index->snooze_until = 0;
+      due[display] = TRUE;
+    }
+    if (due[display]) {
+      result = TRUE;
+    }
+  }
+  return result;
+}
+
+
+int seconds_until_next_alarm(int display, time_t now) {
+  /*
+   * How long until the display's next alarm (or snooze) goes off?
+   * Returns -1 if there's nothing to go off at all.
+   */
+  t_index *index;
+  time_t   next = ALARM_NEVER;
+  int      result = -1;
+
+  index = indexes + display;
+  if (index->size > 0) {
+    next = heap_time(index, 0);
+  }
+  if ((index->snooze_until != 0) && (index->snooze_until < next)) {
+    next = index->snooze_until;
+  }
+  if (next != ALARM_NEVER) {
+    result = (next > now) ? (int) (next - now) : 0;
+  }
+  return result;
+}
+
+
+int next_alarm_id(int display) {
+  /*
+   * Which of the display's alarms goes off next?  -1 if none will.
+   */
+  const t_individual_alarm *alarm;
+
+  alarm = next_alarm(display);
+  return (alarm != NULL) ? alarm->id : -1;
+}
+
+
+bool skip_next_alarm(int display) {
+  /*
+   * Dismiss the display's next alarm before it goes off.  It moves on
+   * to the occurrence after.
+   */
+  t_individual_alarm *alarm;
+  t_index            *index;
+  bool                result = FALSE;
+
+  index = indexes + display;
+  if (next_alarm(display) != NULL) {
+    alarm = alarm_pool + *heap_slot(index, 0);
+    QLOG_Debug(("Skipping alarm %d.\n", alarm->id));
+    journal_skip(alarm_key(alarm), alarm->next);
+    alarm->skipped = alarm->next;
+    alarm->next = next_trigger(alarm, alarm->next);
+    sift_down(index, 0);
+    result = TRUE;
+  }
+  return result;
+}
+
+
+void snooze_alarm(int display, time_t until) {
+  journal_snooze(display, until);
+  indexes[display].snooze_until = until;
+}
+
+
+bool cancel_snooze(int display) {
+  /*
+   * Returns TRUE if there was a snooze to cancel.
+   */
+  bool result;
+
+  result = (indexes[display].snooze_until != 0);
+  if (result) {
+    journal_snooze(display, 0);
+    indexes[display].snooze_until = 0;
+  }
+  return result;
+}
+
+
+/*
+ *  For putting things back as they were from the state journal.  None
+ *  of these is journalled itself.
+ */
+
+bool restore_skip(int key, time_t occurrence) {
+  /*
+   * Skips are journalled against the alarm's key rather than its id,
+   * which only says what order the alarms were loaded in.  FALSE if no
+   * alarm with the key still goes off at that time, in which case the
+   * skip no longer means anything.
+   */
+  t_individual_alarm *alarm;
+  int                 i;
+  bool                result = FALSE;
+
+  for (i = 0; (i < num_alarms) && !result; i++) {
+    alarm = alarm_pool + i;
+    if ((alarm->skipped == 0) &&
+        (alarm_key(alarm) == key) &&
+        (next_trigger(alarm, occurrence - 1) == occurrence)) {
+      alarm->skipped = occurrence;
+      result = TRUE;
+    }
+  }
+  return result;
+}
+
+
+void restore_snooze(int display, time_t until) {
+  indexes[display].snooze_until = until;
+}
+
+
+void resume_alarms(time_t from) {
+  /*
+   * Work out every alarm's next time afresh, as if we'd last looked
+   * at the given time.  Anything due since then goes off at the next
+   * check.
+   */
+  rebuild_index(from);
+}
+
+
 void dump_alarms(void) {
   /*
    * List all known alarms for debug purposes.
    */
-  t_individual_alarm *current;
+  int i;
 
-  current = LL_FirstItem(&anchor);
-  while (current != NULL) {
-    dump_alarm(current);
-    current = LL_NextItem(&anchor, &current->header);
+  for (i = 0; i < num_alarms; i++) {
+    dump_alarm(alarm_pool + i);
   }
 }
 
@@ -129,13 +470,214 @@ void dump_alarms(void) {
  *================================================================
  */
 
-static void dump_alarm(t_individual_alarm *alarm) {
+static void dump_alarm(const t_individual_alarm *alarm) {
   int i;
 
-  LOG_Debug("Alarm at %d\n", alarm->trigger_time);
+  QLOG_Debug(("Alarm %d at %d on display %d\n",
+              alarm->id,
+              alarm->trigger_time,
+              alarm->display));
+  if (alarm->rule.kind == rk_weekly) {
+    for (i = 0; i < 7; i++) {
+      if (alarm->days[i]) {
+        QLOG_Debug(("  %s\n", known_days[i]));
+      }
+    }
+  }
+  dump_recurrence(&alarm->rule);
+}
+
+static time_t next_trigger(const t_individual_alarm *alarm, time_t after) {
+  /*
+   * When will this alarm next go off, strictly after the given time?
+   * The rule gives the day and the zone cache turns that into a time,
+   * so this is arithmetic apart from the first call after the cache
+   * has run out.  One occurrence may have been dismissed in advance
+   * and is stepped over.  See zone.h for what happens when the clocks
+   * change.
+   */
+  time_t candidate;
+  int    day;
+  int    from;
+  time_t result = ALARM_NEVER;
+  int    seconds;
+  int    today;
+
+  zone_local(after, &today, &seconds);
+  from = (alarm->trigger_time > seconds) ? today : today + 1;
+  do {
+    day = recurrence_next_day(&alarm->rule, alarm->days, from);
+    if (day != NO_DAY) {
+      /*
+       * On the day the clocks go back, the first time round may
+       * already have gone by.
+       */
+      candidate = zone_utc(day, alarm->trigger_time);
+      if ((candidate > after) && (candidate != alarm->skipped)) {
+        result = candidate;
+      }
+      from = day + 1;
+    }
+  } while ((day != NO_DAY) && (result == ALARM_NEVER));
+  return result;
+}
+
+static int alarm_key(const t_individual_alarm *alarm) {
+  /*
+   * What an alarm is known by across restarts - a hash of everything
+   * which decides when and where it goes off.  Alarms which are exactly
+   * alike share a key.
+   */
+  unsigned long hash = HASH_START;
+  int           i;
+
+  hash = hash_fold(hash, alarm->trigger_time);
   for (i = 0; i < 7; i++) {
-    if (alarm->days[i]) {
-      LOG_Debug("  %s\n", known_days[i]);
+    hash = hash_fold(hash, alarm->days[i]);
+  }
+  hash = hash_fold(hash, alarm->display);
+  hash = recurrence_hash(&alarm->rule, hash);
+  return (int) (hash & 0x7fffffffUL);
+}
+
+static void rebuild_index(time_t now) {
+  int      display;
+  int      i;
+  t_index *index;
+
+  for (i = 0; i < num_alarms; i++) {
+    alarm_pool[i].next = next_trigger(alarm_pool + i, now);
+  }
+  for (display = 0; display < MAX_DISPLAYS; display++) {
+    index = indexes + display;
+    for (i = (index->size / 2) - 1; i >= 0; i--) {
+      sift_down(index, i);
+    }
+  }
+}
+
+/*
+ *  Heap maintenance.  Each pool entry records its position in its
+ *  display's heap so that it can be found again when removed or
+ *  rescheduled.
+ */
+
+static int *heap_slot(const t_index *index, int position) {
+  return heap_slots +
+         (index->pages[position / HEAP_PAGE] * HEAP_PAGE) +
+         (position % HEAP_PAGE);
+}
+
+static void grow_index(t_index *index) {
+  /*
+   * Make sure there's a slot for one more.  A page which has been given
+   * back is used again before a new one.
+   */
+  if (index->size == index->num_pages * HEAP_PAGE) {
+    if (num_free_pages > 0) {
+      index->pages[index->num_pages++] = free_pages[--num_free_pages];
+    } else {
+      index->pages[index->num_pages++] = pages_used++;
+    }
+  }
+}
+
+static void shrink_index(t_index *index) {
+  /*
+   * Give back the last page once nothing's in it.
+   */
+  if (index->size <= (index->num_pages - 1) * HEAP_PAGE) {
+    free_pages[num_free_pages++] = index->pages[--index->num_pages];
+  }
+}
+
+static time_t heap_time(const t_index *index, int position) {
+  return alarm_pool[*heap_slot(index, position)].next;
+}
+
+static void heap_swap(t_index *index, int first, int second) {
+  int *first_slot;
+  int  held;
+  int *second_slot;
+
+  first_slot = heap_slot(index, first);
+  second_slot = heap_slot(index, second);
+  held = *first_slot;
+  *first_slot = *second_slot;
+  *second_slot = held;
+  alarm_pool[*first_slot].position = first;
+  alarm_pool[*second_slot].position = second;
+}
+
+static void sift_up(t_index *index, int position) {
+  int parent;
+
+  while (position > 0) {
+    parent = (position - 1) / 2;
+    if (heap_time(index, parent) <= heap_time(index, position)) {
+      break;
+    }
+    heap_swap(index, parent, position);
+    position = parent;
+  }
+}
+
+static void sift_down(t_index *index, int position) {
+  int child;
+
+  while (TRUE) {
+    child = (position * 2) + 1;
+    if (child >= index->size) {
+      break;
+    }
+    if ((child + 1 < index->size) &&
+        (heap_time(index, child + 1) < heap_time(index, child))) {
+      child++;
+    }
+    if (heap_time(index, position) <= heap_time(index, child)) {
+      break;
+    }
+    heap_swap(index, position, child);
+    position = child;
+  }
+}
+
+static void reposition(t_index *index, int position) {
+  /*
+   * The entry here has changed - move it whichever way it needs to go.
+   */
+  int entry;
+
+  entry = *heap_slot(index, position);
+  sift_up(index, position);
+  sift_down(index, alarm_pool[entry].position);
+}
+
+static const t_individual_alarm *next_alarm(int display) {
+  /*
+   * The display's next alarm, or NULL if none will go off.
+   */
+  const t_index            *index;
+  const t_individual_alarm *result = NULL;
+
+  index = indexes + display;
+  if ((index->size > 0) && (heap_time(index, 0) != ALARM_NEVER)) {
+    result = alarm_pool + *heap_slot(index, 0);
+  }
+  return result;
+}
+
+static void free_rule(const t_recurrence *rule) {
+  /*
+   * Give back a rule's share of the recurrence pools - otherwise a
+   * clock whose alarms come and go over the control socket would
+   * eventually run out.
+   */
+  int i;
+
+  if (recurrence_release(rule)) {
+    for (i = 0; i < num_alarms; i++) {
+      recurrence_relocate(&alarm_pool[i].rule, rule);
     }
   }
 }
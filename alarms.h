@@ -1,4 +1,28 @@
 
+/*
+ *================================================================
+ *
+ *  Constants.
+ *
+ *================================================================
+ */
+
+/*
+ *  Enough for an imported rota (see import.h).  It's a fixed pool, so
+ *  build with a bigger one if you need to.
+ */
+#if !defined MAX_ALARMS
+#define MAX_ALARMS 16384
+#endif
+
+#define ALARM_NEVER ((time_t) LONG_MAX)   /* Next time for one with no days */
+
+/*
+ *  What's journalled as having gone off when a display's snooze runs
+ *  out, in place of an alarm id.
+ */
+#define SNOOZE_ALARM(display) (-1 - (display))
+
 /*
  *================================================================
  *
@@ -8,9 +32,17 @@
  */
 
 typedef struct {
-  t_LL_Header header;
-  int         trigger_time;    /* Seconds since midnight */
-  bool        days[7];        /* 0 = Sunday, etc. */
+  int          trigger_time;  /* Seconds since midnight */
+  bool         days[7];       /* 0 = Sunday, etc. */
+  t_recurrence rule;          /* Which days, beyond the days of the week */
+  int          display;       /* Which display it belongs to */
+  /*
+   * Filled in by add_alarm().
+   */
+  int          id;
+  time_t       next;          /* When it will next go off */
+  time_t       skipped;       /* An occurrence dismissed in advance */
+  int          position;      /* In its display's index */
 } t_individual_alarm;
 
 /*
@@ -21,10 +53,36 @@ typedef struct {
  *================================================================
  */
 
-extern bool add_alarm(t_individual_alarm new_alarm);
+extern int add_alarm(t_individual_alarm new_alarm);
+
+extern bool remove_alarm(int id);
+
+extern void alarms_set_displays(int count);
+
+extern int alarm_count(void);
+
+extern const t_individual_alarm *alarm_at(int index);
 
 extern int identify_alarm_day(yaml_char_t *candidate);
 
 extern int interpret_alarm_time(yaml_char_t *candidate);
 
+extern bool alarms_due(time_t previous, time_t now, bool *due);
+
+extern int seconds_until_next_alarm(int display, time_t now);
+
+extern int next_alarm_id(int display);
+
+extern bool skip_next_alarm(int display);
+
+extern void snooze_alarm(int display, time_t until);
+
+extern bool cancel_snooze(int display);
+
+extern bool restore_skip(int key, time_t occurrence);
+
+extern void restore_snooze(int display, time_t until);
+
+extern void resume_alarms(time_t from);
+
 extern void dump_alarms(void);
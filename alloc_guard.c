@@ -0,0 +1,189 @@
+/*
+ *  Interposes malloc() and friends so that the ALLOC_GUARD build can
+ *  count every heap allocation made by the process - including those
+ *  made inside SDL, SDL_ttf and the graphics driver - and complain if
+ *  any happen on a steady-state path.
+ *
+ *  Only linked into the "alloccheck" build.  Relies on glibc exporting
+ *  its own allocator as __libc_malloc() and friends.
+ */
+
+#include "includes.h"
+
+#if defined ALLOC_GUARD
+
+/*
+ *================================================================
+ *
+ *  Constants.
+ *
+ *================================================================
+ */
+
+#define MAX_PATHS 8
+
+/*
+ *================================================================
+ *
+ *  Type definitions.
+ *
+ *================================================================
+ */
+
+typedef struct {
+  const char *path;
+  int         passes;
+} t_path_record;
+
+/*
+ *================================================================
+ *
+ *  Local data.
+ *
+ *================================================================
+ */
+
+static unsigned long allocations = 0;
+static unsigned long releases = 0;
+
+static unsigned long allocations_at_start;
+static unsigned long releases_at_start;
+
+static unsigned long allocations_at_pause;
+static unsigned long releases_at_pause;
+
+/*
+ *  Keyed on the address of the path name, which is always a literal.
+ */
+static t_path_record paths[MAX_PATHS];
+static int           num_paths = 0;
+
+/*
+ *================================================================
+ *
+ *  External declarations.
+ *
+ *================================================================
+ */
+
+extern void *__libc_malloc(size_t size);
+
+extern void *__libc_calloc(size_t nmemb, size_t size);
+
+extern void *__libc_realloc(void *ptr, size_t size);
+
+extern void __libc_free(void *ptr);
+
+/*
+ *================================================================
+ *
+ *  Forward declarations.
+ *
+ *================================================================
+ */
+
+static t_path_record *find_path(const char *path);
+
+/*
+ *================================================================
+ *
+ *  Interposed allocator.
+ *
+ *================================================================
+ */
+
+void *malloc(size_t size) {
+  __sync_fetch_and_add(&allocations, 1);
+  return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size) {
+  __sync_fetch_and_add(&allocations, 1);
+  return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+  __sync_fetch_and_add(&allocations, 1);
+  return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr) {
+  if (ptr != NULL) {
+    __sync_fetch_and_add(&releases, 1);
+  }
+  __libc_free(ptr);
+}
+
+/*
+ *================================================================
+ *
+ *  Externally visible routines.
+ *
+ *================================================================
+ */
+
+void alloc_guard_begin(void) {
+  allocations_at_start = allocations;
+  releases_at_start = releases;
+}
+
+void alloc_guard_end(const char *path) {
+  unsigned long  allocated;
+  t_path_record *record;
+  unsigned long  released;
+
+  allocated = allocations - allocations_at_start;
+  released = releases - releases_at_start;
+  record = find_path(path);
+  if (record == NULL) {
+    LOG_Warning("Too many guarded paths - not checking \"%s\".\n", path);
+  } else if (record->passes < ALLOC_GUARD_WARMUP) {
+    record->passes++;
+  } else if ((allocated != 0) || (released != 0)) {
+    LOG_Error("Path \"%s\" made %lu allocations and %lu frees.\n",
+              path, allocated, released);
+    assert((allocated == 0) && (released == 0));
+  }
+}
+
+void alloc_guard_pause(void) {
+  allocations_at_pause = allocations;
+  releases_at_pause = releases;
+}
+
+void alloc_guard_resume(void) {
+  /*
+   * Whatever happened while paused isn't counted against the path.
+   */
+  allocations_at_start += allocations - allocations_at_pause;
+  releases_at_start += releases - releases_at_pause;
+}
+
+/*
+ *================================================================
+ *
+ *  Local routines.
+ *
+ *================================================================
+ */
+
+static t_path_record *find_path(const char *path) {
+  int            i;
+  t_path_record *result = NULL;
+
+  for (i = 0; i < num_paths; i++) {
+    if (paths[i].path == path) {
+      result = paths + i;
+      break;
+    }
+  }
+  if ((result == NULL) && (num_paths < MAX_PATHS)) {
+    result = paths + num_paths;
+    result->path = path;
+    result->passes = 0;
+    num_paths++;
+  }
+  return result;
+}
+
+#endif
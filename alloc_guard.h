@@ -0,0 +1,53 @@
+/*
+ *  Heap allocation checking for the ALLOC_GUARD build.
+ *
+ *  In the normal build the macros vanish entirely.  In the ALLOC_GUARD
+ *  build (make alloccheck) malloc() and friends are interposed and any
+ *  allocation between ALLOC_GUARD_BEGIN() and ALLOC_GUARD_END() - once
+ *  the named path has warmed up - is reported and aborts the program.
+ *  Work which is allowed to allocate, but only ever happens a bounded
+ *  number of times, can be left out of a guarded path by putting it
+ *  between ALLOC_GUARD_PAUSE() and ALLOC_GUARD_RESUME().
+ */
+
+#if defined ALLOC_GUARD
+
+/*
+ *================================================================
+ *
+ *  Constants.
+ *
+ *================================================================
+ */
+
+#define ALLOC_GUARD_WARMUP 2     /* Passes allowed to allocate */
+
+/*
+ *================================================================
+ *
+ *  External declarations.
+ *
+ *================================================================
+ */
+
+extern void alloc_guard_begin(void);
+
+extern void alloc_guard_end(const char *path);
+
+extern void alloc_guard_pause(void);
+
+extern void alloc_guard_resume(void);
+
+#define ALLOC_GUARD_BEGIN()    alloc_guard_begin()
+#define ALLOC_GUARD_END(path)  alloc_guard_end(path)
+#define ALLOC_GUARD_PAUSE()    alloc_guard_pause()
+#define ALLOC_GUARD_RESUME()   alloc_guard_resume()
+
+#else
+
+#define ALLOC_GUARD_BEGIN()
+#define ALLOC_GUARD_END(path)  ((void) (path))
+#define ALLOC_GUARD_PAUSE()
+#define ALLOC_GUARD_RESUME()
+
+#endif
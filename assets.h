@@ -0,0 +1,36 @@
+/*
+ *  Assets built into the binary.  At build time embed (see embed.c and
+ *  the Makefile) decodes the bundled menu icon and alarm sound and
+ *  writes them out as assets.c, so at start-up there's no PNG or Ogg
+ *  decoding to do and nothing to find in the working directory.
+ *
+ *  The icon is in MENU_PIXEL_FORMAT, ready for SDL_UpdateTexture().
+ *  The sound is PCM at AUDIO_FREQUENCY, MIX_DEFAULT_FORMAT and
+ *  AUDIO_CHANNELS (see sound.h), ready for Mix_QuickLoad_RAW().
+ */
+
+/*
+ *================================================================
+ *
+ *  Constants.
+ *
+ *================================================================
+ */
+
+#define MENU_PIXEL_FORMAT SDL_PIXELFORMAT_ARGB8888
+#define MENU_PIXEL_BYTES  4
+
+/*
+ *================================================================
+ *
+ *  External declarations.
+ *
+ *================================================================
+ */
+
+extern const int           builtin_menu_width;
+extern const int           builtin_menu_height;
+extern const unsigned char builtin_menu_pixels[];
+
+extern const long          builtin_alarm_length;     /* Bytes */
+extern const short         builtin_alarm_pcm[];
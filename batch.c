@@ -0,0 +1,257 @@
+/*
+ *  Draw-call batching.  See batch.h.
+ */
+
+#define NEED_SDL
+#include "includes.h"
+
+/*
+ *================================================================
+ *
+ *  Constants.
+ *
+ *================================================================
+ */
+
+#define MAX_VERTICES 4096
+#define MAX_INDICES  6144
+#define MAX_PIECES   512
+#define MAX_TEXTURES 16
+
+/*
+ *================================================================
+ *
+ *  Type definitions.
+ *
+ *================================================================
+ */
+
+typedef struct {
+  int texture;                /* Index into textures */
+  int first_vertex;
+  int first_index;
+  int num_indices;
+} t_piece;
+
+/*
+ *================================================================
+ *
+ *  Local data.
+ *
+ *================================================================
+ */
+
+static SDL_Renderer *batch_renderer = NULL;
+
+static SDL_Vertex   vertices[MAX_VERTICES];
+static int          num_vertices = 0;
+static int          indices[MAX_INDICES];
+static int          num_indices = 0;
+static t_piece      pieces[MAX_PIECES];
+static int          num_pieces = 0;
+static SDL_Texture *textures[MAX_TEXTURES];
+static int          num_textures = 0;
+
+static const int quad_indices[6] = { 0, 1, 2, 2, 1, 3 };
+
+/*
+ *  Where each texture's triangles are gathered before they're drawn.
+ */
+static int gathered[MAX_INDICES];
+
+static int      frame_calls = 0;
+static t_metric calls_metric = NO_METRIC;
+static t_metric frames_metric = NO_METRIC;
+static t_metric pieces_metric = NO_METRIC;
+
+/*
+ *================================================================
+ *
+ *  Forward declarations.
+ *
+ *================================================================
+ */
+
+static bool make_room(int more_vertices, int more_indices);
+
+static int texture_slot(SDL_Texture *texture);
+
+/*
+ *================================================================
+ *
+ *  Externally visible routines.
+ *
+ *================================================================
+ */
+
+void batch_begin(SDL_Renderer *renderer) {
+  if (calls_metric == NO_METRIC) {
+    calls_metric = metric_register("draw calls");
+    frames_metric = metric_register("batched frames");
+    pieces_metric = metric_register("batched pieces");
+  }
+  batch_renderer = renderer;
+  num_vertices = 0;
+  num_indices = 0;
+  num_pieces = 0;
+  num_textures = 0;
+  frame_calls = 0;
+}
+
+void batch_copy(
+    SDL_Texture    *texture,
+    t_box           texture_size,
+    const SDL_Rect *source,
+    const SDL_Rect *dest,
+    int             density) {
+  /*
+   * Like SDL_RenderCopy() with the texture's colour modulated by
+   * density - but later.  A NULL source is the whole texture.
+   */
+  int        i;
+  SDL_Vertex quad[4];
+  SDL_Rect   whole;
+
+  if (source == NULL) {
+    whole.x = 0;
+    whole.y = 0;
+    whole.w = texture_size.width;
+    whole.h = texture_size.height;
+    source = &whole;
+  }
+  for (i = 0; i < 4; i++) {
+    quad[i].position.x = dest->x + ((i & 1) ? dest->w : 0);
+    quad[i].position.y = dest->y + ((i & 2) ? dest->h : 0);
+    quad[i].tex_coord.x = (float) (source->x + ((i & 1) ? source->w : 0)) /
+                          texture_size.width;
+    quad[i].tex_coord.y = (float) (source->y + ((i & 2) ? source->h : 0)) /
+                          texture_size.height;
+    quad[i].color.r = density;
+    quad[i].color.g = density;
+    quad[i].color.b = density;
+    quad[i].color.a = 255;
+  }
+  batch_geometry(texture, quad, 4, quad_indices, 6);
+}
+
+void batch_geometry(
+    SDL_Texture      *texture,
+    const SDL_Vertex *new_vertices,
+    int               new_num_vertices,
+    const int        *new_indices,
+    int               new_num_indices) {
+  /*
+   * Like SDL_RenderGeometry() - indices are into new_vertices - but
+   * later.  texture may be NULL for plain triangles.
+   */
+  int      i;
+  t_piece *piece;
+  int      slot;
+
+  if (make_room(new_num_vertices, new_num_indices)) {
+    slot = texture_slot(texture);
+    piece = pieces + num_pieces++;
+    piece->texture = slot;
+    piece->first_vertex = num_vertices;
+    piece->first_index = num_indices;
+    piece->num_indices = new_num_indices;
+    memcpy(vertices + num_vertices,
+           new_vertices,
+           new_num_vertices * sizeof(SDL_Vertex));
+    for (i = 0; i < new_num_indices; i++) {
+      indices[num_indices++] = new_indices[i];
+    }
+    num_vertices += new_num_vertices;
+  }
+}
+
+void batch_flush(void) {
+  /*
+   * Draw everything collected so far - one call per texture.  Each
+   * piece's indices are made relative to the whole vertex array as
+   * they're gathered.
+   */
+  int      count;
+  int      i;
+  int      j;
+  t_piece *piece;
+  int      slot;
+
+  for (slot = 0; slot < num_textures; slot++) {
+    count = 0;
+    for (i = 0; i < num_pieces; i++) {
+      piece = pieces + i;
+      if (piece->texture == slot) {
+        for (j = 0; j < piece->num_indices; j++) {
+          gathered[count++] = piece->first_vertex +
+                              indices[piece->first_index + j];
+        }
+      }
+    }
+    if (count > 0) {
+      SDL_RenderGeometry(batch_renderer, textures[slot],
+                         vertices, num_vertices,
+                         gathered, count);
+      frame_calls++;
+    }
+  }
+  metric_add(pieces_metric, num_pieces);
+  num_vertices = 0;
+  num_indices = 0;
+  num_pieces = 0;
+  num_textures = 0;
+}
+
+void batch_end(void) {
+  batch_flush();
+  metric_add(calls_metric, frame_calls);
+  metric_add(frames_metric, 1);
+  QLOG_Debug(("Frame took %d draw calls.\n", frame_calls));
+}
+
+/*
+ *================================================================
+ *
+ *  Local routines.
+ *
+ *================================================================
+ */
+
+static bool make_room(int more_vertices, int more_indices) {
+  /*
+   * If this lot won't fit, draw what we've got to make space.
+   * Returns FALSE if it won't fit even then.
+   */
+  bool result = TRUE;
+
+  if ((more_vertices > MAX_VERTICES) || (more_indices > MAX_INDICES)) {
+    QLOG_Warning(("Too much geometry to batch - %d vertices.\n",
+                  more_vertices));
+    result = FALSE;
+  } else if ((num_vertices + more_vertices > MAX_VERTICES) ||
+             (num_indices + more_indices > MAX_INDICES) ||
+             (num_pieces == MAX_PIECES)) {
+    batch_flush();
+  }
+  return result;
+}
+
+
+static int texture_slot(SDL_Texture *texture) {
+  int result;
+
+  for (result = 0; result < num_textures; result++) {
+    if (textures[result] == texture) {
+      break;
+    }
+  }
+  if (result == num_textures) {
+    if (num_textures == MAX_TEXTURES) {
+      batch_flush();
+      result = 0;
+    }
+    textures[result] = texture;
+    num_textures = result + 1;
+  }
+  return result;
+}
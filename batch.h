@@ -0,0 +1,44 @@
+/*
+ *  Draw-call batching.  Everything painted during a frame is collected
+ *  here as triangles and handed to the renderer one texture at a time,
+ *  so that a screenful of glyphs from one atlas costs a single
+ *  SDL_RenderGeometry() call rather than one copy per character.
+ *
+ *  Textures are drawn in the order each was first used in the frame.
+ *  That keeps the painter's order for everything we draw, where one
+ *  texture's quads don't overlap another's.  Anything drawn directly
+ *  must call batch_flush() first so that it goes on top of what's
+ *  been batched so far.
+ *
+ *  Render thread only.
+ */
+
+/*
+ *================================================================
+ *
+ *  External declarations.
+ *
+ *================================================================
+ */
+
+#if defined NEED_SDL
+extern void batch_begin(SDL_Renderer *renderer);
+
+extern void batch_copy(
+    SDL_Texture    *texture,
+    t_box           texture_size,
+    const SDL_Rect *source,
+    const SDL_Rect *dest,
+    int             density);
+
+extern void batch_geometry(
+    SDL_Texture      *texture,
+    const SDL_Vertex *vertices,
+    int               num_vertices,
+    const int        *indices,
+    int               num_indices);
+
+extern void batch_flush(void);
+
+extern void batch_end(void);
+#endif
@@ -5,6 +5,74 @@
 #define NEED_SDL
 #include "includes.h"
 
+/*
+ *================================================================
+ *
+ *  Constants.
+ *
+ *================================================================
+ */
+
+#define MAX_TEXT_LEN 80
+
+/*
+ *  Wake a little after each boundary rather than exactly on it so
+ *  that time() has definitely ticked over.
+ */
+#define WAKE_MARGIN_MS 5
+
+/*
+ *  How often to check whether the alarm sound has finished.
+ */
+#define SOUND_POLL_MS 1000
+
+#define STARTUP_WORKERS 2
+
+/*
+ *  While dimmed the time drifts slowly about the screen rather than
+ *  sitting in one place.  Its position is kept as a fraction of the
+ *  room there is to move in, so that it doesn't depend on how wide
+ *  the current time happens to be.
+ */
+#define DRIFT_SCALE 1000
+
+/*
+ *  The analogue dial's size as a percentage of the screen height, and
+ *  its numerals' point size as a fraction of its diameter.  Dimmed, it
+ *  shrinks to half size.
+ */
+#define DIAL_PERCENT  75
+#define NUMERAL_SCALE 10
+
+/*
+ *================================================================
+ *
+ *  Type definitions.
+ *
+ *================================================================
+ */
+
+/*
+ *  One panel of a clock wall - or the only one.  Each has its own
+ *  window, renderer and alarms, and dims and brightens on its own.
+ *  Fonts, images and the alarm sound are shared between them all.
+ */
+typedef struct {
+  int           number;       /* Its place in the displays section */
+  SDL_Window   *window;
+  SDL_Renderer *renderer;
+  Uint32        window_id;    /* To match input events up with it */
+  bool          dimmed;
+  bool          sounding;
+  time_t        last_touched;
+  bool          repaint;      /* In the frame being put together */
+  t_tween       fade;         /* Brightness on the way in or out of dim */
+  t_tween       sunrise;      /* Brightness leading up to an alarm */
+  t_tween       drift_x;      /* Dimmed time's position - see DRIFT_SCALE */
+  t_tween       drift_y;
+  t_tween       sweep;        /* Second hand, in 1/fps of a second */
+} t_display;
+
 /*
  *================================================================
  *
@@ -13,7 +81,15 @@
  *================================================================
  */
 
-static SDL_Renderer *renderer;
+static t_display displays[MAX_DISPLAYS];
+static int       num_displays = 0;
+
+static bool headless = FALSE;
+
+static bool running = TRUE;
+static bool analog = FALSE;
+
+static t_status status;       /* As last published - for the first display */
 
 /*
  *================================================================
@@ -23,6 +99,91 @@ static SDL_Renderer *renderer;
  *================================================================
  */
 
+static bool parse_options(
+    int          argc,
+    char        *argv[],
+    const char **record_name,
+    const char **replay_name,
+    bool        *fast);
+
+static void start_up(void);
+
+static void open_display(t_display *display);
+
+static void load_config(void *unused);
+
+static void load_large_font(void *next_job);
+
+static void load_other_fonts(void *unused);
+
+static void load_images(void *unused);
+
+static void load_sound(void *unused);
+
+static void register_handlers(void);
+
+static int wait_for_event(SDL_Event *event, int timeout);
+
+static int poll_event(SDL_Event *event);
+
+static bool quit_event(SDL_Event *event);
+
+static bool key_event(SDL_Event *event);
+
+static bool touch_event(SDL_Event *event);
+
+static t_display *find_display(Uint32 window_id);
+
+static bool snooze(void);
+
+static bool dismiss(void);
+
+static bool dim_all(bool dim);
+
+static bool set_dimmed(t_display *display, bool dim);
+
+static void manage_sound(time_t now);
+
+static bool manage_display(
+    t_display *display,
+    time_t     now,
+    bool       new_minute,
+    bool       due);
+
+static bool animating(const t_display *display);
+
+static void init_animations(t_display *display);
+
+static int current_level(const t_display *display);
+
+static void manage_sunrise(t_display *display, time_t now);
+
+static void move_dimmed_time(t_display *display, bool new_minute);
+
+static void start_sweep(t_display *display);
+
+static int dial_size(const t_display *display);
+
+static int drift_offset(const t_tween *tween, int room);
+
+static void publish_status(time_t now);
+
+static int wait_time(void);
+
+static int display_wait_time(
+    const t_display       *display,
+    const struct timespec *now,
+    int                    ms_into_second);
+
+static int shorter(int current, int candidate);
+
+static void paint_displays(time_t now);
+
+static void compose_screen(t_display *display, const struct tm *tm);
+
+static void format_date(char *buffer, int size, const struct tm *tm);
+
+static const char *ordinal_suffix(int number);
 
 /*
  *================================================================
@@ -32,32 +193,145 @@ static SDL_Renderer *renderer;
  *================================================================
  */
 
-int main(void) {
-  SDL_Window   *window;
+int main(int argc, char *argv[]) {
+  bool          alarm;
+  t_display    *display;
+  bool          due[MAX_DISPLAYS];
+  SDL_Event     event;
+  bool          fast = FALSE;
+  int           i;
+  bool          improved;
+  time_t        last_checked;
+  bool          new_minute;
+  time_t        now;
+  const char   *path;
+  const char   *record_name = NULL;
+  bool          repaint;
+  const char   *replay_name = NULL;
 
-  parse_config();
-  dump_settings();
-  printf("Hello, World!\n");
-  SDL_Init(SDL_INIT_EVERYTHING);
-  TTF_Init();
-  init_fonts();
-  window = SDL_CreateWindow("Banana",
-                            SDL_WINDOWPOS_CENTERED,
-                            SDL_WINDOWPOS_CENTERED,
-                            1024,
-                            600,
-                            SDL_WINDOW_FULLSCREEN);
-  init_images(window);
-  renderer = SDL_CreateRenderer(window, -1, 0);
-  SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-  SDL_RenderFillRect(renderer, NULL);
-  paint_text(renderer, "Hello!", f_large, h_centre, v_middle, 0, 0, 200);
-  paint_menu(renderer);
-  SDL_RenderPresent(renderer);
-  SDL_ShowCursor(0);
-  sleep(5);
-  SDL_DestroyRenderer(renderer);
-  SDL_DestroyWindow(window);
+  if (!parse_options(argc, argv, &record_name, &replay_name, &fast)) {
+    return 1;
+  }
+  startup_begin();
+  qlog_init();
+  vclock_init();
+  if (((record_name != NULL) && !record_start(record_name)) ||
+      ((replay_name != NULL) && !replay_start(replay_name, fast))) {
+    return 1;
+  }
+  latency_init();
+  quality_init();
+  /*
+   * Everything which allocates is done up front.  From here on the
+   * main loop should be able to run for months without touching
+   * the heap.
+   */
+  start_up();
+  now = vclock_now();
+  last_checked = now;
+  startup_report(get_startup_budget());
+  if (!replaying()) {
+    watchdog_start();
+  }
+  while (running) {
+    path = "minute repaint";
+    watchdog_phase(wp_waiting);
+    if (wait_for_event(&event, wait_time())) {
+      watchdog_phase(wp_events);
+      tween_sample();
+      do {
+        if (despatch(&event)) {
+          path = "wake";
+        }
+      } while (poll_event(&event));
+      if (despatch_flush()) {
+        path = "wake";
+      }
+    } else {
+      tween_sample();
+    }
+    quality_pass_begin(tween_wait_time() >= 0);
+    now = vclock_now();
+    new_minute = ((now / 60) != (last_checked / 60));
+    watchdog_phase(wp_alarms);
+    ALLOC_GUARD_BEGIN();
+    alarm = alarms_due(last_checked, now, due);
+    ALLOC_GUARD_END("alarm evaluation");
+    if (alarm) {
+      for (i = 0; i < num_displays; i++) {
+        if (due[displays[i].number]) {
+          QLOG_Info(("Alarm on display %d.\n", displays[i].number));
+        }
+      }
+      prepare_sound();
+      start_alarm_sound();
+      path = "wake";
+    }
+    last_checked = now;
+    manage_sound(now);
+    /*
+     * Every display due a new frame gets it at the same time, so that
+     * a whole wall of them flips together on the minute.
+     */
+    repaint = FALSE;
+    for (i = 0; i < num_displays; i++) {
+      display = displays + i;
+      if (manage_display(display, now, new_minute, due[display->number])) {
+        path = "dim transition";
+      }
+      if (display->repaint) {
+        repaint = TRUE;
+      }
+    }
+    if (tween_wait_time() == 0) {
+      if (!repaint) {
+        path = "animation";
+      }
+      for (i = 0; i < num_displays; i++) {
+        if (animating(displays + i)) {
+          displays[i].repaint = TRUE;
+          repaint = TRUE;
+        }
+      }
+    }
+    if (repaint) {
+      watchdog_phase(wp_painting);
+      ALLOC_GUARD_BEGIN();
+      paint_displays(now);
+      ALLOC_GUARD_END(path);
+      QLOG_Debug(("Repainted (%s).\n", path));
+    }
+    /*
+     * Anything left of the budget goes on smoother text, which is shown
+     * as soon as it's ready.
+     */
+    ALLOC_GUARD_BEGIN();
+    improved = improve_fonts();
+    ALLOC_GUARD_END("font improvement");
+    if (improved) {
+      for (i = 0; i < num_displays; i++) {
+        displays[i].repaint = TRUE;
+      }
+    }
+    quality_pass_end(repaint);
+    publish_status(now);
+    if (replay_finished() && !tween_running(&displays[0].fade)) {
+      running = FALSE;
+    }
+  }
+  watchdog_stop();
+  status_close();
+  replay_report();
+  record_stop();
+  metrics_report();
+  control_stop();
+  journal_close();
+  release_sound();
+  release_dial();
+  for (i = 0; i < num_displays; i++) {
+    SDL_DestroyRenderer(displays[i].renderer);
+    SDL_DestroyWindow(displays[i].window);
+  }
   TTF_Quit();
   SDL_Quit();
   return 0;
@@ -71,3 +345,860 @@ int main(void) {
  *================================================================
  */
 
+static bool parse_options(
+    int          argc,
+    char        *argv[],
+    const char **record_name,
+    const char **replay_name,
+    bool        *fast) {
+  /*
+   *   --record FILE   Log every input event to FILE
+   *   --replay FILE   Take input events from FILE instead
+   *   --fast          Replay as fast as possible rather than in real time
+   *   --headless      No display - render off screen in software
+   */
+  static const struct option options[] = {
+    { "record",   required_argument, NULL, 'r' },
+    { "replay",   required_argument, NULL, 'p' },
+    { "fast",     no_argument,       NULL, 'f' },
+    { "headless", no_argument,       NULL, 'H' },
+    { NULL,       0,                 NULL, 0 }
+  };
+  int  option;
+  bool result = TRUE;
+
+  while ((option = getopt_long(argc, argv, "r:p:fH", options, NULL)) != -1) {
+    switch (option) {
+      case 'r':
+        *record_name = optarg;
+        break;
+
+      case 'p':
+        *replay_name = optarg;
+        break;
+
+      case 'f':
+        *fast = TRUE;
+        break;
+
+      case 'H':
+        headless = TRUE;
+        break;
+
+      default:
+        result = FALSE;
+        break;
+
+    }
+  }
+  if (!result || (optind < argc)) {
+    fprintf(stderr,
+            "Usage: %s [--record FILE | --replay FILE [--fast]] "
+            "[--headless]\n",
+            argv[0]);
+    result = FALSE;
+  }
+  return result;
+}
+
+
+static void start_up(void) {
+  /*
+   * The independent parts of start-up run concurrently on a couple of
+   * worker threads.  Anything which touches a renderer stays on this
+   * thread.  The time goes up as soon as the large font is ready and
+   * everything else is filled in afterwards.
+   */
+  static t_job config_job;
+  static t_job large_font_job;
+  static t_job other_fonts_job;
+  static t_job images_job;
+  static t_job sound_job;
+  static const t_control_hooks control_hooks = {
+    snooze,
+    dismiss,
+    dim_all
+  };
+  t_display   *display;
+  int          i;
+  bool         journalled = FALSE;
+  time_t       now;
+  int          phase;
+
+  workers_start(STARTUP_WORKERS);
+  worker_submit(&config_job, "config", load_config, NULL);
+  /*
+   * Only what's needed for the first frame.  Audio is brought up
+   * later, just before the first alarm - see sound.c.
+   */
+  phase = startup_phase_begin("SDL");
+  if (headless) {
+    SDL_setenv("SDL_VIDEODRIVER", "offscreen", 0);
+    SDL_setenv("SDL_AUDIODRIVER", "dummy", 0);
+  }
+  SDL_Init(SDL_INIT_VIDEO | SDL_INIT_EVENTS);
+  startup_phase_end(phase);
+  /*
+   * Font choices, window sizes, the menu icon and sound file all come
+   * from the configuration so nothing more can start until it's been
+   * read.
+   */
+  worker_join(&config_job);
+  register_handlers();
+  /*
+   * A replay has to start from the same state each time, and mustn't
+   * be disturbed by (or disturb) anything outside.
+   */
+  if (!replaying()) {
+    phase = startup_phase_begin("journal");
+    journalled = journal_open();
+    startup_phase_end(phase);
+    control_start(&control_hooks);
+    status_open();
+  }
+  worker_submit(&large_font_job, "large font", load_large_font,
+                &other_fonts_job);
+  worker_submit(&images_job, "image decode", load_images, NULL);
+  worker_submit(&sound_job, "sound read", load_sound, NULL);
+  phase = startup_phase_begin("window");
+  now = vclock_now();
+  num_displays = get_display_count();
+  for (i = 0; i < num_displays; i++) {
+    display = displays + i;
+    display->number = i;
+    display->dimmed = journalled && journal_dimmed(i);
+    display->last_touched = now;
+    init_animations(display);
+    open_display(display);
+  }
+  SDL_ShowCursor(0);
+  startup_phase_end(phase);
+  worker_join(&large_font_job);
+  phase = startup_phase_begin("first present");
+  for (i = 0; i < num_displays; i++) {
+    display = displays + i;
+    upload_font(display->renderer, f_large);
+    if (analog) {
+      build_dial(display->renderer,
+                 dial_size(display),
+                 find_face(font_file_name(f_large),
+                           dial_size(display) / NUMERAL_SCALE));
+    }
+    display->repaint = TRUE;
+  }
+  paint_displays(vclock_now());
+  startup_phase_end(phase);
+  worker_join(&other_fonts_job);
+  worker_join(&images_job);
+  phase = startup_phase_begin("full present");
+  for (i = 0; i < num_displays; i++) {
+    display = displays + i;
+    upload_font(display->renderer, f_medium);
+    upload_images(display->renderer);
+    display->repaint = TRUE;
+  }
+  paint_displays(vclock_now());
+  startup_phase_end(phase);
+  worker_join(&sound_job);
+  workers_stop();
+}
+
+
+static void open_display(t_display *display) {
+  /*
+   * Each window goes full screen on the monitor of the same number,
+   * where there is one.  Headless there are just as many hidden
+   * windows, drawn in software.
+   */
+  display->window = SDL_CreateWindow(
+                      get_display_title(display->number),
+                      SDL_WINDOWPOS_CENTERED_DISPLAY(display->number),
+                      SDL_WINDOWPOS_CENTERED_DISPLAY(display->number),
+                      get_display_width(display->number),
+                      get_display_height(display->number),
+                      headless ? SDL_WINDOW_HIDDEN : SDL_WINDOW_FULLSCREEN);
+  display->renderer = SDL_CreateRenderer(display->window, -1,
+                                         headless ? SDL_RENDERER_SOFTWARE
+                                                  : 0);
+  display->window_id = SDL_GetWindowID(display->window);
+}
+
+
+static void load_config(void *unused) {
+  parse_config();
+  alarms_set_displays(get_display_count());
+  if (*get_alarm_import_file() != '\0') {
+    import_alarms(get_alarm_import_file());
+  }
+  dump_settings();
+  analog = (strcmp(get_clock_face(), "analog") == 0);
+}
+
+
+static void load_large_font(void *next_job) {
+  /*
+   * FreeType isn't happy with two faces being opened at once, so the
+   * other fonts are chained on after this one rather than loaded in
+   * parallel with it.
+   */
+  init_fonts();
+  load_font(f_large);
+  worker_submit((t_job *) next_job, "other fonts", load_other_fonts, NULL);
+}
+
+
+static void load_other_fonts(void *unused) {
+  /*
+   * The small font isn't on any screen yet so it's left to be opened
+   * when something first uses it.
+   */
+  load_font(f_medium);
+}
+
+
+static void load_images(void *unused) {
+  decode_images();
+}
+
+
+static void load_sound(void *unused) {
+  preload_sound();
+}
+
+
+static void register_handlers(void) {
+  despatch_register(SDL_QUIT, quit_event);
+  despatch_register(SDL_KEYDOWN, key_event);
+  despatch_register(SDL_FINGERDOWN, touch_event);
+  despatch_register(SDL_MOUSEBUTTONDOWN, touch_event);
+}
+
+
+static int wait_for_event(SDL_Event *event, int timeout) {
+  /*
+   * SDL_WaitEventTimeout(), or its stand-in when replaying.
+   */
+  int result;
+
+  if (replaying()) {
+    result = replay_wait(event, timeout);
+  } else {
+    result = SDL_WaitEventTimeout(event, timeout);
+    if (result) {
+      record_event(event);
+    }
+  }
+  return result;
+}
+
+
+static int poll_event(SDL_Event *event) {
+  int result;
+
+  if (replaying()) {
+    result = replay_poll(event);
+  } else {
+    result = SDL_PollEvent(event);
+    if (result) {
+      record_event(event);
+    }
+  }
+  return result;
+}
+
+
+static bool quit_event(SDL_Event *event) {
+  running = FALSE;
+  return FALSE;
+}
+
+
+static bool key_event(SDL_Event *event) {
+  if (event->key.keysym.sym == SDLK_q) {
+    running = FALSE;
+  }
+  return FALSE;
+}
+
+
+static bool touch_event(SDL_Event *event) {
+  /*
+   * A tap anywhere on a display silences its alarm and wakes it up.
+   * How long the wake takes to show is measured from the event's
+   * timestamp.
+   */
+  t_display *display;
+  bool       result = FALSE;
+
+  display = find_display((event->type == SDL_FINGERDOWN) ?
+                         event->tfinger.windowID :
+                         event->button.windowID);
+  display->last_touched = vclock_now();
+  if (display->sounding) {
+    stop_alarm_sound();
+  }
+  if (set_dimmed(display, FALSE)) {
+    latency_input(event->common.timestamp);
+    result = TRUE;
+  }
+  return result;
+}
+
+
+static t_display *find_display(Uint32 window_id) {
+  /*
+   * Anything which can't be matched up to a window goes to the first
+   * display.
+   */
+  int        i;
+  t_display *result = displays;
+
+  for (i = 0; i < num_displays; i++) {
+    if (displays[i].window_id == window_id) {
+      result = displays + i;
+      break;
+    }
+  }
+  return result;
+}
+
+
+static bool snooze(void) {
+  /*
+   * The control socket's snooze - silence a sounding alarm and have it
+   * go off again a little later, on each display it was sounding on.
+   */
+  int  i;
+  bool result = FALSE;
+
+  if (sound_playing()) {
+    for (i = 0; i < num_displays; i++) {
+      if (displays[i].sounding) {
+        snooze_alarm(displays[i].number, vclock_now() + get_snooze_time());
+        result = TRUE;
+      }
+    }
+    if (result) {
+      stop_alarm_sound();
+    }
+  }
+  return result;
+}
+
+
+static bool dismiss(void) {
+  /*
+   * Silence a sounding alarm, or forget a snooze, or failing either
+   * of those skip the first display's next alarm before it goes off.
+   */
+  int  i;
+  bool result = FALSE;
+
+  if (sound_playing()) {
+    for (i = 0; i < num_displays; i++) {
+      if (displays[i].sounding) {
+        cancel_snooze(displays[i].number);
+        result = TRUE;
+      }
+    }
+    if (result) {
+      stop_alarm_sound();
+    }
+  }
+  if (!result) {
+    for (i = 0; i < num_displays; i++) {
+      if (cancel_snooze(displays[i].number)) {
+        result = TRUE;
+      }
+    }
+  }
+  if (!result) {
+    result = skip_next_alarm(0);
+  }
+  return result;
+}
+
+
+static bool dim_all(bool dim) {
+  /*
+   * The control socket's dim and wake.
+   */
+  int  i;
+  bool result = FALSE;
+
+  for (i = 0; i < num_displays; i++) {
+    if (set_dimmed(displays + i, dim)) {
+      result = TRUE;
+    }
+  }
+  return result;
+}
+
+
+static bool set_dimmed(t_display *display, bool dim) {
+  /*
+   * The change is made at once but the brightness fades across to
+   * the new level from wherever it is now.
+   */
+  int  level;
+  bool result = FALSE;
+
+  if (dim != display->dimmed) {
+    level = current_level(display);
+    tween_stop(&display->sunrise);
+    display->dimmed = dim;
+    journal_dim(display->number, dim);
+    if (dim) {
+      tween_stop(&display->sweep);
+    } else {
+      display->last_touched = vclock_now();
+      tween_stop(&display->drift_x);
+      tween_stop(&display->drift_y);
+    }
+    tween_start(&display->fade,
+                level,
+                dim ? get_dim_value() : get_bright_value(),
+                get_fade_time());
+    display->repaint = TRUE;
+    result = TRUE;
+  }
+  return result;
+}
+
+
+static void manage_sound(time_t now) {
+  /*
+   * Get audio ready shortly before the next alarm on any display and
+   * shut it down again once the sound has finished.  There's only the
+   * one sound, so when it stops it's stopped everywhere.
+   */
+  int  i;
+  int  seconds;
+  bool sounding = FALSE;
+
+  for (i = 0; i < num_displays; i++) {
+    if (displays[i].sounding) {
+      sounding = TRUE;
+    }
+  }
+  if (sounding) {
+    if (!sound_playing()) {
+      release_sound();
+      for (i = 0; i < num_displays; i++) {
+        displays[i].sounding = FALSE;
+      }
+    }
+  } else if (!sound_ready()) {
+    for (i = 0; i < num_displays; i++) {
+      seconds = seconds_until_next_alarm(displays[i].number, now);
+      if ((seconds >= 0) && (seconds <= SOUND_LEAD_TIME)) {
+        prepare_sound();
+        break;
+      }
+    }
+  }
+}
+
+
+static bool manage_display(
+    t_display *display,
+    time_t     now,
+    bool       new_minute,
+    bool       due) {
+  /*
+   * Once round the main loop for each display, after its alarms have
+   * been looked at.  Returns TRUE if it's just dimmed.
+   */
+  bool result = FALSE;
+
+  if (new_minute) {
+    display->repaint = TRUE;
+  }
+  if (due) {
+    display->sounding = TRUE;
+    display->last_touched = now;
+    set_dimmed(display, FALSE);
+  }
+  manage_sunrise(display, now);
+  if (!display->dimmed &&
+      ((now - display->last_touched) >= get_dim_delay())) {
+    set_dimmed(display, TRUE);
+    result = TRUE;
+  }
+  if (display->dimmed &&
+      tween_arrived(&display->fade) && tween_arrived(&display->drift_x)) {
+    move_dimmed_time(display, new_minute);
+  }
+  if (analog && !display->dimmed &&
+      (get_second_hand_fps() > 0) && tween_arrived(&display->sweep)) {
+    start_sweep(display);
+  }
+  return result;
+}
+
+
+static bool animating(const t_display *display) {
+  return tween_running(&display->fade) ||
+         tween_running(&display->sunrise) ||
+         tween_running(&display->drift_x) ||
+         tween_running(&display->drift_y) ||
+         tween_running(&display->sweep);
+}
+
+
+static void init_animations(t_display *display) {
+  /*
+   * Every display's tweens share the same names, so their metrics are
+   * totals across the lot.
+   */
+  tween_init(&display->fade, "fade", e_smooth, 0);
+  tween_init(&display->sunrise, "sunrise", e_linear, 0);
+  tween_init(&display->drift_x, "drift x", e_smooth, DRIFT_SCALE / 2);
+  tween_init(&display->drift_y, "drift y", e_smooth, DRIFT_SCALE / 2);
+  tween_init(&display->sweep, "second hand", e_linear, 0);
+}
+
+
+static int current_level(const t_display *display) {
+  /*
+   * The brightness as it is in the frame being drawn.
+   */
+  int result;
+
+  if (tween_running(&display->fade)) {
+    result = tween_value(&display->fade);
+  } else if (!display->dimmed) {
+    result = get_bright_value();
+  } else if (tween_running(&display->sunrise)) {
+    result = tween_value(&display->sunrise);
+  } else {
+    result = get_dim_value();
+  }
+  return result;
+}
+
+
+static void manage_sunrise(t_display *display, time_t now) {
+  /*
+   * A dimmed screen comes up gradually to full brightness over the
+   * last few minutes before an alarm.  If the alarm goes away (skipped
+   * or removed) then so does the sunrise.
+   */
+  int seconds;
+
+  seconds = seconds_until_next_alarm(display->number, now);
+  if (display->dimmed && (seconds > 0) && (seconds <= get_sunrise_time())) {
+    if (!tween_running(&display->sunrise)) {
+      tween_start(&display->sunrise,
+                  current_level(display),
+                  get_bright_value(),
+                  seconds * 1000);
+    }
+  } else {
+    tween_stop(&display->sunrise);
+  }
+}
+
+
+static void move_dimmed_time(t_display *display, bool new_minute) {
+  /*
+   * Set the dimmed time off towards a new position.  Both axes take
+   * the same time so it moves in a straight line.  With drifting
+   * turned off it just jumps somewhere new each minute.
+   */
+  int duration;
+
+  duration = get_drift_time() * 1000;
+  if (duration > 0) {
+    tween_start(&display->drift_x,
+                tween_value(&display->drift_x),
+                random_offset(DRIFT_SCALE),
+                duration);
+    tween_start(&display->drift_y,
+                tween_value(&display->drift_y),
+                random_offset(DRIFT_SCALE),
+                duration);
+  } else if (new_minute) {
+    tween_set(&display->drift_x, random_offset(DRIFT_SCALE));
+    tween_set(&display->drift_y, random_offset(DRIFT_SCALE));
+  }
+}
+
+
+static void start_sweep(t_display *display) {
+  /*
+   * Round to the end of this minute in steps of 1/fps of a second, so
+   * that is how often frames are drawn.  Restarted every minute to keep
+   * it in step with the clock.
+   */
+  int             fps;
+  int             into_minute;
+  struct timespec now;
+
+  fps = get_second_hand_fps();
+  vclock_gettime(&now);
+  into_minute = ((now.tv_sec % 60) * 1000) + (now.tv_nsec / 1000000);
+  tween_start(&display->sweep,
+              (into_minute * fps) / 1000,
+              60 * fps,
+              60000 - into_minute);
+}
+
+
+static int dial_size(const t_display *display) {
+  return (get_display_height(display->number) * DIAL_PERCENT) / 100;
+}
+
+
+static int drift_offset(const t_tween *tween, int room) {
+  return (room > 0) ? (tween_value(tween) * room) / DRIFT_SCALE : 0;
+}
+
+
+static void publish_status(time_t now) {
+  /*
+   * Once round the main loop.  The frame fields are filled in by
+   * paint_displays as it presents.
+   */
+  int seconds;
+
+  seconds = seconds_until_next_alarm(displays[0].number, now);
+  status.next_alarm    = (seconds < 0) ? 0 : now + seconds;
+  status.next_alarm_id = next_alarm_id(displays[0].number);
+  status.dimmed        = displays[0].dimmed;
+  status.brightness    = current_level(displays);
+  status.sounding      = displays[0].sounding;
+  status_publish(&status);
+}
+
+
+static int wait_time(void) {
+  /*
+   * How many milliseconds can we sleep for?  Until the next minute
+   * boundary, the next thing any display has to do, the next frame
+   * of an animation or more work on the fonts, whichever is soonest -
+   * or not at all if a display's waiting to be repainted.
+   */
+  int             frame;
+  int             i;
+  int             ms_into_second;
+  struct timespec now;
+  int             result;
+
+  vclock_gettime(&now);
+  ms_into_second = now.tv_nsec / 1000000;
+  result = ((60 - (now.tv_sec % 60)) * 1000) - ms_into_second;
+  for (i = 0; i < num_displays; i++) {
+    result = shorter(result,
+                     display_wait_time(displays + i, &now, ms_into_second));
+  }
+  if (result < 0) {
+    result = 0;
+  }
+  result += WAKE_MARGIN_MS;
+  frame = tween_wait_time();
+  if (frame >= 0) {
+    result = shorter(result, frame);
+  }
+  frame = improve_wait_time();
+  if (frame >= 0) {
+    result = shorter(result, frame);
+  }
+  for (i = 0; i < num_displays; i++) {
+    if (displays[i].repaint) {
+      result = 0;
+    }
+  }
+  return result;
+}
+
+
+static int display_wait_time(
+    const t_display       *display,
+    const struct timespec *now,
+    int                    ms_into_second) {
+  /*
+   * Until the time to dim, the start of a sunrise, the time to get the
+   * sound ready or the next alarm - or INT_MAX for none of them.
+   */
+  int result = INT_MAX;
+  int seconds;
+
+  if (!display->dimmed) {
+    seconds = (display->last_touched + get_dim_delay()) - now->tv_sec;
+    result = shorter(result, (seconds * 1000) - ms_into_second);
+  }
+  seconds = seconds_until_next_alarm(display->number, now->tv_sec);
+  if (seconds > 0) {
+    result = shorter(result, (seconds * 1000) - ms_into_second);
+    if (display->dimmed && (seconds > get_sunrise_time())) {
+      result = shorter(result,
+                       ((seconds - get_sunrise_time()) * 1000) -
+                       ms_into_second);
+    }
+    if (!sound_ready() && (seconds > SOUND_LEAD_TIME)) {
+      result = shorter(result,
+                       ((seconds - SOUND_LEAD_TIME) * 1000) - ms_into_second);
+    }
+  }
+  if (display->sounding) {
+    result = shorter(result, SOUND_POLL_MS);
+  }
+  return result;
+}
+
+
+static int shorter(int current, int candidate) {
+  return (candidate < current) ? candidate : current;
+}
+
+
+static void paint_displays(time_t now) {
+  /*
+   * Every display waiting for a new frame has it put together first,
+   * and only then are they all presented, back to back, so that they
+   * change together.
+   */
+  int             i;
+  struct timespec presented;
+  struct tm       tm;
+
+  latency_frame_begin();
+  localtime_r(&now, &tm);
+  for (i = 0; i < num_displays; i++) {
+    if (displays[i].repaint) {
+      compose_screen(displays + i, &tm);
+    }
+  }
+  watchdog_phase(wp_presenting);
+  latency_present_begin();
+  for (i = 0; i < num_displays; i++) {
+    if (displays[i].repaint) {
+      SDL_RenderPresent(displays[i].renderer);
+      displays[i].repaint = FALSE;
+      replay_presented(displays[i].number, now);
+    }
+  }
+  watchdog_presented(now);
+  latency_presented();
+  tween_painted();
+  vclock_gettime(&presented);
+  status.last_frame    = presented.tv_sec;
+  status.last_frame_ns = presented.tv_nsec;
+  status.frames++;
+}
+
+
+static void compose_screen(t_display *display, const struct tm *tm) {
+  /*
+   * Everything here works from stack buffers and the pre-built glyph
+   * atlases so repainting doesn't allocate.  A frame of an animation
+   * is the same thing at a different brightness or position - just
+   * colour modulation and copies from the atlases.
+   *
+   * On the way into dim the bright layout fades down and the dimmed
+   * one takes over for the fade's final frame.
+   */
+  t_box         box;
+  char          date_string[MAX_TEXT_LEN + 1];
+  int           height;
+  int           level;
+  SDL_Renderer *renderer;
+  char          time_string[MAX_TEXT_LEN + 1];
+  int           width;
+
+  renderer = display->renderer;
+  width = get_display_width(display->number);
+  height = get_display_height(display->number);
+  strftime(time_string, sizeof(time_string), "%H:%M", tm);
+  level = current_level(display);
+  SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+  SDL_RenderClear(renderer);
+  batch_begin(renderer);
+  if (display->dimmed && tween_arrived(&display->fade)) {
+    if (analog) {
+      box.width = dial_size(display) / 2;
+      box.height = box.width;
+      paint_dial(renderer,
+                 drift_offset(&display->drift_x, width - box.width),
+                 drift_offset(&display->drift_y, height - box.height),
+                 box.width, tm, -1.0, level);
+    } else {
+      box = size_text(f_large, time_string);
+      paint_text(renderer, time_string, f_large, h_left, v_top,
+                 drift_offset(&display->drift_x, width - box.width),
+                 drift_offset(&display->drift_y, height - box.height),
+                 level);
+    }
+  } else {
+    format_date(date_string, sizeof(date_string), tm);
+    if (analog) {
+      paint_dial(renderer,
+                 (width - dial_size(display)) / 2,
+                 (height - dial_size(display)) / 4,
+                 dial_size(display),
+                 tm,
+                 (get_second_hand_fps() > 0) ?
+                   (double) tween_value(&display->sweep) /
+                   get_second_hand_fps() :
+                   -1.0,
+                 level);
+      paint_text(renderer, date_string, f_medium, h_centre, v_bottom,
+                 0, 10, level);
+    } else {
+      paint_text(renderer, time_string, f_large, h_centre, v_middle,
+                 0, -30, level);
+      paint_text(renderer, date_string, f_medium, h_centre, v_middle,
+                 0, 100, level);
+    }
+    paint_menu(renderer, level);
+  }
+  batch_end();
+}
+
+
+static void format_date(char *buffer, int size, const struct tm *tm) {
+  /*
+   * e.g. "7th November, 2023"
+   */
+  int used;
+
+  used = sprintf(buffer, "%d%s ", tm->tm_mday, ordinal_suffix(tm->tm_mday));
+  strftime(buffer + used, size - used, "%B, %Y", tm);
+}
+
+
+static const char *ordinal_suffix(int number) {
+  const char *result;
+
+  switch (number) {
+    case 11:
+    case 12:
+    case 13:
+      result = "th";
+      break;
+
+    default:
+      switch (number % 10) {
+        case 1:
+          result = "st";
+          break;
+
+        case 2:
+          result = "nd";
+          break;
+
+        case 3:
+          result = "rd";
+          break;
+
+        default:
+          result = "th";
+          break;
+
+      }
+      break;
+
+  }
+  return result;
+}
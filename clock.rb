@@ -16,12 +16,44 @@ require 'yaml'
 #  working without them.
 #
 require 'active_support/all'
+#
+#  The C clock's alarm index, timer queue and glyph atlases, if they've
+#  been built (make ruby_ext).  Everything has a plain Ruby fallback.
+#
+begin
+  require_relative 'ext/clock_core/clock_core'
+rescue LoadError
+  puts "No clock_core extension - running in plain Ruby."
+end
+require_relative 'sorted_queue'
+require_relative 'my_display'
+
+#
+#  Debugging output, for the parts which run all the time.  Turned on
+#  with --debug.
+#
+DEBUG = ARGV.include?('--debug')
+
+def debug(message)
+  puts message if DEBUG
+end
 
 class Despatcher
   #
-  #  An object which will poll for SDL2 events and dispatch them according to
-  #  requests from other objects.
+  #  An object which waits for SDL2 events and dispatches them according
+  #  to requests from other objects.
+  #
+  #  Registering for nil rather than a class of event means being called
+  #  with nil whenever we wake up, which is what drives the Alarmer.
+  #  Anything registered that way can have a next_deadline method, and
+  #  we sleep until the earliest of those unless an event comes first.
+  #
+
+  #
+  #  Without the clock_core extension there's no way to block waiting
+  #  for an SDL event, so we have to come back and poll this often.
   #
+  IDLE_POLL = 0.25
 
   class Request
     attr_reader :type, :recipient
@@ -34,39 +66,71 @@ class Despatcher
 
   def initialize
     @requests = []
+    @timed = []
+    @by_class = {}
   end
 
   def register(type, recipient)
-    # type should be a class of event
+    # type should be a class of event, or nil
     # recipient should be an object with a handle_event() method
-    # 
-    # This method of storing the registrations is not efficient and
-    # can be improved later by being made more structured.
     #
-    puts "Registering"
-    @requests << Request.new(type, recipient)
+    debug "Registering"
+    if type
+      @requests << Request.new(type, recipient)
+      @by_class.clear
+    else
+      @timed << recipient
+    end
   end
 
   def despatch
-    puts "Despatch starting"
-    got_something = false
+    debug "Despatch starting"
     while true
-      event = SDL2::Event.poll
-      if event
-        got_something = true
-        puts event.inspect
-      else
-        got_something = false
-      end
-      @requests.each do |request|
-        if request.type === event
-          request.recipient.handle_event(event)
+      wait_for_event(next_deadline)
+      while (event = SDL2::Event.poll)
+        debug event.inspect
+        recipients_for(event.class).each do |recipient|
+          recipient.handle_event(event)
         end
       end
-      unless got_something
-        sleep(0.25)
+      @timed.each do |recipient|
+        recipient.handle_event(nil)
+      end
+    end
+  end
+
+  private
+
+  def recipients_for(event_class)
+    #
+    #  Worked out the first time we see each class of event, so that
+    #  registering for a superclass still catches all of its kind.
+    #
+    @by_class[event_class] ||=
+      @requests.select { |request| event_class <= request.type }.
+                map(&:recipient)
+  end
+
+  def next_deadline
+    deadline = nil
+    @timed.each do |recipient|
+      if recipient.respond_to?(:next_deadline)
+        candidate = recipient.next_deadline
+        if candidate && (deadline.nil? || candidate < deadline)
+          deadline = candidate
+        end
       end
     end
+    deadline
+  end
+
+  def wait_for_event(deadline)
+    timeout = deadline && [deadline - Time.now, 0].max
+    if defined?(ClockCore)
+      ClockCore.wait_event(timeout)
+    else
+      sleep(timeout ? [timeout, IDLE_POLL].min : IDLE_POLL)
+    end
   end
 end
 
@@ -89,7 +153,7 @@ class Alarmer
       @at_when   = at_when
       @interval  = interval
       @recurring = recurring
-      puts "Alarm at #{at_when}"
+      debug "Alarm at #{at_when}"
     end
 
     def defer(interval)
@@ -99,17 +163,24 @@ class Alarmer
   end
 
   def initialize(despatcher)
-    @alarms = []
+    @alarms = defined?(ClockCore) ? ClockCore::TimerQueue.new : SortedQueue.new
     @earliest_alarm = nil
     despatcher.register(nil, self)
   end
 
+  #
+  #  When the despatcher should next wake us.
+  #
+  def next_deadline
+    @earliest_alarm
+  end
+
   #
   #  A function to receive raw "nil" events from the despatcher.
   #
   def handle_event(event)
     now = Time.now
-    if @earliest_alarm && (now >= @earliest_alarm)
+    while @earliest_alarm && (now >= @earliest_alarm)
       #
       #  Time to do some work.
       #
@@ -117,40 +188,41 @@ class Alarmer
       alarm.receiver.handle_event(alarm)
       if alarm.recurring
         alarm.defer(alarm.interval)
-        @alarms << alarm
+        @alarms.push(alarm.at_when, alarm)
       end
       recalculate()
     end
   end
 
   def alarm_every(receiver, reference, duration, align = false)
-    puts "In alarm_every"
+    debug "In alarm_every"
     t = Time.now
     if align
       t = t.change({sec: 0})
     end
     alarm = Alarm.new(receiver, reference, t + duration, duration, true)
-    @alarms << alarm
+    @alarms.push(alarm.at_when, alarm)
     recalculate()
   end
 
   def alarm_after(receiver, reference, duration)
-    puts "In alarm_after"
+    debug "In alarm_after"
     alarm = Alarm.new(receiver, reference, Time.now + duration)
-    @alarms << alarm
+    @alarms.push(alarm.at_when, alarm)
     recalculate()
   end
 
   private
 
   def recalculate
-    if @alarms.empty?
-      @earliest_alarm = nil
-    else
-      @alarms.sort_by!(&:at_when)
-      @earliest_alarm = @alarms[0].at_when
+    #
+    #  The queue keeps itself in order so there's nothing to sort.
+    #
+    @earliest_alarm = @alarms.next_time
+    if @earliest_alarm
+      @earliest_alarm = Time.at(@earliest_alarm)
     end
-    puts "Earliest alarm is #{@earliest_alarm}"
+    debug "Earliest alarm is #{@earliest_alarm}"
   end
 
 end
@@ -428,135 +500,13 @@ class Config
     @screen_height = @details[:settings][:screen_height]
     @title         = @details[:settings][:title]
     @dim_delay     = @details[:settings][:dim_delay].to_f
+    @alarms        = @details[:alarms]
   end
 
   #
   #  And now methods for the running program to query the configuration.
   #
-  attr_reader :screen_width, :screen_height, :title, :dim_delay
-
-end
-
-
-#
-#  I propose to wrap up the SDL stuff a bit.  Other things apart from
-#  my clock class might want to write to it.
-#
-class MyDisplay
-
-  #
-  #  I propose to provide methods to write text to the screen.  You can
-  #  specify a reference point from which to start, then an offset from
-  #  that reference.
-  #
-  #  If you specify left reference the offset will be for the left of
-  #  the text.
-  #
-  #  If you specify right reference the offset will be for the right of
-  #  the text.
-  #
-  #  If you specify centre reference then the offset will be for the
-  #  centre of the text.
-  #
-  #  In other words, how far to move from touching the left edge, touching
-  #  the right edge or being centred.
-  #
-  #  Random means put it in a random place but still on the screen.
-  #  The random position will still be on the screen (if possible) but
-  #  if you also specify an offset then you might push it off.
-  #
-  #  Likewise for vertical.
-  #
-  #  Sadly, plain Ruby doesn't have an enum type (although Rails adds one).
-  #
-  #enum horizontal_reference: [:left, :centre, :right, :random]
-  #enum vertical_reference: [:top, :middle, :bottom, :random]
-  #
-
-  #
-  #  Curiously, you don't need any kind of handle on the display in order
-  #  to write to it.  This is used purely to get dimensions.
-  #
-  attr_reader :width, :height
-
-  def initialize(config)
-    SDL2.init(SDL2::INIT_EVERYTHING)
-    SDL2::TTF.init
-    @display = SDL2::Display.displays[0]
-    @width = @display.current_mode.w
-    @height = @display.current_mode.h
-    puts "Initial width and height #{@width}, #{@height}"
-    SDL2::Mouse::Cursor.hide
-    @window = SDL2::Window.create(
-      config.title,
-      SDL2::Window::POS_CENTERED,
-      SDL2::Window::POS_CENTERED,
-      config.screen_width,
-      config.screen_height,
-      SDL2::Window::Flags::FULLSCREEN)        # Flags
-    @renderer = @window.create_renderer(
-      -1,       # Index
-      0)        # Flags
-    @width = @display.current_mode.w
-    @height = @display.current_mode.h
-    puts "Final width and height #{@width}, #{@height}"
-
-#    while SDL2::Mixer::Channels.play?(0)
-#      sleep 1
-#    end
-    @random = Random.new
-  end
-
-  def blank_buffer
-    @renderer.draw_color = [0,0,0]
-    @renderer.fill_rect(
-      SDL2::Rect.new(0,0,@width,@height))
-  end
-
-  def paint_text(
-    text,
-    font,
-    href,
-    vref,
-    hoff,
-    voff,
-    density)
-
-    text_width, text_height = font.size_text(text)
-    case href
-    when :left
-      hpos = hoff
-    when :right
-      hpos = (@width - text_width) - hoff
-    when :centre
-      hpos = (@width - text_width) / 2 + hoff
-    when :random
-      hpos = @random.rand(0..(@width - text_width)) + hoff
-    end
-    case vref
-    when :top
-      vpos = voff
-    when :bottom
-      vpos = (@height - text_height) - voff
-    when :middle
-      vpos = (@height - text_height) / 2 + voff
-    when :random
-      vpos = @random.rand(0..(@height - text_height)) + voff
-    end
-    surface = font.render_solid(text, [density, density, density])
-    texture = @renderer.create_texture_from(surface)
-    @renderer.copy(
-      texture,
-      nil,
-      SDL2::Rect.new(hpos, vpos, text_width, text_height)
-    )
-    texture.destroy
-    surface.destroy
-  end
-
-  def do_display
-    @renderer.present
-  end
+  attr_reader :screen_width, :screen_height, :title, :dim_delay, :alarms
 
 end
 
@@ -580,9 +530,9 @@ class AlarmClock
     @my_display = my_display
     @config     = config
 
-    @italic_font = SDL2::TTF.open(ITALIC_FONT_FILE, ITALIC_FONT_SIZE)
-    @plain_font  = SDL2::TTF.open(PLAIN_FONT_FILE, PLAIN_FONT_SIZE)
-    @small_font  = SDL2::TTF.open(SMALL_FONT_FILE, SMALL_FONT_SIZE)
+    @italic_font = my_display.open_font(ITALIC_FONT_FILE, ITALIC_FONT_SIZE)
+    @plain_font  = my_display.open_font(PLAIN_FONT_FILE, PLAIN_FONT_SIZE)
+    @small_font  = my_display.open_font(SMALL_FONT_FILE, SMALL_FONT_SIZE)
 
     #
     #  Whether we're showing a night-friendly dim version of the time.
@@ -593,11 +543,16 @@ class AlarmClock
     @last_time_string = ""
 
     SDL2::Mixer.init(SDL2::Mixer::INIT_OGG)
-    SDL2::Mixer.open(22050, SDL2::Mixer::DEFAULT_FORMAT, 2, 512)
-    @alarm_sound = SDL2::Mixer::Chunk.load("Alarm_Classic.ogg")
-    SDL2::Mixer::Channels.set_volume(0, 128)
-    SDL2::Mixer::Channels.fade_in(0, @alarm_sound, 0, 600)
-    @sounding = true
+    start_sound
+    #
+    #  The configured alarms go into the C clock's index, if we have it.
+    #
+    @last_checked = Time.now
+    if defined?(ClockCore)
+      config.alarms.each do |alarm|
+        ClockCore.add_alarm(alarm[:time], alarm[:days])
+      end
+    end
     #
     #  What events do we need?
     #
@@ -613,6 +568,14 @@ class AlarmClock
     paint_screen(Time.now, @faded)
   end
 
+  def start_sound
+    SDL2::Mixer.open(22050, SDL2::Mixer::DEFAULT_FORMAT, 2, 512)
+    @alarm_sound = SDL2::Mixer::Chunk.load("Alarm_Classic.ogg")
+    SDL2::Mixer::Channels.set_volume(0, 128)
+    SDL2::Mixer::Channels.fade_in(0, @alarm_sound, 0, 600)
+    @sounding = true
+  end
+
   def ordinalize(number)
     case number
     when 11, 12, 13
@@ -701,8 +664,8 @@ class AlarmClock
 
   def handle_event(event)
     if event
-      puts "In handle_event"
-      puts event.class
+      debug "In handle_event"
+      debug event.class
     end
     do_repaint = false
     now = Time.now
@@ -714,6 +677,12 @@ class AlarmClock
         #  Time has moved on by a minute.
         #
         do_repaint = true
+        if defined?(ClockCore) &&
+            ClockCore.alarms_due?(@last_checked, now) &&
+            !@sounding
+          start_sound
+        end
+        @last_checked = now
       when :fade
         @faded = true
         do_repaint = true
@@ -722,7 +691,7 @@ class AlarmClock
     when SDL2::Event::MouseButtonDown
       @last_touched_time = Time.now
       if @faded
-        puts "Set @faded to false"
+        debug "Set @faded to false"
         @faded = false
         @alarmer.alarm_after(self, :fade, 3.minutes)
         do_repaint = true
@@ -0,0 +1,497 @@
+/*
+ *  Control socket.  See control.h for the protocol.
+ */
+
+#define NEED_SDL
+#include "includes.h"
+
+/*
+ *================================================================
+ *
+ *  Constants.
+ *
+ *================================================================
+ */
+
+#define MAX_CLIENTS    4
+#define MAX_MESSAGE    1024           /* Not counting the length itself */
+#define LENGTH_BYTES   2
+#define LISTEN_BACKLOG 4
+#define ALARM_BYTES    13             /* One alarm in a list reply */
+
+/*
+ *================================================================
+ *
+ *  Type definitions.
+ *
+ *================================================================
+ */
+
+typedef struct {
+  int           fd;           /* -1 if the slot is free */
+  volatile bool pending;      /* Request handed to the main loop */
+  int           got;          /* Bytes of request read so far */
+  unsigned char request[LENGTH_BYTES + MAX_MESSAGE];
+  unsigned char reply[LENGTH_BYTES + MAX_MESSAGE];
+} t_client;
+
+/*
+ *================================================================
+ *
+ *  Local data.
+ *
+ *================================================================
+ */
+
+static t_client clients[MAX_CLIENTS];
+
+static const t_control_hooks *control_hooks;
+
+static bool          started = FALSE;
+static volatile bool stopping = FALSE;
+static pthread_t     listener;
+static int           listen_fd = -1;
+static int           wake_pipe[2];
+static Uint32        control_event_type;
+
+/*
+ *================================================================
+ *
+ *  Forward declarations.
+ *
+ *================================================================
+ */
+
+static bool control_event(SDL_Event *event);
+
+static void *listener_main(void *unused);
+
+static void accept_client(void);
+
+static void read_request(t_client *client);
+
+static void close_client(t_client *client);
+
+static int message_length(const unsigned char *message);
+
+static int get_int(const unsigned char *ptr);
+
+static unsigned char *put_int(unsigned char *ptr, int value);
+
+static int days_to_bits(const bool *days);
+
+static int seconds_to_go(time_t when, time_t now);
+
+static int perform(
+    const unsigned char *request,
+    int                  length,
+    unsigned char       *reply,
+    bool                *repaint);
+
+/*
+ *================================================================
+ *
+ *  Externally visible routines.
+ *
+ *================================================================
+ */
+
+void control_start(const t_control_hooks *hooks) {
+  /*
+   * Must be called after SDL_Init().
+   */
+  struct sockaddr_un address;
+  const char        *path;
+  int                i;
+
+  control_hooks = hooks;
+  for (i = 0; i < MAX_CLIENTS; i++) {
+    clients[i].fd = -1;
+  }
+  path = get_control_socket();
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  safe_copy(address.sun_path,
+            path,
+            sizeof(address.sun_path) - 1,
+            "Control socket");
+  control_event_type = SDL_RegisterEvents(1);
+  listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  unlink(path);
+  if ((control_event_type == (Uint32) -1) ||
+      (listen_fd < 0) ||
+      (bind(listen_fd, (struct sockaddr *) &address, sizeof(address)) != 0) ||
+      (listen(listen_fd, LISTEN_BACKLOG) != 0) ||
+      (pipe(wake_pipe) != 0)) {
+    LOG_Error("Failed to set up control socket \"%s\".\n", path);
+  } else if (pthread_create(&listener, NULL, listener_main, NULL) != 0) {
+    LOG_Error("Failed to start control socket thread.\n");
+  } else {
+    despatch_register(control_event_type, control_event);
+    started = TRUE;
+  }
+}
+
+void control_stop(void) {
+  int i;
+
+  if (started) {
+    started = FALSE;
+    stopping = TRUE;
+    write(wake_pipe[1], "", 1);
+    pthread_join(listener, NULL);
+    for (i = 0; i < MAX_CLIENTS; i++) {
+      if (clients[i].fd >= 0) {
+        close(clients[i].fd);
+      }
+    }
+    close(wake_pipe[0]);
+    close(wake_pipe[1]);
+    unlink(get_control_socket());
+  }
+  if (listen_fd >= 0) {
+    close(listen_fd);
+    listen_fd = -1;
+  }
+}
+
+/*
+ *================================================================
+ *
+ *  Local routines.
+ *
+ *================================================================
+ */
+
+static bool control_event(SDL_Event *event) {
+  /*
+   * A request handed over by the listener - carry it out and reply.
+   * Returns TRUE if the screen needs repainting as a result.
+   */
+  t_client *client;
+  int       length;
+  bool      repaint = FALSE;
+
+  if (started) {
+    client = event->user.data1;
+    length = perform(client->request + LENGTH_BYTES,
+                     message_length(client->request),
+                     client->reply + LENGTH_BYTES,
+                     &repaint);
+    client->reply[0] = length >> 8;
+    client->reply[1] = length & 0xff;
+    if (send(client->fd,
+             client->reply,
+             LENGTH_BYTES + length,
+             MSG_DONTWAIT | MSG_NOSIGNAL) != LENGTH_BYTES + length) {
+      /*
+       * Not keeping up.  The listener will see the connection go and
+       * tidy up.
+       */
+      shutdown(client->fd, SHUT_RDWR);
+    }
+    client->got = 0;
+    __sync_synchronize();
+    client->pending = FALSE;
+    write(wake_pipe[1], "", 1);
+  }
+  return repaint;
+}
+
+
+static void *listener_main(void *unused) {
+  /*
+   * Waits for connections and for requests on them.  A connection
+   * with a request waiting to be dealt with is left alone until the
+   * main loop has replied.
+   */
+  char          drain[16];
+  int           i;
+  int           polled;
+  struct pollfd polls[2 + MAX_CLIENTS];
+  t_client     *waiting[MAX_CLIENTS];
+
+  while (!stopping) {
+    polls[0].fd = wake_pipe[0];
+    polls[0].events = POLLIN;
+    polls[1].fd = listen_fd;
+    polls[1].events = POLLIN;
+    polled = 0;
+    for (i = 0; i < MAX_CLIENTS; i++) {
+      if ((clients[i].fd >= 0) && !clients[i].pending) {
+        waiting[polled] = clients + i;
+        polls[2 + polled].fd = clients[i].fd;
+        polls[2 + polled].events = POLLIN;
+        polled++;
+      }
+    }
+    if (poll(polls, 2 + polled, -1) > 0) {
+      if (polls[0].revents & POLLIN) {
+        read(wake_pipe[0], drain, sizeof(drain));
+      }
+      for (i = 0; i < polled; i++) {
+        if (polls[2 + i].revents & (POLLIN | POLLHUP | POLLERR)) {
+          read_request(waiting[i]);
+        }
+      }
+      if (polls[1].revents & POLLIN) {
+        accept_client();
+      }
+    }
+  }
+  return NULL;
+}
+
+
+static void accept_client(void) {
+  int fd;
+  int i;
+
+  fd = accept(listen_fd, NULL, NULL);
+  if (fd >= 0) {
+    for (i = 0; i < MAX_CLIENTS; i++) {
+      if (clients[i].fd < 0) {
+        clients[i].got = 0;
+        clients[i].pending = FALSE;
+        clients[i].fd = fd;
+        break;
+      }
+    }
+    if (i == MAX_CLIENTS) {
+      QLOG_Warning(("Too many control connections.\n"));
+      close(fd);
+    }
+  }
+}
+
+
+static void read_request(t_client *client) {
+  /*
+   * Read what we can.  Once a whole request is in, hand it over.
+   */
+  SDL_Event event;
+  int       length;
+  int       wanted;
+  ssize_t   got;
+
+  if (client->got < LENGTH_BYTES) {
+    wanted = LENGTH_BYTES - client->got;
+  } else {
+    wanted = LENGTH_BYTES + message_length(client->request) - client->got;
+  }
+  got = recv(client->fd, client->request + client->got, wanted, 0);
+  if (got <= 0) {
+    close_client(client);
+  } else {
+    client->got += got;
+    if (client->got >= LENGTH_BYTES) {
+      length = message_length(client->request);
+      if ((length == 0) || (length > MAX_MESSAGE)) {
+        QLOG_Warning(("Bad control request length %d.\n", length));
+        close_client(client);
+      } else if (client->got == LENGTH_BYTES + length) {
+        client->pending = TRUE;
+        memset(&event, 0, sizeof(event));
+        event.type = control_event_type;
+        event.user.data1 = client;
+        if (SDL_PushEvent(&event) != 1) {
+          close_client(client);
+        }
+      }
+    }
+  }
+}
+
+
+static void close_client(t_client *client) {
+  close(client->fd);
+  client->fd = -1;
+  client->pending = FALSE;
+}
+
+
+static int message_length(const unsigned char *message) {
+  return (message[0] << 8) | message[1];
+}
+
+
+static int get_int(const unsigned char *ptr) {
+  unsigned long value;
+
+  value = ((unsigned long) ptr[0] << 24) |
+          ((unsigned long) ptr[1] << 16) |
+          ((unsigned long) ptr[2] << 8) |
+          (unsigned long) ptr[3];
+  return (value & 0x80000000UL) ? -(int) (0xffffffffUL - value) - 1
+                                : (int) value;
+}
+
+
+static unsigned char *put_int(unsigned char *ptr, int value) {
+  unsigned long bits;
+
+  bits = (unsigned long) value;
+  ptr[0] = (bits >> 24) & 0xff;
+  ptr[1] = (bits >> 16) & 0xff;
+  ptr[2] = (bits >> 8) & 0xff;
+  ptr[3] = bits & 0xff;
+  return ptr + 4;
+}
+
+
+static int days_to_bits(const bool *days) {
+  int i;
+  int result = 0;
+
+  for (i = 0; i < 7; i++) {
+    if (days[i]) {
+      result |= 1 << i;
+    }
+  }
+  return result;
+}
+
+
+static int seconds_to_go(time_t when, time_t now) {
+  return (when == ALARM_NEVER) ? -1 : (int) (when - now);
+}
+
+
+static int perform(
+    const unsigned char *request,
+    int                  length,
+    unsigned char       *reply,
+    bool                *repaint) {
+  /*
+   * Carry out one request, building the reply.  Returns the reply's
+   * length.
+   */
+  const t_individual_alarm *alarm;
+  int                       count;
+  unsigned char            *counted;
+  int                       first;
+  int                       i;
+  char                      line[MAX_MESSAGE];
+  int                       line_length;
+  t_individual_alarm        new_alarm;
+  time_t                    now;
+  unsigned char            *ptr;
+  t_control_status          status = cs_ok;
+
+  now = vclock_now();
+  ptr = reply + 1;
+  switch (request[0]) {
+    case cr_next:
+      ptr = put_int(ptr, next_alarm_id(0));
+      ptr = put_int(ptr, seconds_until_next_alarm(0, now));
+      break;
+
+    case cr_list:
+      first = (length >= 5) ? get_int(request + 1) : 0;
+      if (first < 0) {
+        first = 0;
+      }
+      count = (MAX_MESSAGE - 9) / ALARM_BYTES;
+      if (first + count > alarm_count()) {
+        count = (first < alarm_count()) ? alarm_count() - first : 0;
+      }
+      ptr = put_int(ptr, alarm_count());
+      ptr = put_int(ptr, count);
+      for (i = first; i < first + count; i++) {
+        alarm = alarm_at(i);
+        ptr = put_int(ptr, alarm->id);
+        ptr = put_int(ptr, alarm->trigger_time);
+        *ptr++ = days_to_bits(alarm->days);
+        ptr = put_int(ptr, seconds_to_go(alarm->next, now));
+      }
+      break;
+
+    case cr_add:
+      if (length != 6) {
+        status = cs_bad_request;
+      } else {
+        recurrence_init(&new_alarm.rule);
+        new_alarm.display = 0;
+        new_alarm.trigger_time = get_int(request + 1);
+        for (i = 0; i < 7; i++) {
+          new_alarm.days[i] = (request[5] & (1 << i)) ? TRUE : FALSE;
+        }
+        if ((new_alarm.trigger_time < 0) ||
+            (new_alarm.trigger_time >= SECONDS_PER_DAY) ||
+            (request[5] > 0x7f)) {
+          status = cs_bad_request;
+        } else {
+          i = add_alarm(new_alarm);
+          if (i < 0) {
+            status = cs_full;
+          } else {
+            ptr = put_int(ptr, i);
+          }
+        }
+      }
+      break;
+
+    case cr_remove:
+      if (length != 5) {
+        status = cs_bad_request;
+      } else if (!remove_alarm(get_int(request + 1))) {
+        status = cs_not_found;
+      }
+      break;
+
+    case cr_snooze:
+      if (!control_hooks->snooze()) {
+        status = cs_nothing_to_do;
+      }
+      break;
+
+    case cr_dismiss:
+      if (!control_hooks->dismiss()) {
+        status = cs_nothing_to_do;
+      }
+      break;
+
+    case cr_metrics:
+      /*
+       * Whole lines only - the count goes in once we know it.
+       */
+      first = (length >= 5) ? get_int(request + 1) : 0;
+      if (first < 0) {
+        first = 0;
+      }
+      ptr = put_int(ptr, metrics_lines());
+      counted = ptr;
+      ptr += 4;
+      for (count = 0; first + count < metrics_lines(); count++) {
+        line_length = metrics_line(first + count, line, sizeof(line));
+        if ((ptr - reply) + line_length + 1 > MAX_MESSAGE) {
+          break;
+        }
+        memcpy(ptr, line, line_length);
+        ptr += line_length;
+        *ptr++ = '\n';
+      }
+      put_int(counted, count);
+      break;
+
+    case cr_dim:
+    case cr_bright:
+      if (control_hooks->set_dimmed(request[0] == cr_dim)) {
+        *repaint = TRUE;
+      } else {
+        status = cs_nothing_to_do;
+      }
+      break;
+
+    default:
+      status = cs_bad_request;
+      break;
+
+  }
+  QLOG_Debug(("Control request %d - status %d.\n", request[0], status));
+  if (status != cs_ok) {
+    ptr = reply + 1;
+  }
+  reply[0] = status;
+  return ptr - reply;
+}
@@ -0,0 +1,87 @@
+/*
+ *  Control socket.  Lets other programs look at and change the alarms
+ *  and the clock's state without editing config.yaml and restarting.
+ *
+ *  A Unix stream socket, with one request at a time per connection.
+ *  Every message in either direction is a 2-byte big-endian length
+ *  followed by that many bytes.  A request's first byte is one of the
+ *  t_control_request codes below and a reply's first byte is one of the
+ *  t_control_status codes.  Integers are 4-byte big-endian and a set of
+ *  days is one byte with bit 0 for Sunday.
+ *
+ *    cr_next    -                    -> next alarm id, seconds to go
+ *    cr_list    [first index]        -> total, count, then per alarm
+ *                                       id, time, days, seconds to go
+ *    cr_add     time, days           -> new alarm id
+ *    cr_remove  alarm id             -> -
+ *    cr_snooze  -                    -> -
+ *    cr_dismiss -                    -> -
+ *    cr_dim     -                    -> -
+ *    cr_bright  -                    -> -
+ *    cr_metrics [first line]         -> total, count, then that many
+ *                                       newline-terminated lines
+ *
+ *  Times are seconds since midnight.  Ids and seconds are -1 for none.
+ *  On a clock wall cr_next, cr_add and dismissing ahead of an alarm
+ *  are for the first display; snooze, dismiss and dim act wherever an
+ *  alarm is sounding or on every display.
+ *  A list or metrics reply holds as many as fit, so a client wanting
+ *  them all asks again starting from where the last one finished.
+ *  metrics.h describes the lines.
+ *
+ *  The socket is read on a thread of its own.  Each complete request
+ *  is passed to the main loop as an SDL event and dealt with there,
+ *  so nothing needs locking, and the reply is sent without waiting.
+ *  A client which isn't reading its replies gets disconnected rather
+ *  than holding up the display.
+ */
+
+/*
+ *================================================================
+ *
+ *  Type definitions.
+ *
+ *================================================================
+ */
+
+typedef enum {
+  cr_next = 1,
+  cr_list,
+  cr_add,
+  cr_remove,
+  cr_snooze,
+  cr_dismiss,
+  cr_dim,
+  cr_bright,
+  cr_metrics
+} t_control_request;
+
+typedef enum {
+  cs_ok,
+  cs_bad_request,
+  cs_not_found,
+  cs_full,
+  cs_nothing_to_do
+} t_control_status;
+
+/*
+ *  Supplied by the main program for the requests which affect its own
+ *  state.  Each returns TRUE if it did anything.
+ */
+typedef struct {
+  bool (*snooze)(void);
+  bool (*dismiss)(void);
+  bool (*set_dimmed)(bool dim);
+} t_control_hooks;
+
+/*
+ *================================================================
+ *
+ *  External declarations.
+ *
+ *================================================================
+ */
+
+extern void control_start(const t_control_hooks *hooks);
+
+extern void control_stop(void);
@@ -0,0 +1,194 @@
+/*
+ *  Event despatching.  See despatch.h.
+ *
+ *  SDL event types are 16 bits, and the ones in use are bunched
+ *  together in a few ranges, so the table is in two levels - the top
+ *  byte of the type picks a page and the bottom byte the handler on
+ *  it.  Pages are only set up for ranges which have a handler.
+ */
+
+#define NEED_SDL
+#include "includes.h"
+
+/*
+ *================================================================
+ *
+ *  Constants.
+ *
+ *================================================================
+ */
+
+#define PAGE_BITS 8
+#define PAGE_SIZE (1 << PAGE_BITS)
+#define MAX_TYPE  0xffff
+#define MAX_PAGES 8
+
+/*
+ *================================================================
+ *
+ *  Local data.
+ *
+ *================================================================
+ */
+
+static t_handler *directory[PAGE_SIZE];
+static t_handler  pages[MAX_PAGES][PAGE_SIZE];
+static int        num_pages = 0;
+
+static SDL_Event pending;
+static bool      have_pending = FALSE;
+
+static t_metric    despatched_metric = NO_METRIC;
+static t_metric    coalesced_metric = NO_METRIC;
+static t_histogram handler_histogram = NO_HISTOGRAM;
+
+/*
+ *================================================================
+ *
+ *  Forward declarations.
+ *
+ *================================================================
+ */
+
+static bool deliver(SDL_Event *event);
+
+static bool same_pointer(const SDL_Event *first, const SDL_Event *second);
+
+/*
+ *================================================================
+ *
+ *  Externally visible routines.
+ *
+ *================================================================
+ */
+
+void despatch_register(Uint32 type, t_handler handler) {
+  /*
+   * One handler per type - registering again replaces it.
+   */
+  t_handler *page;
+
+  if (despatched_metric == NO_METRIC) {
+    despatched_metric = metric_register("events despatched");
+    coalesced_metric = metric_register("motion events coalesced");
+    handler_histogram = histogram_register("event handling us");
+  }
+  if (type > MAX_TYPE) {
+    LOG_Error("Can't handle events of type %u.\n", (unsigned) type);
+  } else {
+    page = directory[type >> PAGE_BITS];
+    if ((page == NULL) && (num_pages < MAX_PAGES)) {
+      page = pages[num_pages++];
+      directory[type >> PAGE_BITS] = page;
+    }
+    if (page == NULL) {
+      LOG_Error("Out of despatch pages for event type %u.\n",
+                (unsigned) type);
+    } else {
+      page[type & (PAGE_SIZE - 1)] = handler;
+    }
+  }
+}
+
+bool despatch(SDL_Event *event) {
+  /*
+   * Hand the event to its handler - unless it's motion, which is kept
+   * back to see if more follows.  Returns TRUE if anything wants a
+   * repaint.
+   */
+  bool result = FALSE;
+
+  switch (event->type) {
+    case SDL_MOUSEMOTION:
+    case SDL_FINGERMOTION:
+      if (have_pending && same_pointer(&pending, event)) {
+        if (event->type == SDL_MOUSEMOTION) {
+          event->motion.xrel += pending.motion.xrel;
+          event->motion.yrel += pending.motion.yrel;
+        } else {
+          event->tfinger.dx += pending.tfinger.dx;
+          event->tfinger.dy += pending.tfinger.dy;
+        }
+        metric_add(coalesced_metric, 1);
+      } else {
+        result = despatch_flush();
+      }
+      pending = *event;
+      have_pending = TRUE;
+      break;
+
+    default:
+      result = despatch_flush();
+      if (deliver(event)) {
+        result = TRUE;
+      }
+      break;
+
+  }
+  return result;
+}
+
+bool despatch_flush(void) {
+  /*
+   * Deliver any motion being held back.  Called at the end of each
+   * batch of events.
+   */
+  bool result = FALSE;
+
+  if (have_pending) {
+    have_pending = FALSE;
+    result = deliver(&pending);
+  }
+  return result;
+}
+
+/*
+ *================================================================
+ *
+ *  Local routines.
+ *
+ *================================================================
+ */
+
+static bool deliver(SDL_Event *event) {
+  /*
+   * Times the handler as well, which is what a replay is measuring.
+   */
+  struct timespec finished;
+  t_handler       handler = NULL;
+  t_handler      *page;
+  bool            result = FALSE;
+  struct timespec started;
+
+  if (event->type <= MAX_TYPE) {
+    page = directory[event->type >> PAGE_BITS];
+    if (page != NULL) {
+      handler = page[event->type & (PAGE_SIZE - 1)];
+    }
+  }
+  if (handler != NULL) {
+    clock_gettime(CLOCK_MONOTONIC, &started);
+    result = handler(event);
+    clock_gettime(CLOCK_MONOTONIC, &finished);
+    metric_add(despatched_metric, 1);
+    histogram_add(handler_histogram,
+                  ((finished.tv_sec - started.tv_sec) * 1000000L) +
+                  ((finished.tv_nsec - started.tv_nsec) / 1000L));
+  }
+  return result;
+}
+
+
+static bool same_pointer(const SDL_Event *first, const SDL_Event *second) {
+  bool result = FALSE;
+
+  if (first->type == second->type) {
+    if (first->type == SDL_MOUSEMOTION) {
+      result = (first->motion.which == second->motion.which);
+    } else {
+      result = (first->tfinger.touchId == second->tfinger.touchId) &&
+               (first->tfinger.fingerId == second->tfinger.fingerId);
+    }
+  }
+  return result;
+}
@@ -0,0 +1,42 @@
+/*
+ *  Event despatching.  Handlers are registered against SDL event
+ *  types and found by table lookup, so the cost of despatching an
+ *  event doesn't depend on how many handlers there are.
+ *
+ *  Runs of pointer motion are coalesced - each batch of events polled
+ *  together delivers only the latest position of each mouse or finger,
+ *  with the relative movement of the ones it stands in for added in.
+ *  Motion is never held back past any other event, so the order in
+ *  which things happened is kept.
+ */
+
+/*
+ *================================================================
+ *
+ *  Type definitions.
+ *
+ *================================================================
+ */
+
+#if defined NEED_SDL
+/*
+ *  Returns TRUE if the screen needs repainting as a result.
+ */
+typedef bool (*t_handler)(SDL_Event *event);
+#endif
+
+/*
+ *================================================================
+ *
+ *  External declarations.
+ *
+ *================================================================
+ */
+
+#if defined NEED_SDL
+extern void despatch_register(Uint32 type, t_handler handler);
+
+extern bool despatch(SDL_Event *event);
+
+extern bool despatch_flush(void);
+#endif
@@ -0,0 +1,357 @@
+/*
+ *  Analogue clock face.  See dial.h.
+ *
+ *  Angles are in turns, clockwise from twelve o'clock.  Lengths are
+ *  fractions of the dial's radius so that the same hands suit it at
+ *  any size.
+ */
+
+#define NEED_SDL
+#include "includes.h"
+
+/*
+ *================================================================
+ *
+ *  Constants.
+ *
+ *================================================================
+ */
+
+#define PI 3.14159265358979
+
+#define NUM_TICKS      60
+#define TICK_OUTER     0.97
+#define TICK_INNER     0.91
+#define HOUR_INNER     0.84
+#define TICK_WIDTH     0.008
+#define HOUR_WIDTH     0.025
+#define NUMERAL_RADIUS 0.72
+
+/*
+ *  Each quad is two triangles.
+ */
+#define QUAD_VERTICES 4
+#define QUAD_INDICES  6
+
+/*
+ *  Hour, minute and second hands and a boss to cover where they meet.
+ */
+#define MAX_HAND_QUADS 4
+
+/*
+ *================================================================
+ *
+ *  Type definitions.
+ *
+ *================================================================
+ */
+
+typedef struct {
+  double length;
+  double tail;                /* How far it sticks out behind the centre */
+  double width;
+} t_hand;
+
+typedef struct {
+  SDL_Renderer *renderer;     /* Textures can't be shared between them */
+  SDL_Texture  *texture;
+  t_box         texture_size;
+} t_dial;
+
+/*
+ *================================================================
+ *
+ *  Local data.
+ *
+ *================================================================
+ */
+
+static const t_hand hour_hand   = { 0.50, 0.08, 0.050 };
+static const t_hand minute_hand = { 0.80, 0.10, 0.032 };
+static const t_hand second_hand = { 0.88, 0.18, 0.010 };
+static const t_hand boss        = { 0.04, 0.04, 0.080 };
+
+static t_dial dials[MAX_DISPLAYS];
+static int    num_dials = 0;
+
+static t_metric frames_metric = NO_METRIC;
+static t_metric time_metric = NO_METRIC;
+
+/*
+ *================================================================
+ *
+ *  Forward declarations.
+ *
+ *================================================================
+ */
+
+static int add_quad(
+    SDL_Vertex   *vertices,
+    int          *indices,
+    int           quads,
+    double        centre_x,
+    double        centre_y,
+    double        radius,
+    double        angle,
+    const t_hand *shape,
+    int           density);
+
+static void paint_numerals(
+    SDL_Renderer *renderer,
+    int           diameter,
+    t_face        numerals);
+
+static const t_dial *find_dial(SDL_Renderer *renderer);
+
+static long elapsed_us(const struct timespec *since);
+
+/*
+ *================================================================
+ *
+ *  Externally visible routines.
+ *
+ *================================================================
+ */
+
+void build_dial(
+    SDL_Renderer *renderer,
+    int           diameter,
+    t_face        numerals) {
+  /*
+   * Render thread only, and just the once for each display.  The dial
+   * is drawn at full strength on a transparent background so that it
+   * can be dimmed as it's copied.
+   */
+  t_dial    *dial;
+  int        i;
+  int        indices[NUM_TICKS * QUAD_INDICES];
+  double     radius;
+  t_hand     tick;
+  SDL_Vertex vertices[NUM_TICKS * QUAD_VERTICES];
+
+  frames_metric = metric_register("dial frames");
+  time_metric = metric_register("dial paint us");
+  dial = dials + num_dials;
+  dial->renderer = renderer;
+  dial->texture = SDL_CreateTexture(renderer,
+                                    SDL_PIXELFORMAT_ARGB8888,
+                                    SDL_TEXTUREACCESS_TARGET,
+                                    diameter,
+                                    diameter);
+  if ((dial->texture == NULL) ||
+      (SDL_SetRenderTarget(renderer, dial->texture) != 0)) {
+    LOG_Error("Failed to create the clock dial.\n");
+    if (dial->texture != NULL) {
+      SDL_DestroyTexture(dial->texture);
+      dial->texture = NULL;
+    }
+  } else {
+    num_dials++;
+    SDL_SetTextureBlendMode(dial->texture, SDL_BLENDMODE_BLEND);
+    dial->texture_size.width = diameter;
+    dial->texture_size.height = diameter;
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
+    SDL_RenderClear(renderer);
+    radius = diameter / 2.0;
+    for (i = 0; i < NUM_TICKS; i++) {
+      /*
+       * A tick is just a short hand held well away from the centre.
+       */
+      tick.length = TICK_OUTER;
+      tick.tail = (i % 5 == 0) ? -HOUR_INNER : -TICK_INNER;
+      tick.width = (i % 5 == 0) ? HOUR_WIDTH : TICK_WIDTH;
+      add_quad(vertices, indices, i, radius, radius, radius,
+               (double) i / NUM_TICKS, &tick, 255);
+    }
+    SDL_RenderGeometry(renderer, NULL,
+                       vertices, NUM_TICKS * QUAD_VERTICES,
+                       indices, NUM_TICKS * QUAD_INDICES);
+    batch_begin(renderer);
+    paint_numerals(renderer, diameter, numerals);
+    batch_flush();
+    SDL_SetRenderTarget(renderer, NULL);
+  }
+}
+
+void paint_dial(
+    SDL_Renderer    *renderer,
+    int              x,
+    int              y,
+    int              diameter,
+    const struct tm *tm,
+    double           seconds,
+    int              density) {
+  /*
+   * (x, y) is the top left corner.  seconds is where to put the second
+   * hand - it can be part way between two - or negative for none.
+   */
+  double          centre_x;
+  double          centre_y;
+  const t_dial   *dial;
+  int             indices[MAX_HAND_QUADS * QUAD_INDICES];
+  double          minutes;
+  int             quads = 0;
+  double          radius;
+  SDL_Rect        rectangle;
+  struct timespec started;
+  SDL_Vertex      vertices[MAX_HAND_QUADS * QUAD_VERTICES];
+
+  clock_gettime(CLOCK_MONOTONIC, &started);
+  dial = find_dial(renderer);
+  if (dial != NULL) {
+    rectangle.x = x;
+    rectangle.y = y;
+    rectangle.w = diameter;
+    rectangle.h = diameter;
+    batch_copy(dial->texture, dial->texture_size, NULL, &rectangle, density);
+  }
+  radius = diameter / 2.0;
+  centre_x = x + radius;
+  centre_y = y + radius;
+  minutes = tm->tm_min + ((seconds >= 0.0) ? seconds : tm->tm_sec) / 60.0;
+  quads = add_quad(vertices, indices, quads, centre_x, centre_y, radius,
+                   ((tm->tm_hour % 12) + minutes / 60.0) / 12.0,
+                   &hour_hand, density);
+  quads = add_quad(vertices, indices, quads, centre_x, centre_y, radius,
+                   minutes / 60.0,
+                   &minute_hand, density);
+  if (seconds >= 0.0) {
+    quads = add_quad(vertices, indices, quads, centre_x, centre_y, radius,
+                     seconds / 60.0,
+                     &second_hand, density);
+  }
+  quads = add_quad(vertices, indices, quads, centre_x, centre_y, radius,
+                   0.125, &boss, density);
+  batch_geometry(NULL,
+                 vertices, quads * QUAD_VERTICES,
+                 indices, quads * QUAD_INDICES);
+  metric_add(frames_metric, 1);
+  metric_add(time_metric, elapsed_us(&started));
+}
+
+void release_dial(void) {
+  int i;
+
+  for (i = 0; i < num_dials; i++) {
+    SDL_DestroyTexture(dials[i].texture);
+  }
+  num_dials = 0;
+}
+
+/*
+ *================================================================
+ *
+ *  Local routines.
+ *
+ *================================================================
+ */
+
+static int add_quad(
+    SDL_Vertex   *vertices,
+    int          *indices,
+    int           quads,
+    double        centre_x,
+    double        centre_y,
+    double        radius,
+    double        angle,
+    const t_hand *shape,
+    int           density) {
+  /*
+   * Add one hand-shaped quad to the batch.  Returns the new number of
+   * quads in it.
+   */
+  double      across_x;
+  double      across_y;
+  double      along_x;
+  double      along_y;
+  int         base;
+  double      half_width;
+  int         i;
+  double      points[QUAD_VERTICES][2];
+  SDL_Vertex *vertex;
+
+  along_x = sin(angle * 2.0 * PI) * radius;
+  along_y = -cos(angle * 2.0 * PI) * radius;
+  half_width = shape->width / 2.0;
+  across_x = -along_y * half_width;
+  across_y = along_x * half_width;
+  points[0][0] = centre_x - along_x * shape->tail - across_x;
+  points[0][1] = centre_y - along_y * shape->tail - across_y;
+  points[1][0] = centre_x - along_x * shape->tail + across_x;
+  points[1][1] = centre_y - along_y * shape->tail + across_y;
+  points[2][0] = centre_x + along_x * shape->length - across_x;
+  points[2][1] = centre_y + along_y * shape->length - across_y;
+  points[3][0] = centre_x + along_x * shape->length + across_x;
+  points[3][1] = centre_y + along_y * shape->length + across_y;
+  base = quads * QUAD_VERTICES;
+  for (i = 0; i < QUAD_VERTICES; i++) {
+    vertex = vertices + base + i;
+    vertex->position.x = points[i][0];
+    vertex->position.y = points[i][1];
+    vertex->color.r = density;
+    vertex->color.g = density;
+    vertex->color.b = density;
+    vertex->color.a = 255;
+    vertex->tex_coord.x = 0.0;
+    vertex->tex_coord.y = 0.0;
+  }
+  indices += quads * QUAD_INDICES;
+  indices[0] = base;
+  indices[1] = base + 1;
+  indices[2] = base + 2;
+  indices[3] = base + 2;
+  indices[4] = base + 1;
+  indices[5] = base + 3;
+  return quads + 1;
+}
+
+
+static void paint_numerals(
+    SDL_Renderer *renderer,
+    int           diameter,
+    t_face        numerals) {
+  /*
+   * Straight from the face's glyph atlas into the dial.
+   */
+  double angle;
+  t_box  box;
+  int    hour;
+  double radius;
+  char   text[3];
+
+  radius = diameter / 2.0;
+  for (hour = 1; hour <= 12; hour++) {
+    sprintf(text, "%d", hour);
+    box = size_face_text(numerals, text);
+    angle = hour / 12.0 * 2.0 * PI;
+    paint_face_text(renderer, text, numerals, h_left, v_top,
+                    (int) (radius + sin(angle) * radius * NUMERAL_RADIUS -
+                           box.width / 2.0),
+                    (int) (radius - cos(angle) * radius * NUMERAL_RADIUS -
+                           box.height / 2.0),
+                    255);
+  }
+}
+
+
+static const t_dial *find_dial(SDL_Renderer *renderer) {
+  int           i;
+  const t_dial *result = NULL;
+
+  for (i = 0; i < num_dials; i++) {
+    if (dials[i].renderer == renderer) {
+      result = dials + i;
+      break;
+    }
+  }
+  return result;
+}
+
+
+static long elapsed_us(const struct timespec *since) {
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return ((now.tv_sec - since->tv_sec) * 1000000L) +
+         ((now.tv_nsec - since->tv_nsec) / 1000L);
+}
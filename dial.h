@@ -0,0 +1,33 @@
+/*
+ *  Analogue clock face.  Everything which doesn't move - ticks and
+ *  numerals - is drawn once into a texture (one for each display, as
+ *  textures belong to a renderer) by build_dial().  Each
+ *  frame is then one copy of that and the hands, which go into the
+ *  frame's batch (see batch.h) as a single lot of triangles.
+ */
+
+/*
+ *================================================================
+ *
+ *  External declarations.
+ *
+ *================================================================
+ */
+
+#if defined NEED_SDL
+extern void build_dial(
+    SDL_Renderer *renderer,
+    int           diameter,
+    t_face        numerals);
+
+extern void paint_dial(
+    SDL_Renderer    *renderer,
+    int              x,
+    int              y,
+    int              diameter,
+    const struct tm *tm,
+    double           seconds,
+    int              density);
+
+extern void release_dial(void);
+#endif
@@ -0,0 +1,175 @@
+/*
+ *  Build-time tool which decodes the bundled menu icon and alarm sound
+ *  into ready-to-use pixels and PCM, and writes them out as C source
+ *  to be linked into the clock (see assets.h).  Run by the Makefile
+ *  as:
+ *
+ *    embed menu.png Alarm_Classic.ogg > assets.c
+ */
+
+#define NEED_SDL
+#include "includes.h"
+
+/*
+ *================================================================
+ *
+ *  Constants.
+ *
+ *================================================================
+ */
+
+#define BYTES_PER_LINE   12
+#define SAMPLES_PER_LINE 10
+
+/*
+ *================================================================
+ *
+ *  Forward declarations.
+ *
+ *================================================================
+ */
+
+static bool write_pixels(const char *file_name);
+
+static bool write_pcm(const char *file_name);
+
+/*
+ *================================================================
+ *
+ *  Entry point.
+ *
+ *================================================================
+ */
+
+int main(int argc, char *argv[]) {
+  bool result = FALSE;
+
+  if (argc != 3) {
+    fprintf(stderr, "Usage: %s <icon.png> <sound.ogg> > assets.c\n", argv[0]);
+  } else {
+    SDL_setenv("SDL_AUDIODRIVER", "dummy", 1);
+    if (SDL_Init(SDL_INIT_AUDIO) != 0) {
+      fprintf(stderr, "Failed to initialise SDL - %s\n", SDL_GetError());
+    } else {
+      printf("/*\n"
+             " *  Generated by embed from %s and %s - don't edit.\n"
+             " */\n"
+             "\n"
+             "#include \"assets.h\"\n",
+             argv[1],
+             argv[2]);
+      result = write_pixels(argv[1]) && write_pcm(argv[2]);
+      SDL_Quit();
+    }
+  }
+  return result ? 0 : 1;
+}
+
+/*
+ *================================================================
+ *
+ *  Local routines.
+ *
+ *================================================================
+ */
+
+static bool write_pixels(const char *file_name) {
+  const Uint8 *row;
+  SDL_Surface *converted = NULL;
+  int          flags = IMG_INIT_PNG;
+  int          i;
+  bool         result = FALSE;
+  SDL_Surface *surface = NULL;
+  int          x;
+  int          y;
+
+  if ((IMG_Init(flags) & flags) == 0) {
+    fprintf(stderr, "Failed to initialise image handling.\n");
+  } else if ((surface = IMG_Load(file_name)) == NULL) {
+    fprintf(stderr, "Failed to load \"%s\".\n", file_name);
+  } else if ((converted =
+              SDL_ConvertSurfaceFormat(surface, MENU_PIXEL_FORMAT, 0)) ==
+             NULL) {
+    fprintf(stderr, "Failed to convert \"%s\" - %s\n",
+            file_name,
+            SDL_GetError());
+  } else {
+    SDL_LockSurface(converted);
+    printf("\nconst int builtin_menu_width = %d;\n"
+           "const int builtin_menu_height = %d;\n"
+           "const unsigned char builtin_menu_pixels[] = {",
+           converted->w,
+           converted->h);
+    i = 0;
+    for (y = 0; y < converted->h; y++) {
+      row = (const Uint8 *) converted->pixels + y * converted->pitch;
+      for (x = 0; x < converted->w * MENU_PIXEL_BYTES; x++) {
+        printf("%s0x%02x,", ((i++ % BYTES_PER_LINE) == 0) ? "\n  " : " ",
+               row[x]);
+      }
+    }
+    printf("\n};\n");
+    SDL_UnlockSurface(converted);
+    result = TRUE;
+  }
+  if (converted != NULL) {
+    SDL_FreeSurface(converted);
+  }
+  if (surface != NULL) {
+    SDL_FreeSurface(surface);
+  }
+  IMG_Quit();
+  return result;
+}
+
+
+static bool write_pcm(const char *file_name) {
+  /*
+   * Mix_LoadWAV() decodes to whatever the mixer is open at, so open it
+   * at just the format the clock asks for.
+   */
+  int           channels;
+  Mix_Chunk    *chunk = NULL;
+  Uint16        format;
+  int           frequency;
+  long          i;
+  bool          result = FALSE;
+  const Sint16 *samples;
+
+  Mix_Init(MIX_INIT_OGG);
+  if (Mix_OpenAudio(AUDIO_FREQUENCY,
+                    MIX_DEFAULT_FORMAT,
+                    AUDIO_CHANNELS,
+                    AUDIO_CHUNK_SIZE) != 0) {
+    fprintf(stderr, "Failed to open audio - %s\n", Mix_GetError());
+  } else {
+    Mix_QuerySpec(&frequency, &format, &channels);
+    if ((frequency != AUDIO_FREQUENCY) ||
+        (format != MIX_DEFAULT_FORMAT) ||
+        (channels != AUDIO_CHANNELS)) {
+      fprintf(stderr, "Mixer opened at %d Hz, format 0x%x, %d channels.\n",
+              frequency,
+              format,
+              channels);
+    } else if ((chunk = Mix_LoadWAV(file_name)) == NULL) {
+      fprintf(stderr, "Failed to load \"%s\" - %s\n",
+              file_name,
+              Mix_GetError());
+    } else {
+      samples = (const Sint16 *) chunk->abuf;
+      printf("\nconst long builtin_alarm_length = %lu;\n"
+             "const short builtin_alarm_pcm[] = {",
+             (unsigned long) chunk->alen);
+      for (i = 0; i < (long) (chunk->alen / sizeof(Sint16)); i++) {
+        printf("%s%d,", ((i % SAMPLES_PER_LINE) == 0) ? "\n  " : " ",
+               samples[i]);
+      }
+      printf("\n};\n");
+      Mix_FreeChunk(chunk);
+      result = TRUE;
+    }
+    Mix_CloseAudio();
+  }
+  Mix_Quit();
+  return result;
+}
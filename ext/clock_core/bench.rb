@@ -0,0 +1,97 @@
+#
+#  Times clock.rb's timer queue both ways - the plain Ruby SortedQueue
+#  against the extension's ClockCore::TimerQueue - with Alarmer's two
+#  patterns of use: filling up and draining, and a set of recurring
+#  timers each put back on when it comes off.
+#
+#  Then its text both ways - MyDisplay#paint_text making a surface and
+#  texture for each string, against ClockCore::Text painting from glyph
+#  atlases - a frame of the time and date at a time, in hidden windows
+#  on SDL's offscreen driver.  From the top level:
+#
+#    make ruby_bench
+#
+ENV['SDL_VIDEODRIVER'] ||= 'offscreen'
+ENV['SDL_AUDIODRIVER'] ||= 'dummy'
+
+require 'benchmark'
+require_relative '../../sorted_queue'
+require_relative '../../my_display'
+require_relative 'clock_core'
+
+QUEUES = {
+  'SortedQueue'           => SortedQueue,
+  'ClockCore::TimerQueue' => ClockCore::TimerQueue
+}
+SIZES = [10, 100, 1000]
+OPERATIONS = 20_000             # Queue operations per measurement
+
+#
+#  As AlarmClock uses them.
+#
+TIME_FONT = ['/usr/share/fonts/truetype/freefont/FreeSerifBoldItalic.ttf', 240]
+DATE_FONT = ['/usr/share/fonts/truetype/freefont/FreeSerif.ttf', 50]
+FRAMES = 200
+WindowConfig = Struct.new(:title, :screen_width, :screen_height)
+
+def fill_and_drain(queue, times)
+  times.each_with_index { |time, index| queue.push(time, index) }
+  queue.shift until queue.empty?
+end
+
+def recurring(queue, times, cycles)
+  times.each_with_index { |time, index| queue.push(time, [time, index]) }
+  cycles.times do
+    time, index = queue.shift
+    queue.push(time + 60.0 + index, [time + 60.0 + index, index])
+  end
+end
+
+def paint_frames(display, time_font, date_font, frames)
+  frames.times do |frame|
+    display.blank_buffer
+    display.paint_text(format('%02d:%02d', (frame / 60) % 24, frame % 60),
+                       time_font, :centre, :middle, 0, -30, 255)
+    display.paint_text('Monday 10th June', date_font,
+                       :centre, :middle, 0, 100, 255)
+    display.do_display
+  end
+end
+
+random = Random.new(1)
+Benchmark.bm(32) do |bench|
+  SIZES.each do |size|
+    times = Array.new(size) { random.rand(3600.0) }
+    rounds = OPERATIONS / (2 * size)
+    QUEUES.each do |name, queue_class|
+      bench.report("#{name} fill #{size}") do
+        rounds.times { fill_and_drain(queue_class.new, times) }
+      end
+      bench.report("#{name} recur #{size}") do
+        recurring(queue_class.new, times, OPERATIONS / 2)
+      end
+    end
+  end
+end
+
+#
+#  Each display gets ClockCore::Text as the extension's loaded - the
+#  plain Ruby one has it taken away again.
+#
+config = WindowConfig.new('bench', 1024, 600)
+plain = MyDisplay.new(config)
+plain.remove_instance_variable(:@text)
+DISPLAYS = {
+  'MyDisplay#paint_text' => plain,
+  'ClockCore::Text'      => MyDisplay.new(config)
+}
+Benchmark.bm(32) do |bench|
+  DISPLAYS.each do |name, display|
+    time_font = display.open_font(*TIME_FONT)
+    date_font = display.open_font(*DATE_FONT)
+    paint_frames(display, time_font, date_font, 1)
+    bench.report("#{name} #{FRAMES} frames") do
+      paint_frames(display, time_font, date_font, FRAMES)
+    end
+  end
+end
@@ -0,0 +1,177 @@
+/*
+ *  The C clock's side of the Ruby extension.  See bridge.h.
+ *
+ *  Everything works on the first display, as clock.rb only has the
+ *  one.
+ */
+
+#define NEED_SDL
+#include "includes.h"
+#include "bridge.h"
+
+/*
+ *================================================================
+ *
+ *  Local data.
+ *
+ *================================================================
+ */
+
+static const t_href hrefs[] = { h_left, h_right, h_centre, h_random };
+static const t_vref vrefs[] = { v_top, v_middle, v_bottom, v_random };
+
+static SDL_Renderer *frame_renderer = NULL;   /* Between begin and end */
+
+/*
+ *================================================================
+ *
+ *  Externally visible routines.
+ *
+ *================================================================
+ */
+
+void bridge_init(void) {
+  /*
+   * Once, when the extension is loaded.  SDL itself belongs to
+   * ruby-sdl2 and is brought up by clock.rb.
+   */
+  qlog_init();
+  vclock_init();
+  quality_init();
+  init_fonts();
+}
+
+int bridge_add_alarm(
+    const char        *time,
+    const char *const *days,
+    int                num_days) {
+  /*
+   * time is as it would be in the config file.  With no days it goes
+   * off every day.  Returns the new alarm's id, or -1 if the time or
+   * one of the days doesn't make sense or there's no room for it.
+   */
+  int                day;
+  int                i;
+  t_individual_alarm new_alarm;
+  int                result = -1;
+
+  memset(&new_alarm, 0, sizeof(new_alarm));
+  recurrence_init(&new_alarm.rule);
+  new_alarm.display = 0;
+  new_alarm.trigger_time = interpret_alarm_time((yaml_char_t *) time);
+  for (i = 0; i < 7; i++) {
+    new_alarm.days[i] = (num_days == 0);
+  }
+  for (i = 0; i < num_days; i++) {
+    day = identify_alarm_day((yaml_char_t *) days[i]);
+    if (day < 0) {
+      break;
+    }
+    new_alarm.days[day] = TRUE;
+  }
+  if ((i == num_days) &&
+      (new_alarm.trigger_time >= 0) &&
+      (new_alarm.trigger_time < 24 * 60 * 60)) {
+    result = add_alarm(new_alarm);
+  }
+  return result;
+}
+
+int bridge_remove_alarm(int id) {
+  return remove_alarm(id);
+}
+
+int bridge_alarms_due(long previous, long now) {
+  bool due[MAX_DISPLAYS];
+
+  return alarms_due((time_t) previous, (time_t) now, due);
+}
+
+int bridge_seconds_until_next_alarm(long now) {
+  return seconds_until_next_alarm(0, (time_t) now);
+}
+
+int bridge_next_alarm_id(void) {
+  return next_alarm_id(0);
+}
+
+int bridge_find_face(const char *file_name, int size) {
+  return find_face(file_name, size);
+}
+
+void bridge_size_text(
+    int         face,
+    const char *text,
+    int        *width,
+    int        *height) {
+
+  t_box box;
+
+  box = size_face_text(face, text);
+  *width = box.width;
+  *height = box.height;
+}
+
+int bridge_begin_frame(unsigned long window_id) {
+  /*
+   * Text is collected into a batch (see batch.h) until the frame ends.
+   * ruby-sdl2 doesn't give out its renderer so it's found from the
+   * window instead.  Returns FALSE if there's no such window.
+   */
+  SDL_Window *window;
+  int         result = FALSE;
+
+  window = SDL_GetWindowFromID(window_id);
+  frame_renderer = (window != NULL) ? SDL_GetRenderer(window) : NULL;
+  if (frame_renderer != NULL) {
+    quality_pass_begin(FALSE);
+    batch_begin(frame_renderer);
+    result = TRUE;
+  }
+  return result;
+}
+
+void bridge_paint_text(
+    const char *text,
+    int         face,
+    int         href,
+    int         vref,
+    int         hoff,
+    int         voff,
+    int         density) {
+
+  if (frame_renderer != NULL) {
+    paint_face_text(frame_renderer, text, face,
+                    hrefs[href], vrefs[vref], hoff, voff, density);
+  }
+}
+
+void bridge_end_frame(void) {
+  if (frame_renderer != NULL) {
+    batch_end();
+    improve_fonts();
+    quality_pass_end(TRUE);
+    frame_renderer = NULL;
+  }
+}
+
+int bridge_wait_event(int timeout_ms) {
+  /*
+   * Until there's an event, leaving it on the queue for ruby-sdl2 to
+   * poll.  A negative timeout waits for as long as it takes.  Returns
+   * TRUE if there's an event waiting.
+   */
+  return (timeout_ms < 0) ? SDL_WaitEvent(NULL)
+                          : SDL_WaitEventTimeout(NULL, timeout_ms);
+}
+
+void bridge_wake(void) {
+  /*
+   * Cut short a bridge_wait_event() from another thread.
+   */
+  SDL_Event event;
+
+  memset(&event, 0, sizeof(event));
+  event.type = SDL_USEREVENT;
+  SDL_PushEvent(&event);
+}
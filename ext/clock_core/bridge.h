@@ -0,0 +1,78 @@
+/*
+ *  The C clock's side of the Ruby extension.  Ruby's headers and the
+ *  spirit library's each have their own idea of bool, so the binding
+ *  (clock_core.c) sees only this - plain ints and strings - and
+ *  bridge.c, which sees only includes.h, passes the calls on to the
+ *  alarm index and the glyph atlases.
+ */
+
+/*
+ *================================================================
+ *
+ *  Constants.
+ *
+ *================================================================
+ */
+
+/*
+ *  Reference points, in the same order as fonts.h.  BRIDGE_RANDOM is
+ *  for either direction.
+ */
+#define BRIDGE_LEFT   0
+#define BRIDGE_RIGHT  1
+#define BRIDGE_CENTRE 2
+#define BRIDGE_RANDOM 3
+
+#define BRIDGE_TOP    0
+#define BRIDGE_MIDDLE 1
+#define BRIDGE_BOTTOM 2
+
+#define BRIDGE_NO_FACE -1
+
+/*
+ *================================================================
+ *
+ *  External declarations.
+ *
+ *================================================================
+ */
+
+extern void bridge_init(void);
+
+extern int bridge_add_alarm(
+    const char        *time,
+    const char *const *days,
+    int                num_days);
+
+extern int bridge_remove_alarm(int id);
+
+extern int bridge_alarms_due(long previous, long now);
+
+extern int bridge_seconds_until_next_alarm(long now);
+
+extern int bridge_next_alarm_id(void);
+
+extern int bridge_find_face(const char *file_name, int size);
+
+extern void bridge_size_text(
+    int         face,
+    const char *text,
+    int        *width,
+    int        *height);
+
+extern int bridge_begin_frame(unsigned long window_id);
+
+extern void bridge_paint_text(
+    const char *text,
+    int         face,
+    int         href,
+    int         vref,
+    int         hoff,
+    int         voff,
+    int         density);
+
+extern void bridge_end_frame(void);
+
+extern int bridge_wait_event(int timeout_ms);
+
+extern void bridge_wake(void);
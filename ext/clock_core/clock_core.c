@@ -0,0 +1,566 @@
+/*
+ *  clock_core - the C clock's alarm index and glyph atlases, and a
+ *  timer queue, for clock.rb.
+ *
+ *    ClockCore.add_alarm(time, days = nil)    New alarm's id, or nil
+ *    ClockCore.remove_alarm(id)               true if there was one
+ *    ClockCore.alarms_due?(previous, now)     Anything gone off between?
+ *    ClockCore.seconds_until_next_alarm(now)  nil if nothing will
+ *    ClockCore.next_alarm_id                  nil if nothing will
+ *    ClockCore.wait_event(timeout)            Block until there's an SDL
+ *                                             event to poll, for at most
+ *                                             timeout seconds (nil for
+ *                                             no limit).  true if there
+ *                                             is one.
+ *
+ *    ClockCore::TimerQueue.new
+ *      #push(time, item)   Items come out earliest first, and in the
+ *      #next_time          order they went in for the same time.
+ *      #shift              next_time and shift give nil when empty.
+ *      #size, #empty?
+ *
+ *    ClockCore::Text.new(window)
+ *      #face(file, size)   A face to pass to the others.
+ *      #size(text, face)   [width, height]
+ *      #begin_frame        Paint between these two - see batch.h.
+ *      #paint(text, face, href, vref, hoff, voff, density)
+ *      #end_frame
+ *
+ *  Times are Time objects or seconds since the epoch.  Alarm times and
+ *  days are as in the config file.  The references are the same
+ *  symbols as MyDisplay#paint_text takes.
+ */
+
+#include <math.h>
+#include <limits.h>
+#include <ruby.h>
+#include <ruby/thread.h>
+#include "bridge.h"
+
+/*
+ *================================================================
+ *
+ *  Constants.
+ *
+ *================================================================
+ */
+
+#define INITIAL_TIMERS 16
+#define MAX_DAYS       7
+
+/*
+ *================================================================
+ *
+ *  Type definitions.
+ *
+ *================================================================
+ */
+
+typedef struct {
+  double        time;
+  unsigned long order;        /* Keeps equal times first in, first out */
+  VALUE         item;
+} t_timer;
+
+typedef struct {
+  t_timer      *heap;
+  long          size;
+  long          capacity;
+  unsigned long pushed;
+} t_timer_queue;
+
+typedef struct {
+  unsigned long window_id;
+} t_text;
+
+typedef struct {
+  int timeout_ms;             /* Negative for no limit */
+  int result;
+} t_wait;
+
+/*
+ *================================================================
+ *
+ *  Local data.
+ *
+ *================================================================
+ */
+
+static ID id_to_f;
+static ID id_to_i;
+static ID id_to_s;
+static ID id_window_id;
+static ID id_left;
+static ID id_right;
+static ID id_centre;
+static ID id_top;
+static ID id_middle;
+static ID id_bottom;
+static ID id_random;
+
+static void timer_queue_mark(void *data);
+static void timer_queue_free(void *data);
+static size_t timer_queue_size(const void *data);
+
+static const rb_data_type_t timer_queue_type = {
+  "ClockCore::TimerQueue",
+  { timer_queue_mark, timer_queue_free, timer_queue_size },
+  NULL,
+  NULL,
+  RUBY_TYPED_FREE_IMMEDIATELY
+};
+
+static const rb_data_type_t text_type = {
+  "ClockCore::Text",
+  { NULL, RUBY_TYPED_DEFAULT_FREE, NULL },
+  NULL,
+  NULL,
+  RUBY_TYPED_FREE_IMMEDIATELY
+};
+
+/*
+ *================================================================
+ *
+ *  Forward declarations.
+ *
+ *================================================================
+ */
+
+static VALUE core_add_alarm(int argc, VALUE *argv, VALUE self);
+
+static VALUE core_remove_alarm(VALUE self, VALUE id);
+
+static VALUE core_alarms_due(VALUE self, VALUE previous, VALUE now);
+
+static VALUE core_seconds_until_next_alarm(VALUE self, VALUE now);
+
+static VALUE core_next_alarm_id(VALUE self);
+
+static VALUE core_wait_event(VALUE self, VALUE timeout);
+
+static void *wait_without_gvl(void *data);
+
+static void wake_waiter(void *unused);
+
+static VALUE timer_queue_alloc(VALUE klass);
+
+static VALUE timer_queue_push(VALUE self, VALUE time, VALUE item);
+
+static VALUE timer_queue_next_time(VALUE self);
+
+static VALUE timer_queue_shift(VALUE self);
+
+static VALUE timer_queue_length(VALUE self);
+
+static VALUE timer_queue_empty(VALUE self);
+
+static int earlier(const t_timer *first, const t_timer *second);
+
+static VALUE text_alloc(VALUE klass);
+
+static VALUE text_initialize(VALUE self, VALUE window);
+
+static VALUE text_face(VALUE self, VALUE file, VALUE size);
+
+static VALUE text_size(VALUE self, VALUE text, VALUE face);
+
+static VALUE text_begin_frame(VALUE self);
+
+static VALUE text_paint(int argc, VALUE *argv, VALUE self);
+
+static VALUE text_end_frame(VALUE self);
+
+static int reference(VALUE symbol, int vertical);
+
+static long seconds(VALUE time);
+
+/*
+ *================================================================
+ *
+ *  Entry point.
+ *
+ *================================================================
+ */
+
+void Init_clock_core(void) {
+  VALUE core;
+  VALUE text;
+  VALUE timer_queue;
+
+  id_to_f      = rb_intern("to_f");
+  id_to_i      = rb_intern("to_i");
+  id_to_s      = rb_intern("to_s");
+  id_window_id = rb_intern("window_id");
+  id_left      = rb_intern("left");
+  id_right     = rb_intern("right");
+  id_centre    = rb_intern("centre");
+  id_top       = rb_intern("top");
+  id_middle    = rb_intern("middle");
+  id_bottom    = rb_intern("bottom");
+  id_random    = rb_intern("random");
+  bridge_init();
+
+  core = rb_define_module("ClockCore");
+  rb_define_module_function(core, "add_alarm", core_add_alarm, -1);
+  rb_define_module_function(core, "remove_alarm", core_remove_alarm, 1);
+  rb_define_module_function(core, "alarms_due?", core_alarms_due, 2);
+  rb_define_module_function(core, "seconds_until_next_alarm",
+                            core_seconds_until_next_alarm, 1);
+  rb_define_module_function(core, "next_alarm_id", core_next_alarm_id, 0);
+  rb_define_module_function(core, "wait_event", core_wait_event, 1);
+
+  timer_queue = rb_define_class_under(core, "TimerQueue", rb_cObject);
+  rb_define_alloc_func(timer_queue, timer_queue_alloc);
+  rb_define_method(timer_queue, "push", timer_queue_push, 2);
+  rb_define_method(timer_queue, "next_time", timer_queue_next_time, 0);
+  rb_define_method(timer_queue, "shift", timer_queue_shift, 0);
+  rb_define_method(timer_queue, "size", timer_queue_length, 0);
+  rb_define_method(timer_queue, "empty?", timer_queue_empty, 0);
+
+  text = rb_define_class_under(core, "Text", rb_cObject);
+  rb_define_alloc_func(text, text_alloc);
+  rb_define_method(text, "initialize", text_initialize, 1);
+  rb_define_method(text, "face", text_face, 2);
+  rb_define_method(text, "size", text_size, 2);
+  rb_define_method(text, "begin_frame", text_begin_frame, 0);
+  rb_define_method(text, "paint", text_paint, -1);
+  rb_define_method(text, "end_frame", text_end_frame, 0);
+}
+
+/*
+ *================================================================
+ *
+ *  Local routines.
+ *
+ *================================================================
+ */
+
+static VALUE core_add_alarm(int argc, VALUE *argv, VALUE self) {
+  /*
+   * A time which is already a number of seconds is passed on as its
+   * text, as the config file would give it.
+   */
+  VALUE       days;
+  const char *day_names[MAX_DAYS];
+  int         i;
+  int         id;
+  int         num_days = 0;
+  VALUE       time;
+
+  rb_scan_args(argc, argv, "11", &time, &days);
+  time = rb_funcall(time, id_to_s, 0);
+  if (!NIL_P(days)) {
+    Check_Type(days, T_ARRAY);
+    if (RARRAY_LEN(days) > MAX_DAYS) {
+      rb_raise(rb_eArgError, "more than %d days", MAX_DAYS);
+    }
+    num_days = (int) RARRAY_LEN(days);
+    for (i = 0; i < num_days; i++) {
+      day_names[i] = StringValueCStr(RARRAY_PTR(days)[i]);
+    }
+  }
+  id = bridge_add_alarm(StringValueCStr(time), day_names, num_days);
+  return (id < 0) ? Qnil : INT2NUM(id);
+}
+
+
+static VALUE core_remove_alarm(VALUE self, VALUE id) {
+  return bridge_remove_alarm(NUM2INT(id)) ? Qtrue : Qfalse;
+}
+
+
+static VALUE core_alarms_due(VALUE self, VALUE previous, VALUE now) {
+  return bridge_alarms_due(seconds(previous), seconds(now)) ? Qtrue : Qfalse;
+}
+
+
+static VALUE core_seconds_until_next_alarm(VALUE self, VALUE now) {
+  int result;
+
+  result = bridge_seconds_until_next_alarm(seconds(now));
+  return (result < 0) ? Qnil : INT2NUM(result);
+}
+
+
+static VALUE core_next_alarm_id(VALUE self) {
+  int result;
+
+  result = bridge_next_alarm_id();
+  return (result < 0) ? Qnil : INT2NUM(result);
+}
+
+
+static VALUE core_wait_event(VALUE self, VALUE timeout) {
+  /*
+   * Other Ruby threads carry on while we wait.  The timeout is rounded
+   * up so that we don't wake just short of a deadline.
+   */
+  double ms;
+  t_wait wait;
+
+  wait.timeout_ms = -1;
+  if (!NIL_P(timeout)) {
+    ms = ceil(NUM2DBL(timeout) * 1000.0);
+    wait.timeout_ms = (ms < 0.0) ? 0 : (ms > INT_MAX) ? INT_MAX : (int) ms;
+  }
+  wait.result = 0;
+  rb_thread_call_without_gvl(wait_without_gvl, &wait, wake_waiter, NULL);
+  return wait.result ? Qtrue : Qfalse;
+}
+
+
+static void *wait_without_gvl(void *data) {
+  t_wait *wait = data;
+
+  wait->result = bridge_wait_event(wait->timeout_ms);
+  return NULL;
+}
+
+
+static void wake_waiter(void *unused) {
+  bridge_wake();
+}
+
+
+static void timer_queue_mark(void *data) {
+  t_timer_queue *queue = data;
+  long           i;
+
+  for (i = 0; i < queue->size; i++) {
+    rb_gc_mark(queue->heap[i].item);
+  }
+}
+
+
+static void timer_queue_free(void *data) {
+  t_timer_queue *queue = data;
+
+  xfree(queue->heap);
+  xfree(queue);
+}
+
+
+static size_t timer_queue_size(const void *data) {
+  const t_timer_queue *queue = data;
+
+  return sizeof(t_timer_queue) + queue->capacity * sizeof(t_timer);
+}
+
+
+static VALUE timer_queue_alloc(VALUE klass) {
+  t_timer_queue *queue;
+  VALUE          result;
+
+  result = TypedData_Make_Struct(klass, t_timer_queue, &timer_queue_type,
+                                 queue);
+  queue->heap = ALLOC_N(t_timer, INITIAL_TIMERS);
+  queue->capacity = INITIAL_TIMERS;
+  return result;
+}
+
+
+static VALUE timer_queue_push(VALUE self, VALUE time, VALUE item) {
+  /*
+   * Onto the end of the heap, then up past anything later.
+   */
+  t_timer        entry;
+  long           parent;
+  long           position;
+  t_timer_queue *queue;
+
+  TypedData_Get_Struct(self, t_timer_queue, &timer_queue_type, queue);
+  entry.time = NUM2DBL(rb_funcall(time, id_to_f, 0));
+  entry.order = queue->pushed++;
+  entry.item = item;
+  if (queue->size == queue->capacity) {
+    queue->capacity *= 2;
+    REALLOC_N(queue->heap, t_timer, queue->capacity);
+  }
+  position = queue->size++;
+  while (position > 0) {
+    parent = (position - 1) / 2;
+    if (!earlier(&entry, queue->heap + parent)) {
+      break;
+    }
+    queue->heap[position] = queue->heap[parent];
+    position = parent;
+  }
+  queue->heap[position] = entry;
+  return self;
+}
+
+
+static VALUE timer_queue_next_time(VALUE self) {
+  t_timer_queue *queue;
+
+  TypedData_Get_Struct(self, t_timer_queue, &timer_queue_type, queue);
+  return (queue->size > 0) ? rb_float_new(queue->heap[0].time) : Qnil;
+}
+
+
+static VALUE timer_queue_shift(VALUE self) {
+  /*
+   * Take the top off, then sift the last entry down from there.
+   */
+  long           child;
+  t_timer        last;
+  long           position;
+  t_timer_queue *queue;
+  VALUE          result = Qnil;
+
+  TypedData_Get_Struct(self, t_timer_queue, &timer_queue_type, queue);
+  if (queue->size > 0) {
+    result = queue->heap[0].item;
+    last = queue->heap[--queue->size];
+    position = 0;
+    while ((child = (position * 2) + 1) < queue->size) {
+      if ((child + 1 < queue->size) &&
+          earlier(queue->heap + child + 1, queue->heap + child)) {
+        child++;
+      }
+      if (!earlier(queue->heap + child, &last)) {
+        break;
+      }
+      queue->heap[position] = queue->heap[child];
+      position = child;
+    }
+    if (queue->size > 0) {
+      queue->heap[position] = last;
+    }
+  }
+  return result;
+}
+
+
+static VALUE timer_queue_length(VALUE self) {
+  t_timer_queue *queue;
+
+  TypedData_Get_Struct(self, t_timer_queue, &timer_queue_type, queue);
+  return LONG2NUM(queue->size);
+}
+
+
+static VALUE timer_queue_empty(VALUE self) {
+  t_timer_queue *queue;
+
+  TypedData_Get_Struct(self, t_timer_queue, &timer_queue_type, queue);
+  return (queue->size == 0) ? Qtrue : Qfalse;
+}
+
+
+static int earlier(const t_timer *first, const t_timer *second) {
+  return (first->time < second->time) ||
+         ((first->time == second->time) && (first->order < second->order));
+}
+
+
+static VALUE text_alloc(VALUE klass) {
+  t_text *text;
+
+  return TypedData_Make_Struct(klass, t_text, &text_type, text);
+}
+
+
+static VALUE text_initialize(VALUE self, VALUE window) {
+  /*
+   * Either an SDL2::Window or its id.
+   */
+  t_text *text;
+
+  TypedData_Get_Struct(self, t_text, &text_type, text);
+  if (rb_respond_to(window, id_window_id)) {
+    window = rb_funcall(window, id_window_id, 0);
+  }
+  text->window_id = NUM2ULONG(window);
+  return self;
+}
+
+
+static VALUE text_face(VALUE self, VALUE file, VALUE size) {
+  int face;
+
+  face = bridge_find_face(StringValueCStr(file), NUM2INT(size));
+  if (face == BRIDGE_NO_FACE) {
+    rb_raise(rb_eRuntimeError, "can't open font %s", StringValueCStr(file));
+  }
+  return INT2NUM(face);
+}
+
+
+static VALUE text_size(VALUE self, VALUE text, VALUE face) {
+  int height;
+  int width;
+
+  bridge_size_text(NUM2INT(face), StringValueCStr(text), &width, &height);
+  return rb_assoc_new(INT2NUM(width), INT2NUM(height));
+}
+
+
+static VALUE text_begin_frame(VALUE self) {
+  t_text *text;
+
+  TypedData_Get_Struct(self, t_text, &text_type, text);
+  if (!bridge_begin_frame(text->window_id)) {
+    rb_raise(rb_eRuntimeError, "no renderer for window %lu",
+             text->window_id);
+  }
+  return self;
+}
+
+
+static VALUE text_paint(int argc, VALUE *argv, VALUE self) {
+  /*
+   * text, face, href, vref, hoff, voff, density
+   */
+  rb_check_arity(argc, 7, 7);
+  bridge_paint_text(StringValueCStr(argv[0]),
+                    NUM2INT(argv[1]),
+                    reference(argv[2], 0),
+                    reference(argv[3], 1),
+                    NUM2INT(argv[4]),
+                    NUM2INT(argv[5]),
+                    NUM2INT(argv[6]));
+  return self;
+}
+
+
+static VALUE text_end_frame(VALUE self) {
+  bridge_end_frame();
+  return self;
+}
+
+
+static int reference(VALUE symbol, int vertical) {
+  ID  id;
+  int result = -1;
+
+  id = SYM2ID(symbol);
+  if (id == id_random) {
+    result = BRIDGE_RANDOM;
+  } else if (vertical) {
+    if (id == id_top) {
+      result = BRIDGE_TOP;
+    } else if (id == id_middle) {
+      result = BRIDGE_MIDDLE;
+    } else if (id == id_bottom) {
+      result = BRIDGE_BOTTOM;
+    }
+  } else {
+    if (id == id_left) {
+      result = BRIDGE_LEFT;
+    } else if (id == id_right) {
+      result = BRIDGE_RIGHT;
+    } else if (id == id_centre) {
+      result = BRIDGE_CENTRE;
+    }
+  }
+  if (result < 0) {
+    rb_raise(rb_eArgError, "unknown reference :%s", rb_id2name(id));
+  }
+  return result;
+}
+
+
+static long seconds(VALUE time) {
+  return NUM2LONG(rb_funcall(time, id_to_i, 0));
+}
@@ -0,0 +1,33 @@
+#
+#  Builds clock_core, the extension which gives clock.rb the C clock's
+#  alarm index and glyph atlases (see clock_core.c).  It's compiled
+#  from the same sources as the clock binary, so from the top level:
+#
+#    make ruby_ext
+#
+#  libspirit.a has to have been built with -fPIC to link into it.
+#
+require 'mkmf'
+
+top = File.expand_path('../..', __dir__)
+
+#
+#  Everything alarms.c and fonts.c need, and nothing which wants a
+#  main loop, a window or a sound device.
+#
+SHARED_SOURCES = %w(
+  alarms batch fonts journal latency metrics pixels qlog quality
+  recurrence settings utils vclock zone
+)
+
+$srcs = %w(clock_core.c bridge.c) + SHARED_SOURCES.map { |name| "#{name}.c" }
+$VPATH << top
+$INCFLAGS << " -I#{top} -I#{top}/../spirit/include"
+$CFLAGS << ' -funsigned-char -D_DEFAULT_SOURCE -DQLOG_LEVEL=3'
+$LDFLAGS << " -L#{top}/../spirit/library"
+
+%w(spirit yaml SDL2 SDL2_ttf pthread m).each do |library|
+  abort "lib#{library} is needed for clock_core" unless have_library(library)
+end
+
+create_makefile('clock_core')
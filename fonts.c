@@ -5,6 +5,60 @@
 #define MAX_FILENAME_LEN 256
 #define NUM_FONTS 3
 
+/*
+ *  Fonts are opened on first use through a cache of faces keyed by
+ *  file and point size.  Each distinct file is mapped into memory just
+ *  once and every size of it is opened from that same mapping.
+ */
+#define MAX_FONT_FILES 8
+#define MAX_FACES      32             /* Half of them blended twins */
+
+/*
+ *  Each face gets a glyph atlas - a single texture holding every
+ *  character we expect to draw with it, rendered when the face is
+ *  opened.  Painting text is then just a matter of copying rectangles
+ *  out of the atlas, which needs no allocation at all.
+ */
+#define FIRST_GLYPH ' '
+#define LAST_GLYPH  '~'
+#define NUM_GLYPHS  (LAST_GLYPH - FIRST_GLYPH + 1)
+#define ATLAS_WIDTH 1024
+
+/*
+ *  Big faces are only ever used for the time, so don't waste texture
+ *  memory on anything else.
+ */
+#define CLOCK_FACE_SIZE 100
+#define CLOCK_CHARSET   " 0123456789:"
+#define ALL_CHARS       NULL
+
+/*
+ *  Rasterising is slow on a small machine, so finished atlases are
+ *  kept on disk, keyed by a hash of the font file, the point size and
+ *  how the glyphs were rendered.  A cache file is the header below,
+ *  the face's t_atlas and then the sheet's pixels, row after row.
+ *  It's only ever read back by the same binary so the structures are
+ *  written as they are.
+ */
+#define CACHE_MAGIC         "ACATLAS1"
+#define CACHE_MAGIC_LEN     8
+#define RENDER_MODE_SOLID   1           /* TTF_RenderText_Solid */
+#define RENDER_MODE_BLENDED 2           /* TTF_RenderText_Blended */
+#define ATLAS_PIXEL_BYTES   4           /* SDL_PIXELFORMAT_ARGB8888 */
+#define GLYPH_PIXEL         0xffffffff  /* White, as rendered */
+#define FNV_OFFSET          2166136261UL
+#define FNV_PRIME           16777619UL
+
+/*
+ *  Every face is rasterised Solid.  Once the governor (see quality.h)
+ *  has let some text be drawn Blended, the face gets a twin rendered
+ *  that way, built up a glyph at a time out of whatever CPU each pass
+ *  of the main loop has to spare, and used whenever the governor allows
+ *  from then on.  While one's wanted we wake up this often to work on
+ *  it.
+ */
+#define IMPROVE_INTERVAL_MS 100
+
 /*
  *================================================================
  *
@@ -14,10 +68,80 @@
  */
 
 typedef struct {
-  char file_name[MAX_FILENAME_LEN + 1];
-  int  size;
+  char        file_name[MAX_FILENAME_LEN + 1];
+  int         size;
+  t_face      face;           /* Once looked up, or NO_FACE */
 } t_font_record;
 
+typedef struct {
+  char          file_name[MAX_FILENAME_LEN + 1];
+  void         *data;         /* Mapped file, or NULL if it failed */
+  size_t        length;
+  unsigned long hash;         /* FNV-1a of the contents, 0 until needed */
+} t_font_file;
+
+typedef struct {
+  bool     present;
+  SDL_Rect source;            /* Where it lives in the atlas */
+  int      offset;            /* Horizontal offset from pen position */
+  int      advance;
+} t_glyph;
+
+typedef struct {
+  int      height;
+  t_glyph  glyphs[NUM_GLYPHS];
+  short    kerning[NUM_GLYPHS][NUM_GLYPHS];   /* [left][right] */
+} t_atlas;
+
+typedef struct {
+  char          magic[CACHE_MAGIC_LEN];
+  unsigned long font_hash;
+  unsigned long font_length;
+  int           size;
+  int           render_mode;
+  int           all_chars;
+  int           atlas_bytes;  /* sizeof(t_atlas) - catches layout changes */
+  int           width;
+  int           rows;
+} t_cache_header;
+
+typedef enum {
+  fs_unopened,
+  fs_loading,                 /* Being opened, perhaps on another thread */
+  fs_loaded,                  /* Rasterised but not yet uploaded everywhere */
+  fs_ready                    /* Uploaded (or failed) for every display */
+} t_face_state;
+
+/*
+ *  Textures belong to a renderer, so with several displays each face's
+ *  sheet is uploaded once for each of them.  The sheet itself is only
+ *  rasterised (or read from the cache) once, and kept until the last
+ *  display has its texture.
+ */
+typedef struct {
+  SDL_Renderer *renderer;
+  SDL_Texture  *texture;      /* NULL if it failed */
+} t_upload;
+
+typedef struct {
+  volatile t_face_state state;
+  int                   file;       /* Index into font_files */
+  int                   size;
+  const char           *charset;    /* Characters to put in the atlas */
+  int                   render_mode;
+  TTF_Font             *font;         /* Not opened at all on a cache hit */
+  bool                  font_failed;
+  SDL_Surface          *sheet;
+  void                 *cache_map;    /* Backing for sheet on a cache hit */
+  size_t                cache_length;
+  t_upload              uploads[MAX_DISPLAYS];
+  int                   num_uploads;
+  t_box                 texture_size;
+  t_atlas               atlas;
+  t_face                twin;         /* Blended for Solid, and back */
+  bool                  wanted;       /* Blended twin asked for */
+} t_face_record;
+
 /*
  *================================================================
  *
@@ -27,12 +151,33 @@ typedef struct {
  */
 
 static t_font_record fonts[NUM_FONTS] = {
-  {"/usr/share/fonts/truetype/freefont/FreeSerifBoldItalic.ttf", 240},
-  {"/usr/share/fonts/truetype/freefont/FreeSerif.ttf",            50},
-  {"/usr/share/fonts/truetype/freefont/FreeSans.ttf",             32}
+  {"/usr/share/fonts/truetype/freefont/FreeSerifBoldItalic.ttf", 240,
+   NO_FACE},
+  {"/usr/share/fonts/truetype/freefont/FreeSerif.ttf",            50,
+   NO_FACE},
+  {"/usr/share/fonts/truetype/freefont/FreeSans.ttf",             32,
+   NO_FACE}
 };
 
-static TTF_Font *font_handles[NUM_FONTS];
+static t_font_file font_files[MAX_FONT_FILES];
+static int         num_font_files = 0;
+
+static t_face_record faces[MAX_FACES];
+static int           num_faces = 0;
+
+/*
+ *  Protects the two tables above, and also serialises opening faces
+ *  since FreeType doesn't like two being opened at once.
+ */
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ *  The blended twin improve_fonts() is working on, and its glyphs so
+ *  far.
+ */
+static t_face       improving = NO_FACE;
+static int          next_glyph;
+static SDL_Surface *improved_glyphs[NUM_GLYPHS];
 
 /*
  *================================================================
@@ -42,10 +187,92 @@ static TTF_Font *font_handles[NUM_FONTS];
  *================================================================
  */
 
-static SDL_Surface *render_font(
-    t_font_size  which_font,
-    const char  *text,
-    SDL_Color    colour);
+static int map_font_file(const char *file_name);
+
+static t_face add_face(
+    int file,
+    int size,
+    int render_mode);
+
+static void open_face(t_face face);
+
+static void upload_face(
+    SDL_Renderer *renderer,
+    t_face        face);
+
+static bool open_font(t_face_record *record);
+
+static TTF_Font *font_for(t_face_record *record);
+
+static unsigned long font_hash(t_font_file *file);
+
+static void cache_file_name(
+    t_face_record *record,
+    char          *buffer,
+    int            size);
+
+static void fill_cache_header(
+    t_face_record  *record,
+    t_cache_header *header,
+    int             width,
+    int             rows);
+
+static bool read_cached_atlas(t_face_record *record);
+
+static void write_cached_atlas(t_face_record *record);
+
+static void rasterise_atlas(t_face_record *record);
+
+static SDL_Surface *render_glyph(
+    t_face_record *record,
+    TTF_Font      *font,
+    int            index);
+
+static void assemble_atlas(
+    t_face_record  *record,
+    SDL_Surface   **rendered);
+
+static bool start_improving(void);
+
+static void copy_glyph(
+    SDL_Surface    *glyph,
+    SDL_Surface    *sheet,
+    const SDL_Rect *placement);
+
+static bool wanted_glyph(
+    t_face_record *record,
+    char           character);
+
+static const t_upload *find_upload(
+    const t_face_record *record,
+    SDL_Renderer        *renderer);
+
+static const t_upload *twin_upload(
+    t_face_record *record,
+    SDL_Renderer  *renderer);
+
+static bool atlas_covers(
+    t_face_record *record,
+    const char    *text);
+
+static t_box atlas_size(
+    t_face_record *record,
+    const char    *text);
+
+static void atlas_paint(
+    t_face_record  *record,
+    const t_upload *upload,
+    const char     *text,
+    int             hpos,
+    int             vpos,
+    int             density);
+
+static void slow_paint(
+    SDL_Renderer  *renderer,
+    t_face_record *record,
+    const char    *text,
+    SDL_Rect      *rectangle,
+    int            density);
 
 /*
  *================================================================
@@ -56,14 +283,86 @@ static SDL_Surface *render_font(
  */
 
 void init_fonts(void) {
-  int i;
+  TTF_Init();
+  QLOG_Info(("Using %s pixel kernels.\n", pixels_kernel_name()));
+}
+
+void load_font(t_font_size which_font) {
+  /*
+   * Get a font open and rasterised ahead of its first use.  This
+   * touches no renderer state so can be done on a worker thread.
+   */
+  t_face face;
+
+  face = named_face(which_font);
+  if (face != NO_FACE) {
+    open_face(face);
+  }
+}
+
+void upload_font(
+    SDL_Renderer *renderer,
+    t_font_size   which_font) {
+  /*
+   * Turn a prefetched font's sheet into a texture.  Must be called on
+   * the render thread.
+   */
+  t_face face;
+
+  face = named_face(which_font);
+  if (face != NO_FACE) {
+    upload_face(renderer, face);
+  }
+}
 
-  for (i = 0; i < NUM_FONTS; i++) {
-    font_handles[i] = TTF_OpenFont(fonts[i].file_name, fonts[i].size);
-    if (font_handles[i] == NULL) {
-      LOG_Error("Failed to open font \"%s\".\n", fonts[i].file_name);
+t_face find_face(
+    const char *file_name,
+    int         size) {
+  /*
+   * Look up the face for this file and size, adding it to the cache
+   * if it's new.  It isn't actually opened until it's first needed.
+   */
+  int    file;
+  int    i;
+  t_face result = NO_FACE;
+
+  pthread_mutex_lock(&cache_lock);
+  file = map_font_file(file_name);
+  if (file >= 0) {
+    for (i = 0; i < num_faces; i++) {
+      if ((faces[i].file == file) &&
+          (faces[i].size == size) &&
+          (faces[i].render_mode == RENDER_MODE_SOLID)) {
+        result = i;
+        break;
+      }
+    }
+    if (result == NO_FACE) {
+      result = add_face(file, size, RENDER_MODE_SOLID);
+      if (result != NO_FACE) {
+        faces[result].twin = add_face(file, size, RENDER_MODE_BLENDED);
+        if (faces[result].twin != NO_FACE) {
+          faces[faces[result].twin].twin = result;
+        }
+      }
     }
   }
+  pthread_mutex_unlock(&cache_lock);
+  return result;
+}
+
+t_face named_face(t_font_size which_font) {
+  t_font_record *record;
+
+  record = fonts + which_font;
+  if (record->face == NO_FACE) {
+    record->face = find_face(record->file_name, record->size);
+  }
+  return record->face;
+}
+
+const char *font_file_name(t_font_size which_font) {
+  return fonts[which_font].file_name;
 }
 
 void set_font_file_name(
@@ -80,6 +379,7 @@ void set_font_file_name(
               (const char *) file_name,
               MAX_FILENAME_LEN,
               "Font file name");
+    target->face = NO_FACE;
   }
 }
 
@@ -94,6 +394,7 @@ void set_font_size(
       (which_font == f_small)) {
     target = fonts + which_font;
     target->size = integer((const char *) size_str);
+    target->face = NO_FACE;
   }
 }
 
@@ -101,13 +402,31 @@ t_box size_text(
     t_font_size  which_font,
     const char  *text) {
 
-  t_box result = {0, 0};
+  return size_face_text(named_face(which_font), text);
+}
+
+t_box size_face_text(
+    t_face       face,
+    const char  *text) {
 
-  TTF_SizeText(
-    font_handles[which_font],
-    text,
-    &result.width,
-    &result.height);
+  t_face_record *record;
+  t_box          result = {0, 0};
+
+  if (face != NO_FACE) {
+    record = faces + face;
+    if (record->state == fs_unopened) {
+      open_face(face);
+    }
+    if (atlas_covers(record, text)) {
+      result = atlas_size(record, text);
+    } else if ((record->state != fs_loading) && (font_for(record) != NULL)) {
+      TTF_SizeText(
+        record->font,
+        text,
+        &result.width,
+        &result.height);
+    }
+  }
   return result;
 }
 
@@ -122,67 +441,193 @@ void paint_text(
     int             voff,
     int             density) {
 
-  t_box        box;
-  SDL_Color    colour;
-  int          hpos;
-  int          vpos;
-  SDL_Rect     rectangle;
-  SDL_Surface *surface;
-  SDL_Texture *texture;
-
-  box = size_text(f_large, text);
-  switch (href) {
-    case h_left:
-      hpos = hoff;
-      break;
+  paint_face_text(renderer,
+                  text,
+                  named_face(font),
+                  href,
+                  vref,
+                  hoff,
+                  voff,
+                  density);
+}
 
-    case h_right:
-      hpos = (1024 - box.width) - hoff;
-      break;
 
-    case h_centre:
-      hpos = (1024 - box.width) / 2 + hoff;
-      break;
+void paint_face_text(
+    SDL_Renderer   *renderer,
+    const char     *text,
+    t_face          face,
+    t_href          href,
+    t_vref          vref,
+    int             hoff,
+    int             voff,
+    int             density) {
+
+  t_box           box;
+  int             hpos;
+  int             vpos;
+  t_face_record  *record = NULL;
+  SDL_Rect        rectangle;
+  int             screen_height;
+  int             screen_width;
+  const t_upload *smooth = NULL;
+  struct timespec started;
+  const t_upload *upload = NULL;
+
+  if (face != NO_FACE) {
+    record = faces + face;
+    /*
+     * Opened on first use.  A face which is still being loaded in the
+     * background is skipped for now.
+     */
+    if (record->state == fs_unopened) {
+      clock_gettime(CLOCK_MONOTONIC, &started);
+      open_face(face);
+      latency_charge(lp_rasterise, &started);
+    }
+    if (record->state == fs_loaded) {
+      clock_gettime(CLOCK_MONOTONIC, &started);
+      upload_face(renderer, face);
+      latency_charge(lp_upload, &started);
+    }
+    upload = find_upload(record, renderer);
   }
-  switch (vref) {
-    case v_top:
-      vpos = voff;
-      break;
+  if (upload != NULL) {
+    SDL_GetRendererOutputSize(renderer, &screen_width, &screen_height);
+    box = size_face_text(face, text);
+    switch (href) {
+      case h_left:
+        hpos = hoff;
+        break;
 
-    case v_bottom:
-      vpos = (600 - box.height) - voff;
-      break;
+      case h_right:
+        hpos = (screen_width - box.width) - hoff;
+        break;
 
-    case v_middle:
-      vpos = (600 - box.height) / 2 + voff;
-      break;
+      case h_centre:
+        hpos = (screen_width - box.width) / 2 + hoff;
+        break;
+
+      case h_random:
+        hpos = random_offset(screen_width - box.width) + hoff;
+        break;
+    }
+    switch (vref) {
+      case v_top:
+        vpos = voff;
+        break;
+
+      case v_bottom:
+        vpos = (screen_height - box.height) - voff;
+        break;
 
+      case v_middle:
+        vpos = (screen_height - box.height) / 2 + voff;
+        break;
+
+      case v_random:
+        vpos = random_offset(screen_height - box.height) + voff;
+        break;
+
+    }
+    if ((upload->texture != NULL) && atlas_covers(record, text)) {
+      if (quality_choose() == rq_blended) {
+        smooth = twin_upload(record, renderer);
+      }
+      if (smooth != NULL) {
+        atlas_paint(faces + record->twin, smooth, text, hpos, vpos, density);
+        quality_used(rq_blended);
+      } else {
+        atlas_paint(record, upload, text, hpos, vpos, density);
+        quality_used(rq_solid);
+      }
+    } else {
+      rectangle.x  = hpos;
+      rectangle.y  = vpos;
+      rectangle.w  = box.width;
+      rectangle.h  = box.height;
+      clock_gettime(CLOCK_MONOTONIC, &started);
+      slow_paint(renderer, record, text, &rectangle, density);
+      latency_charge(lp_rasterise, &started);
+    }
   }
-  colour.r = density;
-  colour.g = density;
-  colour.b = density;
-  colour.a = 255;
-  surface = render_font(font, text, colour);
-  texture = SDL_CreateTextureFromSurface(
-      renderer,
-      surface);
-  rectangle.x  = hpos;
-  rectangle.y  = vpos;
-  rectangle.w  = box.width;
-  rectangle.h  = box.height;
-  SDL_RenderCopy(renderer, texture, NULL, &rectangle);
-  SDL_DestroyTexture(texture);
-  SDL_FreeSurface(surface);
+}
+
+
+bool improve_fonts(void) {
+  /*
+   * Put whatever CPU this pass has to spare into the blended twins
+   * which have been asked for.  Returns TRUE once one's been uploaded,
+   * so that the screens can be repainted with it.  Must be called on
+   * the render thread.
+   *
+   * Rendering and uploading a twin allocates, but happens once per
+   * face, so it's left out of the allocation guard.  Finding there's
+   * nothing to do - the steady state - mustn't allocate.
+   */
+  int            i;
+  bool           result = FALSE;
+  t_face_record *solid;
+  t_face_record *twin;
+
+  while (!result &&
+         quality_spare() &&
+         ((improving != NO_FACE) || start_improving())) {
+    twin = faces + improving;
+    solid = faces + twin->twin;
+    ALLOC_GUARD_PAUSE();
+    if (twin->state != fs_loading) {
+      for (i = 0; i < solid->num_uploads; i++) {
+        upload_face(solid->uploads[i].renderer, improving);
+      }
+      improving = NO_FACE;
+      result = TRUE;
+    } else if (next_glyph < NUM_GLYPHS) {
+      improved_glyphs[next_glyph] =
+        render_glyph(twin, solid->font, next_glyph);
+      next_glyph++;
+    } else {
+      assemble_atlas(twin, improved_glyphs);
+      write_cached_atlas(twin);
+      twin->state = fs_loaded;
+    }
+    ALLOC_GUARD_RESUME();
+  }
+  return result;
+}
+
+int improve_wait_time(void) {
+  /*
+   * Milliseconds until improve_fonts() wants to be called again, or -1
+   * if there's nothing for it to do.
+   */
+  int i;
+  int result = -1;
+
+  if (improving != NO_FACE) {
+    result = IMPROVE_INTERVAL_MS;
+  }
+  for (i = 0; (result < 0) && (i < num_faces); i++) {
+    if (faces[i].wanted) {
+      result = IMPROVE_INTERVAL_MS;
+    }
+  }
+  return result;
 }
 
 
 void dump_fonts(void) {
-  LOG_Debug("Large font\n");
-  LOG_Debug("  %3d %s\n", fonts[f_large].size, fonts[f_large].file_name);
-  LOG_Debug("Medium font\n");
-  LOG_Debug("  %3d %s\n", fonts[f_medium].size, fonts[f_medium].file_name);
-  LOG_Debug("Small font\n");
-  LOG_Debug("  %3d %s\n", fonts[f_small].size, fonts[f_small].file_name);
+  QLOG_Debug(("Large font\n"));
+  QLOG_Debug(("  %3d %s\n",
+              fonts[f_large].size,
+              fonts[f_large].file_name));
+  QLOG_Debug(("Medium font\n"));
+  QLOG_Debug(("  %3d %s\n",
+              fonts[f_medium].size,
+              fonts[f_medium].file_name));
+  QLOG_Debug(("Small font\n"));
+  QLOG_Debug(("  %3d %s\n",
+              fonts[f_small].size,
+              fonts[f_small].file_name));
 
 }
 
@@ -194,13 +639,736 @@ void dump_fonts(void) {
  *================================================================
  */
 
-static SDL_Surface *render_font(
-    t_font_size  which_font,
-    const char  *text,
-    SDL_Color    colour) {
+static int map_font_file(const char *file_name) {
+  /*
+   * Find or create the mapping for a font file.  Called with the
+   * cache lock held.  Returns -1 only if the table is full - a file
+   * which can't be mapped gets an entry with no data so that we
+   * don't keep trying.
+   */
+  int          fd;
+  int          i;
+  t_font_file *record;
+  int          result = -1;
+  struct stat  status;
 
-  return TTF_RenderText_Solid(font_handles[which_font],
-                              text,
-                              colour);
+  for (i = 0; i < num_font_files; i++) {
+    if (strcmp(font_files[i].file_name, file_name) == 0) {
+      result = i;
+      break;
+    }
+  }
+  if ((result == -1) && (num_font_files < MAX_FONT_FILES)) {
+    result = num_font_files++;
+    record = font_files + result;
+    safe_copy(record->file_name, file_name, MAX_FILENAME_LEN, "Font file");
+    record->data = NULL;
+    record->length = 0;
+    fd = open(file_name, O_RDONLY);
+    if (fd < 0) {
+      LOG_Error("Failed to open font \"%s\".\n", file_name);
+    } else {
+      if ((fstat(fd, &status) == 0) && (status.st_size > 0)) {
+        record->data = mmap(NULL,
+                            status.st_size,
+                            PROT_READ,
+                            MAP_SHARED,
+                            fd,
+                            0);
+        if (record->data == MAP_FAILED) {
+          LOG_Error("Failed to map font \"%s\".\n", file_name);
+          record->data = NULL;
+        } else {
+          record->length = status.st_size;
+        }
+      }
+      close(fd);
+    }
+  } else if (result == -1) {
+    LOG_Error("Too many font files - limit is %d.\n", MAX_FONT_FILES);
+  }
+  return result;
 }
 
+
+static t_face add_face(
+    int file,
+    int size,
+    int render_mode) {
+  /*
+   * A new entry in the cache, not opened yet.  Called with the cache
+   * lock held.
+   */
+  t_face result = NO_FACE;
+
+  if (num_faces < MAX_FACES) {
+    result = num_faces++;
+    faces[result].state = fs_unopened;
+    faces[result].file = file;
+    faces[result].size = size;
+    faces[result].render_mode = render_mode;
+    if (size > CLOCK_FACE_SIZE) {
+      faces[result].charset = CLOCK_CHARSET;
+    } else {
+      faces[result].charset = ALL_CHARS;
+    }
+    faces[result].twin = NO_FACE;
+  } else {
+    LOG_Error("Too many font faces - limit is %d.\n", MAX_FACES);
+  }
+  return result;
+}
+
+
+static void open_face(t_face face) {
+  /*
+   * Get the face's glyph sheet ready for upload - from the on-disk
+   * cache if we can, otherwise by opening the font and rasterising
+   * it.  Does nothing if someone else has already done (or is doing)
+   * it.
+   */
+  t_face_record *record;
+
+  record = faces + face;
+  pthread_mutex_lock(&cache_lock);
+  if (record->state == fs_unopened) {
+    record->state = fs_loading;
+    if (!read_cached_atlas(record) && open_font(record)) {
+      rasterise_atlas(record);
+      write_cached_atlas(record);
+    }
+    record->state = fs_loaded;
+  }
+  pthread_mutex_unlock(&cache_lock);
+}
+
+
+static void upload_face(
+    SDL_Renderer *renderer,
+    t_face        face) {
+  /*
+   * Turn the sheet into a texture for this renderer.  Must be called
+   * on the render thread.  Once every display has one the sheet isn't
+   * needed any more.
+   */
+  t_face_record *record;
+  t_upload      *upload;
+
+  record = faces + face;
+  if ((record->state == fs_loaded) && (find_upload(record, renderer) == NULL)) {
+    upload = record->uploads + record->num_uploads++;
+    upload->renderer = renderer;
+    upload->texture = NULL;
+    if (record->sheet != NULL) {
+      upload->texture = SDL_CreateTextureFromSurface(renderer, record->sheet);
+      if (upload->texture == NULL) {
+        LOG_Error("Failed to upload glyph atlas for \"%s\".\n",
+                  font_files[record->file].file_name);
+      } else {
+        SDL_SetTextureBlendMode(upload->texture, SDL_BLENDMODE_BLEND);
+        record->texture_size.width = record->sheet->w;
+        record->texture_size.height = record->sheet->h;
+      }
+    }
+    if (record->num_uploads >= get_display_count()) {
+      if (record->sheet != NULL) {
+        SDL_FreeSurface(record->sheet);
+        record->sheet = NULL;
+      }
+      if (record->cache_map != NULL) {
+        munmap(record->cache_map, record->cache_length);
+        record->cache_map = NULL;
+      }
+      record->state = fs_ready;
+    }
+  }
+}
+
+
+static bool open_font(t_face_record *record) {
+  /*
+   * Open the face from its file's shared mapping, if it isn't open
+   * already.  Called with the cache lock held.
+   */
+  t_font_file *file;
+
+  if ((record->font == NULL) && !record->font_failed) {
+    file = font_files + record->file;
+    if (file->data != NULL) {
+      record->font =
+        TTF_OpenFontRW(SDL_RWFromConstMem(file->data, file->length),
+                       1,
+                       record->size);
+    }
+    if (record->font == NULL) {
+      LOG_Error("Failed to open font \"%s\" at size %d.\n",
+                file->file_name,
+                record->size);
+      record->font_failed = TRUE;
+    }
+  }
+  return record->font != NULL;
+}
+
+
+static TTF_Font *font_for(t_face_record *record) {
+  /*
+   * A face loaded from the cache has no font open.  The few things
+   * which still need one get it opened here.
+   */
+  pthread_mutex_lock(&cache_lock);
+  open_font(record);
+  pthread_mutex_unlock(&cache_lock);
+  return record->font;
+}
+
+
+static unsigned long font_hash(t_font_file *file) {
+  /*
+   * 32-bit FNV-1a over the whole file, worked out the first time it's
+   * wanted.
+   */
+  const unsigned char *ptr;
+  const unsigned char *end;
+  unsigned long        hash;
+
+  if ((file->hash == 0) && (file->data != NULL)) {
+    hash = FNV_OFFSET;
+    end = (const unsigned char *) file->data + file->length;
+    for (ptr = file->data; ptr < end; ptr++) {
+      hash = ((hash ^ *ptr) * FNV_PRIME) & 0xffffffffUL;
+    }
+    file->hash = hash;
+  }
+  return file->hash;
+}
+
+
+static void cache_file_name(
+    t_face_record *record,
+    char          *buffer,
+    int            size) {
+
+  snprintf(buffer,
+           size,
+           "%s/alarmclock-%08lx-%d-%d.atlas",
+           get_font_cache(),
+           font_hash(font_files + record->file),
+           record->size,
+           record->render_mode);
+}
+
+
+static void fill_cache_header(
+    t_face_record  *record,
+    t_cache_header *header,
+    int             width,
+    int             rows) {
+
+  memset(header, 0, sizeof(t_cache_header));
+  memcpy(header->magic, CACHE_MAGIC, CACHE_MAGIC_LEN);
+  header->font_hash   = font_hash(font_files + record->file);
+  header->font_length = font_files[record->file].length;
+  header->size        = record->size;
+  header->render_mode = record->render_mode;
+  header->all_chars   = (record->charset == ALL_CHARS);
+  header->atlas_bytes = sizeof(t_atlas);
+  header->width       = width;
+  header->rows        = rows;
+}
+
+
+static bool read_cached_atlas(t_face_record *record) {
+  /*
+   * Map a cached atlas and point a surface straight at its pixels.
+   * The mapping stays until upload_face() has made the textures.  Any
+   * mismatch at all and the cache is ignored, to be rewritten after
+   * rasterising.
+   */
+  char                  cache_name[MAX_FILENAME_LEN + 1];
+  int                   fd;
+  const t_cache_header *found;
+  t_cache_header        header;
+  void                 *map = MAP_FAILED;
+  size_t                pixels;
+  bool                  result = FALSE;
+  struct stat           status;
+
+  if (font_files[record->file].data != NULL) {
+    cache_file_name(record, cache_name, sizeof(cache_name));
+    fd = open(cache_name, O_RDONLY);
+    if (fd >= 0) {
+      if ((fstat(fd, &status) == 0) &&
+          ((size_t) status.st_size >= sizeof(t_cache_header) + sizeof(t_atlas))) {
+        map = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      }
+      close(fd);
+    }
+    if (map != MAP_FAILED) {
+      found = map;
+      fill_cache_header(record, &header, found->width, found->rows);
+      pixels = (size_t) found->width * found->rows * ATLAS_PIXEL_BYTES;
+      if ((memcmp(found, &header, sizeof(t_cache_header)) == 0) &&
+          ((size_t) status.st_size ==
+           sizeof(t_cache_header) + sizeof(t_atlas) + pixels)) {
+        memcpy(&record->atlas, found + 1, sizeof(t_atlas));
+        record->sheet =
+          SDL_CreateRGBSurfaceWithFormatFrom(
+            (char *) map + sizeof(t_cache_header) + sizeof(t_atlas),
+            found->width,
+            found->rows,
+            32,
+            found->width * ATLAS_PIXEL_BYTES,
+            SDL_PIXELFORMAT_ARGB8888);
+      }
+      if (record->sheet == NULL) {
+        QLOG_Info(("Glyph atlas cache \"%s\" is stale.\n", cache_name));
+        munmap(map, status.st_size);
+      } else {
+        record->cache_map = map;
+        record->cache_length = status.st_size;
+        result = TRUE;
+      }
+    }
+  }
+  return result;
+}
+
+
+static void write_cached_atlas(t_face_record *record) {
+  /*
+   * Written to a temporary file and renamed into place so that a
+   * reader never sees half a cache.  Failure just means rasterising
+   * again next time.
+   */
+  char           cache_name[MAX_FILENAME_LEN + 1];
+  FILE          *file;
+  t_cache_header header;
+  bool           ok;
+  int            row;
+  SDL_Surface   *sheet;
+  char           temp_name[MAX_FILENAME_LEN + 1];
+
+  sheet = record->sheet;
+  if (sheet != NULL) {
+    cache_file_name(record, cache_name, sizeof(cache_name));
+    snprintf(temp_name, sizeof(temp_name), "%s.%d", cache_name, getpid());
+    fill_cache_header(record, &header, sheet->w, sheet->h);
+    file = fopen(temp_name, "wb");
+    if (file == NULL) {
+      QLOG_Warning(("Can't write glyph atlas cache \"%s\".\n", temp_name));
+    } else {
+      ok = (fwrite(&header, sizeof(header), 1, file) == 1) &&
+           (fwrite(&record->atlas, sizeof(t_atlas), 1, file) == 1);
+      for (row = 0; ok && (row < sheet->h); row++) {
+        ok = (fwrite((char *) sheet->pixels + row * sheet->pitch,
+                     sheet->w * ATLAS_PIXEL_BYTES,
+                     1,
+                     file) == 1);
+      }
+      if ((fclose(file) != 0) || !ok || (rename(temp_name, cache_name) != 0)) {
+        QLOG_Warning(("Failed to save glyph atlas cache \"%s\".\n",
+                      cache_name));
+        unlink(temp_name);
+      }
+    }
+  }
+}
+
+
+static void rasterise_atlas(t_face_record *record) {
+  /*
+   * Everything in one go, for a face opened in the ordinary way.
+   */
+  int          i;
+  int          j;
+  SDL_Surface *rendered[NUM_GLYPHS];
+
+  record->atlas.height = TTF_FontHeight(record->font);
+  for (i = 0; i < NUM_GLYPHS; i++) {
+    rendered[i] = render_glyph(record, record->font, i);
+  }
+  /*
+   * Kerning between every pair we can draw, so that neither sizing
+   * nor painting needs the font open.
+   */
+  for (i = 0; i < NUM_GLYPHS; i++) {
+    for (j = 0; j < NUM_GLYPHS; j++) {
+      if (record->atlas.glyphs[i].present &&
+          record->atlas.glyphs[j].present) {
+        record->atlas.kerning[i][j] =
+          TTF_GetFontKerningSizeGlyphs(record->font,
+                                       FIRST_GLYPH + i,
+                                       FIRST_GLYPH + j);
+      } else {
+        record->atlas.kerning[i][j] = 0;
+      }
+    }
+  }
+  assemble_atlas(record, rendered);
+}
+
+
+static SDL_Surface *render_glyph(
+    t_face_record *record,
+    TTF_Font      *font,
+    int            index) {
+  /*
+   * Render one glyph on its own and note its metrics.  Glyphs are
+   * rendered in white so that density can be applied later as a
+   * colour modulation.  NULL if it isn't wanted or won't render.
+   */
+  int          advance;
+  t_glyph     *glyph;
+  int          maxx;
+  int          maxy;
+  int          minx;
+  int          miny;
+  SDL_Surface *result = NULL;
+  char         text[2];
+  SDL_Color    white = {255, 255, 255, 255};
+
+  glyph = record->atlas.glyphs + index;
+  glyph->present = FALSE;
+  glyph->source.x = 0;
+  glyph->source.y = 0;
+  glyph->source.w = 0;
+  glyph->source.h = 0;
+  if (wanted_glyph(record, FIRST_GLYPH + index) &&
+      (TTF_GlyphMetrics(font,
+                        FIRST_GLYPH + index,
+                        &minx, &maxx, &miny, &maxy,
+                        &advance) == 0)) {
+    text[0] = FIRST_GLYPH + index;
+    text[1] = '\0';
+    if (record->render_mode == RENDER_MODE_BLENDED) {
+      result = TTF_RenderText_Blended(font, text, white);
+    } else {
+      result = TTF_RenderText_Solid(font, text, white);
+    }
+    /*
+     * A glyph which hangs to the left of its origin gets rendered
+     * shifted right by that amount.
+     */
+    glyph->offset  = (minx < 0) ? minx : 0;
+    glyph->advance = advance;
+    glyph->present = TRUE;
+  }
+  return result;
+}
+
+
+static void assemble_atlas(
+    t_face_record  *record,
+    SDL_Surface   **rendered) {
+  /*
+   * Work out where each rendered glyph goes in the sheet, put them all
+   * there ready for upload_face(), and free them.
+   */
+  t_glyph *glyph;
+  int      i;
+  int      row_height = 0;
+  int      x = 0;
+  int      y = 0;
+
+  for (i = 0; i < NUM_GLYPHS; i++) {
+    if (rendered[i] != NULL) {
+      glyph = record->atlas.glyphs + i;
+      if ((x + rendered[i]->w) > ATLAS_WIDTH) {
+        x = 0;
+        y += row_height;
+        row_height = 0;
+      }
+      glyph->source.x = x;
+      glyph->source.y = y;
+      glyph->source.w = rendered[i]->w;
+      glyph->source.h = rendered[i]->h;
+      x += rendered[i]->w;
+      if (rendered[i]->h > row_height) {
+        row_height = rendered[i]->h;
+      }
+    }
+  }
+  record->sheet = SDL_CreateRGBSurfaceWithFormat(0,
+                                                 ATLAS_WIDTH,
+                                                 y + row_height,
+                                                 32,
+                                                 SDL_PIXELFORMAT_ARGB8888);
+  if (record->sheet == NULL) {
+    LOG_Error("Failed to create glyph atlas for \"%s\".\n",
+              font_files[record->file].file_name);
+  } else {
+    for (i = 0; i < NUM_GLYPHS; i++) {
+      if (rendered[i] != NULL) {
+        copy_glyph(rendered[i],
+                   record->sheet,
+                   &record->atlas.glyphs[i].source);
+      }
+    }
+  }
+  for (i = 0; i < NUM_GLYPHS; i++) {
+    if (rendered[i] != NULL) {
+      SDL_FreeSurface(rendered[i]);
+      rendered[i] = NULL;
+    }
+  }
+}
+
+
+static void copy_glyph(
+    SDL_Surface    *glyph,
+    SDL_Surface    *sheet,
+    const SDL_Rect *placement) {
+  /*
+   * Solid rendering gives an 8-bit surface with the glyph at index 1
+   * on a colour-keyed background at 0, which pixels_expand() turns
+   * into just what SDL_BlitSurface() would have, only faster.  Any
+   * other format - Blended glyphs, with their own alpha - is copied
+   * across by SDL as it is rather than blended onto the sheet.
+   */
+  SDL_Rect where;
+  int      y;
+
+  if (glyph->format->BytesPerPixel == 1) {
+    for (y = 0; y < glyph->h; y++) {
+      pixels_expand((Uint32 *) ((Uint8 *) sheet->pixels +
+                                (placement->y + y) * sheet->pitch) +
+                      placement->x,
+                    (const Uint8 *) glyph->pixels + y * glyph->pitch,
+                    glyph->w,
+                    GLYPH_PIXEL);
+    }
+  } else {
+    where = *placement;
+    SDL_SetSurfaceBlendMode(glyph, SDL_BLENDMODE_NONE);
+    SDL_BlitSurface(glyph, NULL, sheet, &where);
+  }
+}
+
+
+static bool start_improving(void) {
+  /*
+   * Pick the next face whose twin has been asked for and get it going,
+   * straight from the on-disk cache if it's there.  A twin has the same
+   * metrics and kerning as its face so only the glyphs themselves need
+   * rendering.  FALSE if there's nothing to do.
+   */
+  t_face         face;
+  t_face_record *solid;
+  t_face_record *twin;
+
+  pthread_mutex_lock(&cache_lock);
+  for (face = 0; (improving == NO_FACE) && (face < num_faces); face++) {
+    solid = faces + face;
+    if (solid->wanted) {
+      solid->wanted = FALSE;
+      twin = faces + solid->twin;
+      ALLOC_GUARD_PAUSE();
+      if (twin->state == fs_unopened) {
+        twin->state = fs_loading;
+        if (read_cached_atlas(twin)) {
+          twin->state = fs_loaded;
+        } else if (open_font(solid)) {
+          twin->atlas = solid->atlas;
+          next_glyph = 0;
+        } else {
+          twin->state = fs_ready;             /* With no uploads */
+        }
+      }
+      ALLOC_GUARD_RESUME();
+      if ((twin->state == fs_loading) || (twin->state == fs_loaded)) {
+        improving = solid->twin;
+      }
+    }
+  }
+  pthread_mutex_unlock(&cache_lock);
+  return improving != NO_FACE;
+}
+
+
+static bool wanted_glyph(
+    t_face_record *record,
+    char           character) {
+
+  return (record->charset == ALL_CHARS) ||
+         (strchr(record->charset, character) != NULL);
+}
+
+
+static const t_upload *find_upload(
+    const t_face_record *record,
+    SDL_Renderer        *renderer) {
+  /*
+   * The face's texture for this renderer, or NULL if it hasn't been
+   * uploaded there yet.
+   */
+  int             i;
+  const t_upload *result = NULL;
+
+  for (i = 0; i < record->num_uploads; i++) {
+    if (record->uploads[i].renderer == renderer) {
+      result = record->uploads + i;
+      break;
+    }
+  }
+  return result;
+}
+
+
+static const t_upload *twin_upload(
+    t_face_record *record,
+    SDL_Renderer  *renderer) {
+  /*
+   * The blended twin's texture for this renderer, or NULL if it hasn't
+   * got one - in which case it's asked for, unless it's on its way or
+   * can't be had.
+   */
+  const t_upload *result = NULL;
+  t_face_record  *twin;
+  const t_upload *upload;
+
+  if (record->twin != NO_FACE) {
+    twin = faces + record->twin;
+    upload = find_upload(twin, renderer);
+    if (upload == NULL) {
+      if ((twin->state == fs_unopened) || (twin->state == fs_loaded)) {
+        record->wanted = TRUE;
+      }
+    } else if (upload->texture != NULL) {
+      result = upload;
+    }
+  }
+  return result;
+}
+
+
+static bool atlas_covers(
+    t_face_record *record,
+    const char    *text) {
+  /*
+   * Does the atlas have every glyph this text needs?  It's complete
+   * once the face is loaded, whether or not it's been uploaded yet.
+   */
+  const char *ptr;
+  bool        result = TRUE;
+
+  if ((record->state != fs_loaded) && (record->state != fs_ready)) {
+    result = FALSE;
+  } else {
+    for (ptr = text; *ptr != '\0'; ptr++) {
+      if ((*ptr < FIRST_GLYPH) ||
+          (*ptr > LAST_GLYPH) ||
+          !record->atlas.glyphs[*ptr - FIRST_GLYPH].present) {
+        result = FALSE;
+        break;
+      }
+    }
+  }
+  return result;
+}
+
+
+static t_box atlas_size(
+    t_face_record *record,
+    const char    *text) {
+
+  int         extent = 0;
+  t_glyph    *glyph;
+  int         pen = 0;
+  const char *ptr;
+  t_box       result;
+  int         right;
+
+  for (ptr = text; *ptr != '\0'; ptr++) {
+    if (ptr != text) {
+      pen += record->atlas.kerning[ptr[-1] - FIRST_GLYPH]
+                                  [ptr[0] - FIRST_GLYPH];
+    }
+    glyph = record->atlas.glyphs + (*ptr - FIRST_GLYPH);
+    right = pen + glyph->offset + glyph->source.w;
+    if (right > extent) {
+      extent = right;
+    }
+    pen += glyph->advance;
+  }
+  result.width  = (pen > extent) ? pen : extent;
+  result.height = record->atlas.height;
+  return result;
+}
+
+
+static void atlas_paint(
+    t_face_record  *record,
+    const t_upload *upload,
+    const char     *text,
+    int             hpos,
+    int             vpos,
+    int             density) {
+
+  t_glyph    *glyph;
+  int         pen;
+  const char *ptr;
+  SDL_Rect    rectangle;
+
+  pen = hpos;
+  for (ptr = text; *ptr != '\0'; ptr++) {
+    if (ptr != text) {
+      pen += record->atlas.kerning[ptr[-1] - FIRST_GLYPH]
+                                  [ptr[0] - FIRST_GLYPH];
+    }
+    glyph = record->atlas.glyphs + (*ptr - FIRST_GLYPH);
+    if (glyph->source.w > 0) {
+      rectangle.x = pen + glyph->offset;
+      rectangle.y = vpos;
+      rectangle.w = glyph->source.w;
+      rectangle.h = glyph->source.h;
+      batch_copy(upload->texture,
+                 record->texture_size,
+                 &glyph->source,
+                 &rectangle,
+                 density);
+    }
+    pen += glyph->advance;
+  }
+}
+
+
+static void slow_paint(
+    SDL_Renderer  *renderer,
+    t_face_record *record,
+    const char    *text,
+    SDL_Rect      *rectangle,
+    int            density) {
+  /*
+   * For anything not in the atlas.  This allocates a surface and a
+   * texture every time so shouldn't be used for anything drawn in
+   * the steady state.
+   */
+  SDL_Color         colour;
+  t_render_quality  quality;
+  SDL_Surface      *surface;
+  SDL_Texture      *texture;
+
+  colour.r = density;
+  colour.g = density;
+  colour.b = density;
+  colour.a = 255;
+  if (font_for(record) != NULL) {
+    batch_flush();
+    quality = quality_choose();
+    if (quality == rq_blended) {
+      surface = TTF_RenderText_Blended(record->font, text, colour);
+    } else {
+      surface = TTF_RenderText_Solid(record->font, text, colour);
+    }
+    quality_used(quality);
+    if (surface != NULL) {
+      texture = SDL_CreateTextureFromSurface(
+          renderer,
+          surface);
+      SDL_RenderCopy(renderer, texture, NULL, rectangle);
+      SDL_DestroyTexture(texture);
+      SDL_FreeSurface(surface);
+    }
+  }
+}
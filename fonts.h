@@ -18,15 +18,24 @@ typedef enum {
 typedef enum {
   h_left,
   h_right,
-  h_centre
+  h_centre,
+  h_random
 } t_href;
 
 typedef enum {
   v_top,
   v_middle,
-  v_bottom
+  v_bottom,
+  v_random
 } t_vref;
-  
+
+/*
+ *  An entry in the cache of opened faces.  See find_face().
+ */
+typedef int t_face;
+
+#define NO_FACE -1
+
 /*
  *================================================================
  *
@@ -37,6 +46,8 @@ typedef enum {
 
 extern void init_fonts(void);
 
+extern void load_font(t_font_size which_font);
+
 extern void set_font_file_name(
   t_font_size        which_font,
   const yaml_char_t *file_name);
@@ -51,7 +62,27 @@ extern t_box size_text(
     t_font_size  which_font,
     const char  *text);
 
+extern t_face find_face(
+    const char *file_name,
+    int         size);
+
+extern t_face named_face(t_font_size which_font);
+
+extern const char *font_file_name(t_font_size which_font);
+
+extern t_box size_face_text(
+    t_face       face,
+    const char  *text);
+
+extern bool improve_fonts(void);
+
+extern int improve_wait_time(void);
+
 #if defined NEED_SDL
+extern void upload_font(
+    SDL_Renderer *renderer,
+    t_font_size   which_font);
+
 extern void paint_text(
     SDL_Renderer *renderer,
     const char  *text,
@@ -62,4 +93,14 @@ extern void paint_text(
     int          voff,
     int          density);
 
+extern void paint_face_text(
+    SDL_Renderer *renderer,
+    const char  *text,
+    t_face       face,
+    t_href       href,
+    t_vref       vref,
+    int          hoff,
+    int          voff,
+    int          density);
+
 #endif
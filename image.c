@@ -1,42 +1,101 @@
+
 #define NEED_SDL
 #include "includes.h"
 
-static SDL_Surface *optimized_menu_icon;
+/*
+ *  The icon is normally built in (see assets.h) and goes straight from
+ *  the binary into a texture.  If a menu_icon_file is set instead the
+ *  PNG is decoded by decode_images(), which can run on a worker thread.
+ *  Either way the texture is made just once for each display, on the
+ *  render thread, so that painting it costs nothing more than a copy.
+ *  A decoded PNG is kept until every display has its texture.
+ */
+typedef struct {
+  SDL_Renderer *renderer;
+  SDL_Texture  *texture;
+} t_menu_icon;
+
+static SDL_Surface *raw_menu_icon;
+static t_menu_icon  menu_icons[MAX_DISPLAYS];
+static int          num_menu_icons = 0;
+static t_box        menu_icon_size;
 
-void init_images(SDL_Window *window) {
+void decode_images(void) {
   int          flags = IMG_INIT_PNG;
-  SDL_Surface *raw_menu_icon;
   int          result;
-  SDL_Surface *window_surface;
 
-  result = IMG_Init(flags);
-  if ((result & flags) == 0) {
-    LOG_Error("Failed to initialize image handling.\n");
-  } else {
-    raw_menu_icon = IMG_Load("menu.png");
-    if (raw_menu_icon == NULL) {
-      LOG_Error("Failed to load menu icon.\n");
+  if (*get_menu_icon_file() != '\0') {
+    result = IMG_Init(flags);
+    if ((result & flags) == 0) {
+      LOG_Error("Failed to initialize image handling.\n");
     } else {
-      optimized_menu_icon = raw_menu_icon;
-    /*
-      window_surface = SDL_GetWindowSurface(window);
-      optimized_menu_icon =
-        SDL_ConvertSurface(raw_menu_icon, window_surface->format, 0);
-      SDL_FreeSurface(raw_menu_icon);
-    */
+      raw_menu_icon = IMG_Load(get_menu_icon_file());
+      if (raw_menu_icon == NULL) {
+        LOG_Error("Failed to load menu icon \"%s\".\n",
+                  get_menu_icon_file());
+      }
     }
   }
 }
 
-void paint_menu(SDL_Renderer *renderer) {
+void upload_images(SDL_Renderer *renderer) {
   SDL_Texture *menu_icon;
+
+  if (raw_menu_icon != NULL) {
+    menu_icon = SDL_CreateTextureFromSurface(renderer, raw_menu_icon);
+    if (menu_icon == NULL) {
+      LOG_Error("Failed to create menu icon texture.\n");
+    } else {
+      menu_icon_size.width = raw_menu_icon->w;
+      menu_icon_size.height = raw_menu_icon->h;
+    }
+    if (num_menu_icons + 1 >= get_display_count()) {
+      SDL_FreeSurface(raw_menu_icon);
+      raw_menu_icon = NULL;
+    }
+  } else {
+    menu_icon = SDL_CreateTexture(renderer,
+                                  MENU_PIXEL_FORMAT,
+                                  SDL_TEXTUREACCESS_STATIC,
+                                  builtin_menu_width,
+                                  builtin_menu_height);
+    if ((menu_icon == NULL) ||
+        (SDL_UpdateTexture(menu_icon,
+                           NULL,
+                           builtin_menu_pixels,
+                           builtin_menu_width * MENU_PIXEL_BYTES) != 0)) {
+      LOG_Error("Failed to create menu icon texture.\n");
+    } else {
+      SDL_SetTextureBlendMode(menu_icon, SDL_BLENDMODE_BLEND);
+      menu_icon_size.width = builtin_menu_width;
+      menu_icon_size.height = builtin_menu_height;
+    }
+  }
+  if (num_menu_icons < MAX_DISPLAYS) {
+    menu_icons[num_menu_icons].renderer = renderer;
+    menu_icons[num_menu_icons].texture = menu_icon;
+    num_menu_icons++;
+  }
+}
+
+void init_images(SDL_Renderer *renderer) {
+  decode_images();
+  upload_images(renderer);
+}
+
+void paint_menu(SDL_Renderer *renderer, int density) {
+  int          i;
   SDL_Rect     rectangle;
- 
-  rectangle.x  = 10;
-  rectangle.y  = 10;
-  rectangle.w  = 60;
-  rectangle.h  = 60;
-  menu_icon = SDL_CreateTextureFromSurface(renderer, optimized_menu_icon);
-  SDL_RenderCopy(renderer, menu_icon, NULL, &rectangle);
-  SDL_DestroyTexture(menu_icon);
+
+  for (i = 0; i < num_menu_icons; i++) {
+    if ((menu_icons[i].renderer == renderer) &&
+        (menu_icons[i].texture != NULL)) {
+      rectangle.x  = 10;
+      rectangle.y  = 10;
+      rectangle.w  = 60;
+      rectangle.h  = 60;
+      batch_copy(menu_icons[i].texture, menu_icon_size, NULL, &rectangle,
+                 density);
+    }
+  }
 }
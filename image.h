@@ -1,5 +1,8 @@
+
+extern void decode_images(void);
+
 #if defined NEED_SDL
-extern void init_images(SDL_Window *window);
-extern void paint_menu(SDL_Renderer *renderer);
+extern void upload_images(SDL_Renderer *renderer);
+extern void init_images(SDL_Renderer *renderer);
+extern void paint_menu(SDL_Renderer *renderer, int density);
 #endif
-
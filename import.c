@@ -0,0 +1,511 @@
+/*
+ *  Bulk alarm import.  See import.h.
+ *
+ *  Nothing here allocates.  A line too long for the buffer is thrown
+ *  away rather than read in pieces - no line that means anything to
+ *  us comes close.
+ */
+
+#include "includes.h"
+
+/*
+ *================================================================
+ *
+ *  Constants.
+ *
+ *================================================================
+ */
+
+#define LINE_LENGTH 256
+#define DATE_LENGTH 10                /* YYYY-MM-DD */
+
+/*
+ *================================================================
+ *
+ *  Type definitions.
+ *
+ *================================================================
+ */
+
+typedef struct {
+  int  imported;
+  int  skipped;               /* Lines or events we couldn't use */
+  bool full;                  /* The alarm pool's run out */
+} t_counts;
+
+typedef enum {
+  fq_none,                    /* A one-off */
+  fq_daily,
+  fq_weekly
+} t_frequency;
+
+typedef struct {
+  bool        in_event;
+  bool        started;        /* Had a DTSTART with a time of day */
+  bool        usable;         /* Nothing in it we can't do */
+  int         trigger_time;
+  char        date[DATE_LENGTH + 1];
+  int         weekday;        /* Of date, 0 = Sunday */
+  t_frequency frequency;
+  int         interval;
+  bool        by_day;         /* days[] came from BYDAY */
+  bool        days[7];
+  bool        sunday_weeks;   /* WKST=SU, as our weeks are */
+} t_event;
+
+/*
+ *================================================================
+ *
+ *  Local data.
+ *
+ *================================================================
+ */
+
+static const char *ics_days[] = {
+  "SU",
+  "MO",
+  "TU",
+  "WE",
+  "TH",
+  "FR",
+  "SA"
+};
+
+/*
+ *================================================================
+ *
+ *  Forward declarations.
+ *
+ *================================================================
+ */
+
+static bool read_line(FILE *file, char *line, int size);
+
+static bool ends_with(const char *text, const char *ending);
+
+static char *next_field(char **cursor, char separator);
+
+static int time_of_day(const char *text);
+
+static void store(t_individual_alarm *alarm, t_counts *counts);
+
+static void csv_line(char *line, t_counts *counts);
+
+static void ics_property(char *property, t_event *event, t_counts *counts);
+
+static void ics_start(t_event *event, const char *value);
+
+static void ics_rule(t_event *event, char *value);
+
+static void ics_end(t_event *event, t_counts *counts);
+
+static int ics_day(const char *text);
+
+/*
+ *================================================================
+ *
+ *  Externally visible routines.
+ *
+ *================================================================
+ */
+
+bool import_alarms(const char *file_name) {
+  /*
+   * Returns FALSE if the file couldn't be read at all.  The alarms
+   * which were read before running out of room are kept.
+   */
+  t_counts  counts = {0, 0, FALSE};
+  t_event   event;
+  FILE     *file;
+  bool      ics;
+  char      line[LINE_LENGTH + 1];
+  char      property[LINE_LENGTH + 1];    /* iCalendar, unfolded */
+  bool      result = FALSE;
+
+  file = fopen(file_name, "r");
+  if (file == NULL) {
+    LOG_Error("Failed to open alarm import file \"%s\".\n", file_name);
+  } else {
+    ics = ends_with(file_name, ".ics");
+    event.in_event = FALSE;
+    property[0] = '\0';
+    while (!counts.full && read_line(file, line, sizeof(line))) {
+      if (!ics) {
+        csv_line(line, &counts);
+      } else if ((line[0] == ' ') || (line[0] == '\t')) {
+        /*
+         * A folded continuation of the last line.  If the whole is
+         * too long it can't be one we want.
+         */
+        if (strlen(property) + strlen(line + 1) < sizeof(property)) {
+          strcat(property, line + 1);
+        } else {
+          property[0] = '\0';
+        }
+      } else {
+        ics_property(property, &event, &counts);
+        strcpy(property, line);
+      }
+    }
+    if (ics && !counts.full) {
+      ics_property(property, &event, &counts);
+    }
+    result = !ferror(file);
+    fclose(file);
+    if (counts.full) {
+      LOG_Error("Alarm import stopped at %d alarms - limit is %d.\n",
+                alarm_count(),
+                MAX_ALARMS);
+    }
+    QLOG_Info(("Imported %d alarms, skipped %d.\n",
+               counts.imported,
+               counts.skipped));
+  }
+  return result;
+}
+
+/*
+ *================================================================
+ *
+ *  Local routines.
+ *
+ *================================================================
+ */
+
+static bool read_line(FILE *file, char *line, int size) {
+  /*
+   * The next line without its line ending, or an empty one in place
+   * of any that won't fit.  FALSE at the end of the file.
+   */
+  int    next;
+  size_t length;
+  bool   result = FALSE;
+
+  if (fgets(line, size, file) != NULL) {
+    result = TRUE;
+    length = strlen(line);
+    if ((length > 0) && (line[length - 1] == '\n')) {
+      line[--length] = '\0';
+      if ((length > 0) && (line[length - 1] == '\r')) {
+        line[--length] = '\0';
+      }
+    } else if (!feof(file)) {
+      QLOG_Warning(("Alarm import line too long - skipped.\n"));
+      do {
+        next = getc(file);
+      } while ((next != '\n') && (next != EOF));
+      line[0] = '\0';
+    }
+  }
+  return result;
+}
+
+
+static bool ends_with(const char *text, const char *ending) {
+  size_t length;
+  size_t ending_length;
+
+  length = strlen(text);
+  ending_length = strlen(ending);
+  return (length >= ending_length) &&
+         (strcmp(text + length - ending_length, ending) == 0);
+}
+
+
+static char *next_field(char **cursor, char separator) {
+  /*
+   * Split off the text up to the next separator (or the end of the
+   * line) with spaces trimmed from either end, and move past it.  Once
+   * there's nothing left the fields are all NULL.
+   */
+  char *end;
+  char *result = NULL;
+
+  if (*cursor != NULL) {
+    result = *cursor;
+    end = strchr(result, separator);
+    if (end == NULL) {
+      *cursor = NULL;
+      end = result + strlen(result);
+    } else {
+      *end = '\0';
+      *cursor = end + 1;
+    }
+    while ((end > result) && (end[-1] == ' ')) {
+      *--end = '\0';
+    }
+    while (*result == ' ') {
+      result++;
+    }
+  }
+  return result;
+}
+
+
+static int time_of_day(const char *text) {
+  /*
+   * Makes sure it's a time before letting interpret_alarm_time() at
+   * it, which takes anything.  -1 if it's not.
+   */
+  int hours;
+  int minutes;
+  int result = -1;
+  int seconds = 0;
+
+  if ((*text != '\0') && (strspn(text, "0123456789:") == strlen(text))) {
+    if (strchr(text, ':') == NULL) {
+      result = interpret_alarm_time((yaml_char_t *) text);
+    } else if ((sscanf(text, "%d:%d:%d", &hours, &minutes, &seconds) >= 2) &&
+               (hours < 24) && (minutes < 60) && (seconds < 60)) {
+      result = interpret_alarm_time((yaml_char_t *) text);
+    }
+    if (result >= SECONDS_PER_DAY) {
+      result = -1;
+    }
+  }
+  return result;
+}
+
+
+static void store(t_individual_alarm *alarm, t_counts *counts) {
+  if (alarm_count() >= MAX_ALARMS) {
+    counts->full = TRUE;
+  } else if (add_alarm(*alarm) >= 0) {
+    counts->imported++;
+  } else {
+    counts->skipped++;
+  }
+}
+
+
+static void csv_line(char *line, t_counts *counts) {
+  /*
+   * time,days,display,date
+   */
+  t_individual_alarm  alarm;
+  char               *cursor;
+  char               *date;
+  int                 day;
+  char               *days;
+  char               *display;
+  char               *name;
+  bool                ok;
+  char               *trigger;
+
+  cursor = line;
+  trigger = next_field(&cursor, ',');
+  if ((*trigger != '\0') && (*trigger != '#')) {
+    days = next_field(&cursor, ',');
+    display = next_field(&cursor, ',');
+    date = next_field(&cursor, ',');
+    recurrence_init(&alarm.rule);
+    alarm.trigger_time = time_of_day(trigger);
+    alarm.display = ((display != NULL) && (*display != '\0')) ?
+                    atoi(display) : 0;
+    ok = (alarm.trigger_time >= 0) && (cursor == NULL);
+    for (day = 0; day < 7; day++) {
+      alarm.days[day] = ((days == NULL) || (*days == '\0'));
+    }
+    while (ok && (days != NULL) && (*days != '\0')) {
+      name = next_field(&days, ' ');
+      if (*name != '\0') {
+        day = identify_alarm_day((yaml_char_t *) name);
+        if (day < 0) {
+          ok = FALSE;
+        } else {
+          alarm.days[day] = TRUE;
+        }
+      }
+    }
+    if (ok && (date != NULL) && (*date != '\0')) {
+      ok = recurrence_add_date(&alarm.rule, date);
+    }
+    if (ok) {
+      store(&alarm, counts);
+    } else {
+      QLOG_Debug(("Alarm import skipped \"%s\".\n", trigger));
+      counts->skipped++;
+    }
+  }
+}
+
+
+static void ics_property(char *property, t_event *event, t_counts *counts) {
+  /*
+   * NAME;PARAMETERS:VALUE - only a handful matter, and only inside a
+   * VEVENT.
+   */
+  char *name_end;
+  char *value;
+
+  value = strchr(property, ':');
+  if (value != NULL) {
+    *value++ = '\0';
+    name_end = strchr(property, ';');
+    if (name_end != NULL) {
+      *name_end = '\0';
+    }
+    if (strcmp(property, "BEGIN") == 0) {
+      if (strcmp(value, "VEVENT") == 0) {
+        memset(event, 0, sizeof(t_event));
+        event->in_event = TRUE;
+        event->usable = TRUE;
+        event->interval = 1;
+      }
+    } else if (event->in_event) {
+      if (strcmp(property, "END") == 0) {
+        if (strcmp(value, "VEVENT") == 0) {
+          ics_end(event, counts);
+          event->in_event = FALSE;
+        }
+      } else if (strcmp(property, "DTSTART") == 0) {
+        ics_start(event, value);
+      } else if ((strcmp(property, "RRULE") == 0) &&
+                 (event->frequency == fq_none)) {
+        ics_rule(event, value);
+      } else if ((strcmp(property, "RRULE") == 0) ||
+                 (strcmp(property, "RDATE") == 0) ||
+                 (strcmp(property, "EXRULE") == 0) ||
+                 (strcmp(property, "EXDATE") == 0)) {
+        event->usable = FALSE;
+      }
+    }
+  }
+}
+
+
+static void ics_start(t_event *event, const char *value) {
+  /*
+   * YYYYMMDDTHHMMSS, with a Z on the end for UTC.  A bare date is an
+   * all-day event.
+   */
+  int       count;
+  int       day;
+  struct tm tm;
+  time_t    when;
+  char      zone = '\0';
+
+  memset(&tm, 0, sizeof(tm));
+  count = sscanf(value, "%4d%2d%2dT%2d%2d%2d%c",
+                 &tm.tm_year, &tm.tm_mon, &tm.tm_mday,
+                 &tm.tm_hour, &tm.tm_min, &tm.tm_sec,
+                 &zone);
+  if ((count < 6) || (tm.tm_mon < 1) || (tm.tm_mon > 12) ||
+      (tm.tm_mday < 1) || (tm.tm_mday > 31)) {
+    event->usable = FALSE;
+  } else {
+    if (zone == 'Z') {
+      tm.tm_year -= 1900;
+      tm.tm_mon--;
+      when = timegm(&tm);
+      localtime_r(&when, &tm);
+      tm.tm_year += 1900;
+      tm.tm_mon++;
+    }
+    day = day_number(tm.tm_year, tm.tm_mon, tm.tm_mday);
+    event->weekday = ((day % 7) + 11) % 7;      /* 1970 began on a Thursday */
+    event->trigger_time = (((tm.tm_hour * 60) + tm.tm_min) * 60) + tm.tm_sec;
+    snprintf(event->date, sizeof(event->date), "%04d-%02d-%02d",
+             tm.tm_year,
+             tm.tm_mon,
+             tm.tm_mday);
+    event->started = (event->trigger_time < SECONDS_PER_DAY);
+  }
+}
+
+
+static void ics_rule(t_event *event, char *value) {
+  /*
+   * e.g. FREQ=WEEKLY;INTERVAL=2;BYDAY=MO,WE
+   */
+  char *cursor;
+  int   day;
+  char *key;
+  char *part;
+
+  cursor = value;
+  event->frequency = fq_weekly;                   /* Until FREQ says */
+  while (event->usable && (cursor != NULL)) {
+    part = next_field(&cursor, ';');
+    key = next_field(&part, '=');
+    if (part == NULL) {
+      event->usable = FALSE;
+    } else if (strcmp(key, "FREQ") == 0) {
+      if (strcmp(part, "DAILY") == 0) {
+        event->frequency = fq_daily;
+      } else if (strcmp(part, "WEEKLY") != 0) {
+        event->usable = FALSE;
+      }
+    } else if (strcmp(key, "INTERVAL") == 0) {
+      event->interval = atoi(part);
+      event->usable = (event->interval > 0);
+    } else if (strcmp(key, "BYDAY") == 0) {
+      event->by_day = TRUE;
+      while (event->usable && (part != NULL)) {
+        day = ics_day(next_field(&part, ','));
+        if (day < 0) {
+          event->usable = FALSE;                  /* e.g. 1MO */
+        } else {
+          event->days[day] = TRUE;
+        }
+      }
+    } else if (strcmp(key, "WKST") == 0) {
+      event->sunday_weeks = (strcmp(part, "SU") == 0);
+    } else {
+      event->usable = FALSE;
+    }
+  }
+}
+
+
+static void ics_end(t_event *event, t_counts *counts) {
+  t_individual_alarm alarm;
+  int                day;
+  bool               ok;
+
+  ok = event->usable && event->started;
+  if (ok) {
+    recurrence_init(&alarm.rule);
+    alarm.trigger_time = event->trigger_time;
+    alarm.display = 0;
+    for (day = 0; day < 7; day++) {
+      alarm.days[day] = event->by_day ? event->days[day] :
+                        (event->frequency != fq_weekly) ||
+                        (day == event->weekday);
+    }
+    if (event->frequency == fq_none) {
+      ok = recurrence_add_date(&alarm.rule, event->date);
+    } else if (event->frequency == fq_daily) {
+      ok = (event->interval == 1);
+    } else if (event->interval > 1) {
+      /*
+       * Our weeks run Sunday to Saturday, iCalendar's from WKST -
+       * Monday unless it says.  That only matters if it's on Sunday.
+       */
+      alarm.rule.interval = event->interval;
+      ok = event->sunday_weeks || !alarm.days[0];
+    }
+    if (ok && (event->frequency != fq_none)) {
+      ok = recurrence_set_start(&alarm.rule, event->date);
+    }
+  }
+  if (ok) {
+    store(&alarm, counts);
+  } else {
+    counts->skipped++;
+  }
+}
+
+
+static int ics_day(const char *text) {
+  int i;
+  int result = -1;
+
+  for (i = 0; i < 7; i++) {
+    if (strcmp(text, ics_days[i]) == 0) {
+      result = i;
+      break;
+    }
+  }
+  return result;
+}
@@ -0,0 +1,40 @@
+/*
+ *  Bulk alarm import.  A rota system can produce thousands of alarms,
+ *  far more than it's sensible to write out under :alarms: and put
+ *  through the YAML parser, so they can come from a separate file named
+ *  by the alarm_import_file setting.  It's read a line at a time into a
+ *  fixed buffer and each alarm goes straight into the index as it's
+ *  read, so however long the file is nothing grows but the alarm pool
+ *  itself (and that's a fixed size - see MAX_ALARMS).
+ *
+ *  A file whose name ends ".ics" is taken as iCalendar, anything else
+ *  as CSV, one alarm to a line:
+ *
+ *    # time,days,display,date
+ *    06:00,Monday Tuesday Wednesday
+ *    14:30:00,,1,2024-03-05
+ *
+ *  time is as in the configuration file.  days is a list of day names
+ *  separated by spaces, or empty for every day.  display is 0 if it's
+ *  left out.  A date makes it a one-off on that day.  Blank lines,
+ *  comments and lines which don't start with a time (a heading, say)
+ *  are passed over.  Fields can't be quoted.
+ *
+ *  From iCalendar, each VEVENT's DTSTART gives the time - and the day,
+ *  if the event doesn't repeat.  Times in UTC are converted; any other
+ *  time zone is taken to be local.  An RRULE of FREQ=DAILY, or of
+ *  FREQ=WEEKLY with optional BYDAY and INTERVAL, makes it repeat from
+ *  DTSTART on.  Events with anything more - COUNT, UNTIL, EXDATE and
+ *  the like - or with no time of day are left out rather than guessed
+ *  at.
+ */
+
+/*
+ *================================================================
+ *
+ *  External declarations.
+ *
+ *================================================================
+ */
+
+extern bool import_alarms(const char *file_name);
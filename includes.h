@@ -1,10 +1,23 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdarg.h>
 #include <string.h>
+#include <stddef.h>
+#include <limits.h>
+#include <math.h>
 #define __USE_XOPEN
 #include <time.h>
 #include <assert.h>
 #include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
 #include <yaml.h>
 #define PCRE2_CODE_UNIT_WIDTH 8
 #include <pcre2.h>
@@ -12,13 +25,37 @@
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_ttf.h>
 #include <SDL2/SDL_image.h>
+#include <SDL2/SDL_mixer.h>
 #endif
 #include "global.h"
 #include "logging.h"
 #include "linklist.h"
 #include "utils.h"
+#include "alloc_guard.h"
+#include "qlog.h"
+#include "metrics.h"
+#include "vclock.h"
+#include "tween.h"
+#include "latency.h"
+#include "quality.h"
+#include "zone.h"
+#include "recurrence.h"
 #include "alarms.h"
 #include "fonts.h"
+#include "pixels.h"
+#include "batch.h"
 #include "image.h"
+#include "dial.h"
 #include "settings.h"
+#include "startup.h"
+#include "workers.h"
+#include "sound.h"
+#include "assets.h"
+#include "despatch.h"
+#include "control.h"
+#include "replay.h"
+#include "status.h"
+#include "watchdog.h"
+#include "journal.h"
+#include "import.h"
 
@@ -0,0 +1,435 @@
+/*
+ *  State journal.  See journal.h.
+ *
+ *  We keep a copy of the state the journal describes, updated as each
+ *  record is written (or read back at start-up), so that compacting
+ *  it needs nothing from anywhere else.
+ */
+
+#include "includes.h"
+
+/*
+ *================================================================
+ *
+ *  Constants.
+ *
+ *================================================================
+ */
+
+#define JOURNAL_VERSION 2           /* 1 keyed skips on alarm ids */
+#define COMPACT_AFTER   512           /* Records */
+
+/*
+ *  If we were running before, anything which should have gone off in
+ *  this long before the restart still does.
+ */
+#define CATCH_UP_LIMIT  (15 * 60)
+
+#define FNV_OFFSET      2166136261UL
+#define FNV_PRIME       16777619UL
+
+/*
+ *================================================================
+ *
+ *  Type definitions.
+ *
+ *================================================================
+ */
+
+typedef enum {
+  j_header = 1,               /* alarm is sizeof(t_record), when version */
+  j_fired,                    /* alarm SNOOZE_ALARM(display) for a snooze */
+  j_snooze,                   /* alarm is the display, when 0 for cancelled */
+  j_skip,                     /* alarm is the alarm's key - see alarms.c */
+  j_dim                       /* alarm is TRUE or FALSE, when the display */
+} t_record_type;
+
+typedef struct {
+  int           type;
+  int           alarm;
+  long          when;
+  unsigned long check;        /* Over everything before it */
+} t_record;
+
+typedef struct {
+  int    key;
+  time_t occurrence;
+} t_skip;
+
+/*
+ *================================================================
+ *
+ *  Local data.
+ *
+ *================================================================
+ */
+
+static int  journal_fd = -1;
+static int  records = 0;                 /* In the file now */
+static long version = JOURNAL_VERSION;   /* Of the file we're using */
+
+static time_t last_fired = 0;
+static time_t snooze_until[MAX_DISPLAYS];
+static bool   dimmed[MAX_DISPLAYS];
+static t_skip skips[MAX_ALARMS];
+static int    num_skips = 0;
+
+/*
+ *================================================================
+ *
+ *  Forward declarations.
+ *
+ *================================================================
+ */
+
+static unsigned long checksum(const t_record *record);
+
+static void fill_record(
+    t_record *record,
+    int       type,
+    int       alarm,
+    time_t    when);
+
+static bool apply(const t_record *record);
+
+static void append(int type, int alarm, time_t when);
+
+static void compact(void);
+
+static void sync_directory(const char *file_name);
+
+/*
+ *================================================================
+ *
+ *  Externally visible routines.
+ *
+ *================================================================
+ */
+
+bool journal_open(void) {
+  /*
+   * Replay the journal and put the alarms back as they were.  Returns
+   * TRUE if there was anything to replay.  Reading stops at the first
+   * record which doesn't check out - most likely half-written when we
+   * died - and the file is cut back to just before it.
+   */
+  int             good = 0;
+  int             i;
+  int             kept = 0;
+  void           *map = MAP_FAILED;
+  time_t          now;
+  const t_record *record;
+  bool            result = FALSE;
+  struct stat     status;
+  int             total = 0;
+
+  journal_fd = open(get_state_journal(),
+                    O_RDWR | O_CREAT | O_APPEND,
+                    0644);
+  if (journal_fd < 0) {
+    LOG_Error("Failed to open state journal \"%s\".\n", get_state_journal());
+  } else {
+    if ((fstat(journal_fd, &status) == 0) &&
+        (status.st_size >= (off_t) sizeof(t_record))) {
+      total = status.st_size / sizeof(t_record);
+      map = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, journal_fd, 0);
+    }
+    if (map != MAP_FAILED) {
+      record = map;
+      if ((record->type == j_header) &&
+          (record->alarm == sizeof(t_record)) &&
+          (record->when >= 1) &&
+          (record->when <= JOURNAL_VERSION) &&
+          (record->check == checksum(record))) {
+        version = record->when;
+        for (good = 1; good < total; good++) {
+          if (!apply(record + good)) {
+            break;
+          }
+        }
+      }
+      munmap(map, status.st_size);
+    }
+    if ((off_t) (good * sizeof(t_record)) != status.st_size) {
+      QLOG_Warning(("State journal damaged - kept %d of %d records.\n",
+                    good,
+                    total));
+      ftruncate(journal_fd, good * sizeof(t_record));
+    }
+    records = good;
+    if (records == 0) {
+      version = JOURNAL_VERSION;
+      append(j_header, sizeof(t_record), JOURNAL_VERSION);
+    } else {
+      result = TRUE;
+      /*
+       * A skip whose alarm has been changed or removed since is
+       * forgotten.
+       */
+      for (i = 0; i < num_skips; i++) {
+        if (restore_skip(skips[i].key, skips[i].occurrence)) {
+          skips[kept++] = skips[i];
+        }
+      }
+      if (kept != num_skips) {
+        QLOG_Info(("Dropped %d skips for alarms which have changed.\n",
+                   num_skips - kept));
+        num_skips = kept;
+      }
+      for (i = 0; i < MAX_DISPLAYS; i++) {
+        restore_snooze(i, snooze_until[i]);
+      }
+      /*
+       * Pick up from the last alarm to go off, but don't go back
+       * further than CATCH_UP_LIMIT.
+       */
+      now = vclock_now();
+      resume_alarms((last_fired > now - CATCH_UP_LIMIT) ?
+                    last_fired : now - CATCH_UP_LIMIT);
+      QLOG_Info(("Replayed %d state journal records.\n", records));
+      if ((records > COMPACT_AFTER) || (version != JOURNAL_VERSION)) {
+        compact();
+      }
+    }
+  }
+  return result;
+}
+
+void journal_close(void) {
+  if (journal_fd >= 0) {
+    close(journal_fd);
+    journal_fd = -1;
+  }
+}
+
+bool journal_dimmed(int display) {
+  return dimmed[display];
+}
+
+void journal_fired(int alarm, time_t when) {
+  append(j_fired, alarm, when);
+}
+
+void journal_snooze(int display, time_t until) {
+  append(j_snooze, display, until);
+}
+
+void journal_skip(int key, time_t occurrence) {
+  append(j_skip, key, occurrence);
+}
+
+void journal_dim(int display, bool now_dimmed) {
+  append(j_dim, now_dimmed, display);
+}
+
+/*
+ *================================================================
+ *
+ *  Local routines.
+ *
+ *================================================================
+ */
+
+static unsigned long checksum(const t_record *record) {
+  /*
+   * 32-bit FNV-1a.
+   */
+  const unsigned char *ptr;
+  const unsigned char *end;
+  unsigned long        hash = FNV_OFFSET;
+
+  end = (const unsigned char *) &record->check;
+  for (ptr = (const unsigned char *) record; ptr < end; ptr++) {
+    hash = ((hash ^ *ptr) * FNV_PRIME) & 0xffffffffUL;
+  }
+  return hash;
+}
+
+
+static void fill_record(
+    t_record *record,
+    int       type,
+    int       alarm,
+    time_t    when) {
+
+  memset(record, 0, sizeof(t_record));
+  record->type  = type;
+  record->alarm = alarm;
+  record->when  = when;
+  record->check = checksum(record);
+}
+
+
+static bool apply(const t_record *record) {
+  /*
+   * Bring our copy of the state up to date with one record.  Returns
+   * FALSE if it's not a valid record.
+   */
+  int  display;
+  int  i;
+  bool result = TRUE;
+
+  if (record->check != checksum(record)) {
+    result = FALSE;
+  } else {
+    switch (record->type) {
+      case j_fired:
+        display = SNOOZE_ALARM(record->alarm);    /* Undoes itself */
+        if ((display >= 0) && (display < MAX_DISPLAYS)) {
+          snooze_until[display] = 0;
+        }
+        if (record->when > last_fired) {
+          last_fired = record->when;
+        }
+        break;
+
+      case j_snooze:
+        if ((record->alarm >= 0) && (record->alarm < MAX_DISPLAYS)) {
+          snooze_until[record->alarm] = record->when;
+        } else {
+          result = FALSE;
+        }
+        break;
+
+      case j_skip:
+        /*
+         * Version 1 keyed them on alarm ids, which don't survive a
+         * restart, so they're left behind.
+         */
+        if (version < 2) {
+          break;
+        }
+        for (i = 0; i < num_skips; i++) {
+          if (skips[i].key == record->alarm) {
+            break;
+          }
+        }
+        if (i < MAX_ALARMS) {
+          skips[i].key = record->alarm;
+          skips[i].occurrence = record->when;
+          if (i == num_skips) {
+            num_skips++;
+          }
+        }
+        break;
+
+      case j_dim:
+        if ((record->when >= 0) && (record->when < MAX_DISPLAYS)) {
+          dimmed[record->when] = record->alarm;
+        } else {
+          result = FALSE;
+        }
+        break;
+
+      default:
+        result = FALSE;
+        break;
+
+    }
+  }
+  return result;
+}
+
+
+static void append(int type, int alarm, time_t when) {
+  t_record record;
+
+  fill_record(&record, type, alarm, when);
+  if (type != j_header) {
+    apply(&record);
+  }
+  if (journal_fd >= 0) {
+    if (write(journal_fd, &record, sizeof(record)) != sizeof(record)) {
+      QLOG_Error(("Failed to write to state journal.\n"));
+    } else {
+      records++;
+      if (records > COMPACT_AFTER) {
+        compact();
+      }
+    }
+  }
+}
+
+
+static void compact(void) {
+  /*
+   * Write the state as it stands to a fresh file and swap it in.
+   * Skips which are already in the past are dropped.  The new file
+   * has to be on the disk before it replaces the old one, or a power
+   * cut just after the rename could leave nothing at all.
+   */
+  int             count = 0;
+  int             fd;
+  int             i;
+  time_t          now;
+  static t_record state[2 + 2 * MAX_DISPLAYS + MAX_ALARMS];  /* Off the stack */
+  char            temp_name[PATH_MAX + 1];
+
+  now = vclock_now();
+  fill_record(state + count++, j_header, sizeof(t_record), JOURNAL_VERSION);
+  if (last_fired != 0) {
+    fill_record(state + count++, j_fired, 0, last_fired);
+  }
+  for (i = 0; i < MAX_DISPLAYS; i++) {
+    if (dimmed[i]) {
+      fill_record(state + count++, j_dim, dimmed[i], i);
+    }
+    if (snooze_until[i] != 0) {
+      fill_record(state + count++, j_snooze, i, snooze_until[i]);
+    }
+  }
+  for (i = 0; i < num_skips; i++) {
+    if (skips[i].occurrence > now) {
+      fill_record(state + count++, j_skip, skips[i].key,
+                  skips[i].occurrence);
+    }
+  }
+  snprintf(temp_name, sizeof(temp_name), "%s.new", get_state_journal());
+  fd = open(temp_name, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+  if ((fd < 0) ||
+      (write(fd, state, count * sizeof(t_record)) !=
+       (ssize_t) (count * sizeof(t_record))) ||
+      (fsync(fd) != 0) ||
+      (rename(temp_name, get_state_journal()) != 0)) {
+    QLOG_Error(("Failed to compact state journal.\n"));
+    if (fd >= 0) {
+      close(fd);
+      unlink(temp_name);
+    }
+  } else {
+    sync_directory(get_state_journal());
+    close(journal_fd);
+    journal_fd = fd;
+    version = JOURNAL_VERSION;
+    records = count;
+    QLOG_Debug(("Compacted state journal to %d records.\n", count));
+  }
+}
+
+
+static void sync_directory(const char *file_name) {
+  /*
+   * A rename is only safe once the directory it happened in has been
+   * written out too.
+   */
+  char  directory[PATH_MAX + 1];
+  int   fd;
+  char *slash;
+
+  snprintf(directory, sizeof(directory), "%s", file_name);
+  slash = strrchr(directory, '/');
+  if (slash == NULL) {
+    strcpy(directory, ".");
+  } else if (slash == directory) {
+    slash[1] = '\0';
+  } else {
+    *slash = '\0';
+  }
+  fd = open(directory, O_RDONLY);
+  if ((fd < 0) || (fsync(fd) != 0)) {
+    QLOG_Warning(("Failed to sync the state journal's directory.\n"));
+  }
+  if (fd >= 0) {
+    close(fd);
+  }
+}
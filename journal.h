@@ -0,0 +1,30 @@
+/*
+ *  State journal.  Changes to the clock's runtime state - alarms going
+ *  off, snoozes, dismissals and dimming, on each display - are appended
+ *  to a file as they happen so that after a restart (or a crash) we
+ *  carry on from where we were.  Each change is a single fixed-size
+ *  checksummed record written with one write().  The file is rewritten
+ *  with just the current state once it's grown long enough.
+ */
+
+/*
+ *================================================================
+ *
+ *  External declarations.
+ *
+ *================================================================
+ */
+
+extern bool journal_open(void);
+
+extern void journal_close(void);
+
+extern bool journal_dimmed(int display);
+
+extern void journal_fired(int alarm, time_t when);
+
+extern void journal_snooze(int display, time_t until);
+
+extern void journal_skip(int key, time_t occurrence);
+
+extern void journal_dim(int display, bool dimmed);
@@ -0,0 +1,145 @@
+/*
+ *  Input-to-present latency.  See latency.h.
+ */
+
+#define NEED_SDL
+#include "includes.h"
+
+/*
+ *================================================================
+ *
+ *  Local data.
+ *
+ *================================================================
+ */
+
+static const char *phase_names[NUM_LATENCY_PHASES] = {
+  "despatch",
+  "layout",
+  "rasterise",
+  "upload",
+  "present"
+};
+
+static t_histogram total_histogram = NO_HISTOGRAM;
+static t_histogram phase_histograms[NUM_LATENCY_PHASES];
+static t_metric    over_budget_metric = NO_METRIC;
+
+static bool            waiting = FALSE;    /* For an input to be shown */
+static Uint32          input_ticks;
+static long            phases[NUM_LATENCY_PHASES];
+static struct timespec frame_began;
+static struct timespec present_began;
+
+/*
+ *================================================================
+ *
+ *  Forward declarations.
+ *
+ *================================================================
+ */
+
+static long elapsed_us(const struct timespec *since);
+
+/*
+ *================================================================
+ *
+ *  Externally visible routines.
+ *
+ *================================================================
+ */
+
+void latency_init(void) {
+  char name[64];
+  int  i;
+
+  total_histogram = histogram_register("wake latency us");
+  for (i = 0; i < NUM_LATENCY_PHASES; i++) {
+    snprintf(name, sizeof(name), "wake %s us", phase_names[i]);
+    phase_histograms[i] = histogram_register(name);
+  }
+  over_budget_metric = metric_register("wakes over latency budget");
+}
+
+void latency_input(unsigned long timestamp) {
+  /*
+   * Called by the handler for an input which will change the screen.
+   * If several arrive before the next present the first one counts.
+   */
+  if (!waiting) {
+    waiting = TRUE;
+    input_ticks = timestamp;
+    memset(phases, 0, sizeof(phases));
+    phases[lp_despatch] = (long) (SDL_GetTicks() - input_ticks) * 1000L;
+  }
+}
+
+void latency_frame_begin(void) {
+  clock_gettime(CLOCK_MONOTONIC, &frame_began);
+  phases[lp_rasterise] = 0;
+  phases[lp_upload] = 0;
+}
+
+void latency_charge(
+    t_latency_phase        phase,
+    const struct timespec *since) {
+
+  phases[phase] += elapsed_us(since);
+}
+
+void latency_present_begin(void) {
+  clock_gettime(CLOCK_MONOTONIC, &present_began);
+}
+
+void latency_presented(void) {
+  /*
+   * The frame's on the screen.  If it's the one an input was waiting
+   * for then record how long it took.
+   */
+  int  i;
+  long total;
+
+  if (waiting) {
+    waiting = FALSE;
+    phases[lp_present] = elapsed_us(&present_began);
+    phases[lp_layout] = elapsed_us(&frame_began) -
+                        phases[lp_present] -
+                        phases[lp_rasterise] -
+                        phases[lp_upload];
+    total = (long) (SDL_GetTicks() - input_ticks) * 1000L;
+    histogram_add(total_histogram, total);
+    for (i = 0; i < NUM_LATENCY_PHASES; i++) {
+      histogram_add(phase_histograms[i], phases[i]);
+    }
+    if ((get_latency_budget() > 0) &&
+        (total > get_latency_budget() * 1000L)) {
+      metric_add(over_budget_metric, 1);
+      QLOG_Warning(("Wake took %ld us - budget is %d ms.\n",
+                    total,
+                    get_latency_budget()));
+      QLOG_Warning(("  despatch %ld  layout %ld  rasterise %ld  "
+                    "upload %ld  present %ld\n",
+                    phases[lp_despatch],
+                    phases[lp_layout],
+                    phases[lp_rasterise],
+                    phases[lp_upload],
+                    phases[lp_present]));
+    }
+  }
+}
+
+/*
+ *================================================================
+ *
+ *  Local routines.
+ *
+ *================================================================
+ */
+
+static long elapsed_us(const struct timespec *since) {
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return ((now.tv_sec - since->tv_sec) * 1000000L) +
+         ((now.tv_nsec - since->tv_nsec) / 1000L);
+}
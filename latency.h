@@ -0,0 +1,54 @@
+/*
+ *  Input-to-present latency.  When a tap wakes the screen we note the
+ *  SDL timestamp of the event and, once the frame which shows the
+ *  result has been presented, how long it took altogether and where
+ *  the time went:
+ *
+ *    despatch   - from the event being stamped to its handler running
+ *    layout     - building the frame, less the next two
+ *    rasterise  - opening faces and rendering glyphs not yet cached
+ *    upload     - turning glyph sheets into textures
+ *    present    - submitting the frame's batches and presenting it
+ *
+ *  Each goes into a histogram (in microseconds) with the other metrics.
+ *  A wake which takes longer than the configured budget is logged.
+ */
+
+/*
+ *================================================================
+ *
+ *  Type definitions.
+ *
+ *================================================================
+ */
+
+typedef enum {
+  lp_despatch,
+  lp_layout,
+  lp_rasterise,
+  lp_upload,
+  lp_present,
+  NUM_LATENCY_PHASES
+} t_latency_phase;
+
+/*
+ *================================================================
+ *
+ *  External declarations.
+ *
+ *================================================================
+ */
+
+extern void latency_init(void);
+
+extern void latency_input(unsigned long timestamp);
+
+extern void latency_frame_begin(void);
+
+extern void latency_charge(
+    t_latency_phase        phase,
+    const struct timespec *since);
+
+extern void latency_present_begin(void);
+
+extern void latency_presented(void);
@@ -0,0 +1,207 @@
+/*
+ *  Run-time metrics.  See metrics.h.
+ */
+
+#include "includes.h"
+
+/*
+ *================================================================
+ *
+ *  Constants.
+ *
+ *================================================================
+ */
+
+#define MAX_METRICS     64
+#define MAX_HISTOGRAMS  8
+#define MAX_METRIC_NAME 31
+#define MAX_LINE        256
+
+/*
+ *================================================================
+ *
+ *  Type definitions.
+ *
+ *================================================================
+ */
+
+typedef struct {
+  char          name[MAX_METRIC_NAME + 1];
+  volatile long value;
+} t_metric_record;
+
+typedef struct {
+  char          name[MAX_METRIC_NAME + 1];
+  volatile long count;
+  volatile long total;
+  volatile long max;
+  volatile long buckets[HISTOGRAM_BUCKETS];
+} t_histogram_record;
+
+/*
+ *================================================================
+ *
+ *  Local data.
+ *
+ *================================================================
+ */
+
+static t_metric_record metrics[MAX_METRICS];
+static int             num_metrics = 0;
+
+static t_histogram_record histograms[MAX_HISTOGRAMS];
+static int                num_histograms = 0;
+
+static pthread_mutex_t register_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ *================================================================
+ *
+ *  Externally visible routines.
+ *
+ *================================================================
+ */
+
+t_metric metric_register(const char *name) {
+  /*
+   * Registering a name which is already there gives back the same
+   * counter.  Returns NO_METRIC if the table is full, which is
+   * quietly ignored by everything else.
+   */
+  t_metric result = NO_METRIC;
+  int      i;
+
+  pthread_mutex_lock(&register_lock);
+  for (i = 0; i < num_metrics; i++) {
+    if (strcmp(metrics[i].name, name) == 0) {
+      result = i;
+      break;
+    }
+  }
+  if ((result == NO_METRIC) && (num_metrics < MAX_METRICS)) {
+    safe_copy(metrics[num_metrics].name, name, MAX_METRIC_NAME, "Metric");
+    metrics[num_metrics].value = 0;
+    result = num_metrics++;
+  }
+  pthread_mutex_unlock(&register_lock);
+  if (result == NO_METRIC) {
+    QLOG_Warning(("No room for metric \"%s\".\n", name));
+  }
+  return result;
+}
+
+void metric_add(t_metric metric, long amount) {
+  if ((metric >= 0) && (metric < num_metrics)) {
+    __sync_fetch_and_add(&metrics[metric].value, amount);
+  }
+}
+
+long metric_value(t_metric metric) {
+  long result = 0;
+
+  if ((metric >= 0) && (metric < num_metrics)) {
+    result = metrics[metric].value;
+  }
+  return result;
+}
+
+t_histogram histogram_register(const char *name) {
+  /*
+   * As for metric_register().
+   */
+  t_histogram result = NO_HISTOGRAM;
+  int         i;
+
+  pthread_mutex_lock(&register_lock);
+  for (i = 0; i < num_histograms; i++) {
+    if (strcmp(histograms[i].name, name) == 0) {
+      result = i;
+      break;
+    }
+  }
+  if ((result == NO_HISTOGRAM) && (num_histograms < MAX_HISTOGRAMS)) {
+    memset(histograms + num_histograms, 0, sizeof(t_histogram_record));
+    safe_copy(histograms[num_histograms].name, name, MAX_METRIC_NAME,
+              "Histogram");
+    result = num_histograms++;
+  }
+  pthread_mutex_unlock(&register_lock);
+  if (result == NO_HISTOGRAM) {
+    QLOG_Warning(("No room for histogram \"%s\".\n", name));
+  }
+  return result;
+}
+
+void histogram_add(t_histogram histogram, long value) {
+  int                 bucket = 0;
+  long                bound = HISTOGRAM_BASE;
+  long                max;
+  t_histogram_record *record;
+
+  if ((histogram >= 0) && (histogram < num_histograms)) {
+    record = histograms + histogram;
+    while ((bucket < HISTOGRAM_BUCKETS - 1) && (value >= bound)) {
+      bucket++;
+      bound *= 2;
+    }
+    __sync_fetch_and_add(&record->buckets[bucket], 1);
+    __sync_fetch_and_add(&record->count, 1);
+    __sync_fetch_and_add(&record->total, value);
+    max = record->max;
+    while ((value > max) &&
+           !__sync_bool_compare_and_swap(&record->max, max, value)) {
+      max = record->max;
+    }
+  }
+}
+
+void metrics_report(void) {
+  /*
+   * Histogram lines are too long to go through the queued log.  This
+   * isn't on any path which matters so logs directly.
+   */
+  char line[MAX_LINE];
+  int  i;
+
+  LOG_Info("Metrics:\n");
+  for (i = 0; i < metrics_lines(); i++) {
+    metrics_line(i, line, sizeof(line));
+    LOG_Info("  %s\n", line);
+  }
+}
+
+int metrics_lines(void) {
+  return num_metrics + num_histograms;
+}
+
+int metrics_line(int line, char *buffer, int size) {
+  /*
+   * Put one line of the metrics, without a newline, into buffer.
+   * Returns its length.
+   */
+  int                 i;
+  int                 length = 0;
+  t_histogram_record *record;
+
+  buffer[0] = '\0';
+  if ((line >= 0) && (line < num_metrics)) {
+    length = snprintf(buffer, size, "%s\t%ld",
+                      metrics[line].name,
+                      metrics[line].value);
+  } else if ((line >= num_metrics) && (line < metrics_lines())) {
+    record = histograms + (line - num_metrics);
+    length = snprintf(buffer, size, "%s\t%ld %ld %ld",
+                      record->name,
+                      record->count,
+                      record->total,
+                      record->max);
+    for (i = 0; (i < HISTOGRAM_BUCKETS) && (length < size); i++) {
+      length += snprintf(buffer + length, size - length, " %ld",
+                         record->buckets[i]);
+    }
+  }
+  if (length >= size) {
+    length = size - 1;
+  }
+  return length;
+}
@@ -0,0 +1,64 @@
+/*
+ *  Run-time metrics.  A fixed table of named counters which any part
+ *  of the program can add to, from any thread, without allocating.
+ *  Counters are registered up front and then referred to by the
+ *  handle registration returns.
+ *
+ *  Histograms work the same way.  Each keeps a count, total and
+ *  maximum and counts values into buckets which double in size - the
+ *  first is for values under HISTOGRAM_BASE and the last for anything
+ *  HISTOGRAM_BASE << (HISTOGRAM_BUCKETS - 2) or more.
+ *
+ *  Everything can be read back as lines of text, "name<tab>value" for
+ *  a counter and "name<tab>count total max bucket..." for a histogram.
+ */
+
+/*
+ *================================================================
+ *
+ *  Constants.
+ *
+ *================================================================
+ */
+
+#define NO_METRIC    -1
+#define NO_HISTOGRAM -1
+
+#define HISTOGRAM_BUCKETS 12
+#define HISTOGRAM_BASE    1000
+
+/*
+ *================================================================
+ *
+ *  Type definitions.
+ *
+ *================================================================
+ */
+
+typedef int t_metric;
+
+typedef int t_histogram;
+
+/*
+ *================================================================
+ *
+ *  External declarations.
+ *
+ *================================================================
+ */
+
+extern t_metric metric_register(const char *name);
+
+extern void metric_add(t_metric metric, long amount);
+
+extern long metric_value(t_metric metric);
+
+extern t_histogram histogram_register(const char *name);
+
+extern void histogram_add(t_histogram histogram, long value);
+
+extern void metrics_report(void);
+
+extern int metrics_lines(void);
+
+extern int metrics_line(int line, char *buffer, int size);
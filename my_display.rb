@@ -0,0 +1,155 @@
+#
+#  I propose to wrap up the SDL stuff a bit.  Other things apart from
+#  my clock class might want to write to it.
+#
+#  Text goes through the extension's glyph atlases (ClockCore::Text, see
+#  ext/clock_core) when that's been built, and a surface and texture at
+#  a time when it hasn't.
+#
+require 'sdl2'
+
+class MyDisplay
+
+  #
+  #  I propose to provide methods to write text to the screen.  You can
+  #  specify a reference point from which to start, then an offset from
+  #  that reference.
+  #
+  #  If you specify left reference the offset will be for the left of
+  #  the text.
+  #
+  #  If you specify right reference the offset will be for the right of
+  #  the text.
+  #
+  #  If you specify centre reference then the offset will be for the
+  #  centre of the text.
+  #
+  #  In other words, how far to move from touching the left edge, touching
+  #  the right edge or being centred.
+  #
+  #  Random means put it in a random place but still on the screen.
+  #  The random position will still be on the screen (if possible) but
+  #  if you also specify an offset then you might push it off.
+  #
+  #  Likewise for vertical.
+  #
+  #  Sadly, plain Ruby doesn't have an enum type (although Rails adds one).
+  #
+  #enum horizontal_reference: [:left, :centre, :right, :random]
+  #enum vertical_reference: [:top, :middle, :bottom, :random]
+  #
+
+  #
+  #  Curiously, you don't need any kind of handle on the display in order
+  #  to write to it.  This is used purely to get dimensions.
+  #
+  attr_reader :width, :height
+
+  def initialize(config)
+    SDL2.init(SDL2::INIT_EVERYTHING)
+    SDL2::TTF.init
+    @display = SDL2::Display.displays[0]
+    @width = @display.current_mode.w
+    @height = @display.current_mode.h
+    puts "Initial width and height #{@width}, #{@height}"
+    SDL2::Mouse::Cursor.hide
+    @window = SDL2::Window.create(
+      config.title,
+      SDL2::Window::POS_CENTERED,
+      SDL2::Window::POS_CENTERED,
+      config.screen_width,
+      config.screen_height,
+      SDL2::Window::Flags::FULLSCREEN)        # Flags
+    @renderer = @window.create_renderer(
+      -1,       # Index
+      0)        # Flags
+    @width = @display.current_mode.w
+    @height = @display.current_mode.h
+    puts "Final width and height #{@width}, #{@height}"
+
+#    while SDL2::Mixer::Channels.play?(0)
+#      sleep 1
+#    end
+    @random = Random.new
+    #
+    #  With the extension text comes from glyph atlases, a whole frame
+    #  at a time, instead of a new surface and texture for every call.
+    #
+    if defined?(ClockCore)
+      @text = ClockCore::Text.new(@window)
+    end
+  end
+
+  #
+  #  What to pass to paint_text as its font.
+  #
+  def open_font(file_name, size)
+    if @text
+      @text.face(file_name, size)
+    else
+      SDL2::TTF.open(file_name, size)
+    end
+  end
+
+  def blank_buffer
+    @renderer.draw_color = [0,0,0]
+    @renderer.fill_rect(
+      SDL2::Rect.new(0,0,@width,@height))
+    if @text
+      @text.begin_frame
+    end
+  end
+
+  def paint_text(
+    text,
+    font,
+    href,
+    vref,
+    hoff,
+    voff,
+    density)
+
+    if @text
+      @text.paint(text, font, href, vref, hoff, voff, density)
+      return
+    end
+    text_width, text_height = font.size_text(text)
+    case href
+    when :left
+      hpos = hoff
+    when :right
+      hpos = (@width - text_width) - hoff
+    when :centre
+      hpos = (@width - text_width) / 2 + hoff
+    when :random
+      hpos = @random.rand(0..(@width - text_width)) + hoff
+    end
+    case vref
+    when :top
+      vpos = voff
+    when :bottom
+      vpos = (@height - text_height) - voff
+    when :middle
+      vpos = (@height - text_height) / 2 + voff
+    when :random
+      vpos = @random.rand(0..(@height - text_height)) + voff
+    end
+    surface = font.render_solid(text, [density, density, density])
+    texture = @renderer.create_texture_from(surface)
+    @renderer.copy(
+      texture,
+      nil,
+      SDL2::Rect.new(hpos, vpos, text_width, text_height)
+    )
+    texture.destroy
+    surface.destroy
+  end
+
+  def do_display
+    if @text
+      @text.end_frame
+    end
+    @renderer.present
+  end
+
+end
@@ -0,0 +1,302 @@
+/*
+ *  Pixel kernels.  See pixels.h.
+ */
+
+#define NEED_SDL
+#include "includes.h"
+
+#if !defined NO_SIMD
+#if defined __x86_64__ || defined __i386__
+#include <immintrin.h>
+#define HAVE_X86
+#elif defined __ARM_NEON
+#include <arm_neon.h>
+#define HAVE_NEON
+#endif
+#endif
+
+/*
+ *================================================================
+ *
+ *  Type definitions.
+ *
+ *================================================================
+ */
+
+typedef void (*t_expand_kernel)(
+    Uint32      *destination,
+    const Uint8 *source,
+    int          count,
+    Uint32       colour);
+
+/*
+ *================================================================
+ *
+ *  Forward declarations.
+ *
+ *================================================================
+ */
+
+static void choose_kernels(void);
+
+static t_expand_kernel find_kernel(const char *name);
+
+static void expand_scalar(
+    Uint32      *destination,
+    const Uint8 *source,
+    int          count,
+    Uint32       colour);
+
+#if defined HAVE_X86
+static void expand_sse2(
+    Uint32      *destination,
+    const Uint8 *source,
+    int          count,
+    Uint32       colour) __attribute__((target("sse2")));
+
+static void expand_avx2(
+    Uint32      *destination,
+    const Uint8 *source,
+    int          count,
+    Uint32       colour) __attribute__((target("avx2")));
+#endif
+
+#if defined HAVE_NEON
+static void expand_neon(
+    Uint32      *destination,
+    const Uint8 *source,
+    int          count,
+    Uint32       colour);
+#endif
+
+/*
+ *================================================================
+ *
+ *  Local data.
+ *
+ *================================================================
+ */
+
+static t_expand_kernel expand_kernel = NULL;
+static const char     *kernel_name = "scalar";
+
+static const char *kernel_names[] = {   /* Best first */
+  "AVX2",
+  "SSE2",
+  "NEON",
+  "scalar"
+};
+
+#define NUM_KERNEL_NAMES ((int) (sizeof(kernel_names) / sizeof(char *)))
+
+/*
+ *================================================================
+ *
+ *  Externally visible routines.
+ *
+ *================================================================
+ */
+
+const char *pixels_kernel_name(void) {
+  choose_kernels();
+  return kernel_name;
+}
+
+bool pixels_use_kernel(const char *name) {
+  /*
+   * Use the kernels of that name rather than the best ones - for tests
+   * and benchmarks.  FALSE if this machine can't run them.
+   */
+  t_expand_kernel expand = NULL;
+  int             i;
+
+  choose_kernels();
+  for (i = 0; i < NUM_KERNEL_NAMES; i++) {
+    if (strcmp(name, kernel_names[i]) == 0) {
+      expand = find_kernel(kernel_names[i]);
+      if (expand != NULL) {
+        expand_kernel = expand;
+        kernel_name = kernel_names[i];
+      }
+      break;
+    }
+  }
+  return (expand != NULL);
+}
+
+void pixels_expand(
+    Uint32      *destination,
+    const Uint8 *source,
+    int          count,
+    Uint32       colour) {
+
+  choose_kernels();
+  expand_kernel(destination, source, count, colour);
+}
+
+/*
+ *================================================================
+ *
+ *  Local routines.
+ *
+ *================================================================
+ */
+
+static void choose_kernels(void) {
+  /*
+   * The first this machine can run.  Racing threads all come to the
+   * same answer, so there's no need for a lock.
+   */
+  t_expand_kernel expand = NULL;
+  int             i;
+
+  if (expand_kernel == NULL) {
+    for (i = 0; expand == NULL; i++) {
+      expand = find_kernel(kernel_names[i]);
+    }
+    kernel_name = kernel_names[i - 1];
+    expand_kernel = expand;
+  }
+}
+
+
+static t_expand_kernel find_kernel(const char *name) {
+  /*
+   * NULL if there's no such kernel here, or the CPU can't run it.
+   */
+  t_expand_kernel result = NULL;
+
+  if (strcmp(name, "scalar") == 0) {
+    result = expand_scalar;
+  }
+#if defined HAVE_NEON
+  if (strcmp(name, "NEON") == 0) {
+    result = expand_neon;
+  }
+#endif
+#if defined HAVE_X86
+  __builtin_cpu_init();
+  if ((strcmp(name, "SSE2") == 0) && __builtin_cpu_supports("sse2")) {
+    result = expand_sse2;
+  }
+  if ((strcmp(name, "AVX2") == 0) && __builtin_cpu_supports("avx2")) {
+    result = expand_avx2;
+  }
+#endif
+  return result;
+}
+
+
+static void expand_scalar(
+    Uint32      *destination,
+    const Uint8 *source,
+    int          count,
+    Uint32       colour) {
+
+  int i;
+
+  for (i = 0; i < count; i++) {
+    destination[i] = (source[i] != 0) ? colour : 0;
+  }
+}
+
+#if defined HAVE_X86
+static void expand_sse2(
+    Uint32      *destination,
+    const Uint8 *source,
+    int          count,
+    Uint32       colour) {
+  /*
+   * Sixteen pixels at a time.  Comparing with zero gives 0xff for the
+   * background bytes; widening that to 32 bits by interleaving it with
+   * itself gives a mask to clear the colour with.
+   */
+  __m128i background;
+  __m128i fill;
+  int     i;
+  __m128i low;
+  __m128i high;
+  __m128i zero;
+
+  fill = _mm_set1_epi32((int) colour);
+  zero = _mm_setzero_si128();
+  for (i = 0; i + 16 <= count; i += 16) {
+    background =
+      _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) (source + i)), zero);
+    low = _mm_unpacklo_epi8(background, background);
+    high = _mm_unpackhi_epi8(background, background);
+    _mm_storeu_si128((__m128i *) (destination + i),
+                     _mm_andnot_si128(_mm_unpacklo_epi16(low, low), fill));
+    _mm_storeu_si128((__m128i *) (destination + i + 4),
+                     _mm_andnot_si128(_mm_unpackhi_epi16(low, low), fill));
+    _mm_storeu_si128((__m128i *) (destination + i + 8),
+                     _mm_andnot_si128(_mm_unpacklo_epi16(high, high), fill));
+    _mm_storeu_si128((__m128i *) (destination + i + 12),
+                     _mm_andnot_si128(_mm_unpackhi_epi16(high, high), fill));
+  }
+  expand_scalar(destination + i, source + i, count - i, colour);
+}
+
+
+static void expand_avx2(
+    Uint32      *destination,
+    const Uint8 *source,
+    int          count,
+    Uint32       colour) {
+  /*
+   * Eight pixels at a time, widened straight to 32 bits.
+   */
+  __m256i fill;
+  int     i;
+  __m256i wide;
+  __m256i zero;
+
+  fill = _mm256_set1_epi32((int) colour);
+  zero = _mm256_setzero_si256();
+  for (i = 0; i + 8 <= count; i += 8) {
+    wide = _mm256_cvtepu8_epi32(
+             _mm_loadl_epi64((const __m128i *) (source + i)));
+    _mm256_storeu_si256((__m256i *) (destination + i),
+                        _mm256_andnot_si256(_mm256_cmpeq_epi32(wide, zero),
+                                            fill));
+  }
+  expand_scalar(destination + i, source + i, count - i, colour);
+}
+#endif
+
+#if defined HAVE_NEON
+static void expand_neon(
+    Uint32      *destination,
+    const Uint8 *source,
+    int          count,
+    Uint32       colour) {
+  /*
+   * Sixteen pixels at a time - a byte mask of the glyph pixels,
+   * widened by zipping it with itself.
+   */
+  uint32x4_t   fill;
+  uint8x16_t   glyph;
+  uint16x8x2_t halves;
+  int          i;
+  uint8x16x2_t pairs;
+
+  fill = vdupq_n_u32(colour);
+  for (i = 0; i + 16 <= count; i += 16) {
+    glyph = vtstq_u8(vld1q_u8(source + i), vld1q_u8(source + i));
+    pairs = vzipq_u8(glyph, glyph);
+    halves = vzipq_u16(vreinterpretq_u16_u8(pairs.val[0]),
+                       vreinterpretq_u16_u8(pairs.val[0]));
+    vst1q_u32(destination + i,
+              vandq_u32(vreinterpretq_u32_u16(halves.val[0]), fill));
+    vst1q_u32(destination + i + 4,
+              vandq_u32(vreinterpretq_u32_u16(halves.val[1]), fill));
+    halves = vzipq_u16(vreinterpretq_u16_u8(pairs.val[1]),
+                       vreinterpretq_u16_u8(pairs.val[1]));
+    vst1q_u32(destination + i + 8,
+              vandq_u32(vreinterpretq_u32_u16(halves.val[0]), fill));
+    vst1q_u32(destination + i + 12,
+              vandq_u32(vreinterpretq_u32_u16(halves.val[1]), fill));
+  }
+  expand_scalar(destination + i, source + i, count - i, colour);
+}
+#endif
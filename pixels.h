@@ -0,0 +1,32 @@
+/*
+ *  Pixel kernels.  Each has a plain C version and, where the machine
+ *  has them, vector versions (SSE2 or AVX2 on x86, NEON on ARM).  The
+ *  best one available is picked at run time the first time it's
+ *  needed; all of them give exactly the same result.  Build with
+ *  EXTRA_CFLAGS=-DNO_SIMD for the plain versions only.
+ */
+
+/*
+ *================================================================
+ *
+ *  External declarations.
+ *
+ *================================================================
+ */
+
+extern const char *pixels_kernel_name(void);
+
+extern bool pixels_use_kernel(const char *name);
+
+#if defined NEED_SDL
+/*
+ *  Turn one row of an 8-bit TTF_RenderText_Solid() surface into
+ *  ARGB8888 - index 0 (the background) becomes transparent and
+ *  anything else becomes colour.
+ */
+extern void pixels_expand(
+    Uint32      *destination,
+    const Uint8 *source,
+    int          count,
+    Uint32       colour);
+#endif
@@ -0,0 +1,490 @@
+/*
+ *  Queued logging.  See qlog.h.
+ *
+ *  The ring is a bounded multi-producer queue in which each slot
+ *  carries a sequence number.  A producer claims a slot by bumping
+ *  the tail with a compare-and-swap, fills it in, then publishes it
+ *  by setting its sequence.  The single writer thread consumes slots
+ *  in order and hands each one back by advancing its sequence a
+ *  whole lap.  Nobody ever waits on a lock.
+ */
+
+#include "includes.h"
+
+/*
+ *================================================================
+ *
+ *  Constants.
+ *
+ *================================================================
+ */
+
+#define RING_SIZE     512           /* Must be a power of two */
+#define RING_MASK     (RING_SIZE - 1)
+#define MAX_ARGS      8
+#define STRING_SPACE  96            /* For copies of %s arguments */
+#define LINE_LENGTH   256
+#define SPEC_LENGTH   16
+
+/*
+ *================================================================
+ *
+ *  Type definitions.
+ *
+ *================================================================
+ */
+
+typedef enum {
+  a_literal,                  /* %% */
+  a_int,
+  a_long,
+  a_double,
+  a_string,
+  a_pointer,
+  a_invalid
+} t_arg_kind;
+
+typedef union {
+  int     i;
+  long    l;
+  double  d;
+  void   *p;
+  int     offset;             /* Into the slot's string space */
+} t_arg;
+
+typedef struct {
+  volatile unsigned long sequence;
+  int                    level;
+  struct timespec        when;
+  const char            *format;
+  t_arg                  args[MAX_ARGS];
+  char                   strings[STRING_SPACE];
+} t_slot;
+
+/*
+ *================================================================
+ *
+ *  Local data.
+ *
+ *================================================================
+ */
+
+static t_slot ring[RING_SIZE];
+
+static volatile unsigned long tail = 0;     /* Next slot to claim */
+static unsigned long          head = 0;     /* Next slot to write out */
+static volatile unsigned long dropped = 0;
+
+static bool          started = FALSE;
+static volatile bool stopping = FALSE;
+static pthread_t     writer;
+static sem_t         wakeup;
+
+static const char *level_names[] = {
+  "",
+  "ERROR",
+  "WARN ",
+  "INFO ",
+  "DEBUG"
+};
+
+/*
+ *================================================================
+ *
+ *  Forward declarations.
+ *
+ *================================================================
+ */
+
+static void post(int level, const char *format, va_list args);
+
+static void capture(
+    t_slot     *slot,
+    int         level,
+    const char *format,
+    va_list     args);
+
+static int parse_spec(const char *spec, t_arg_kind *kind);
+
+static void *writer_main(void *unused);
+
+static void drain(void);
+
+static void write_slot(t_slot *slot);
+
+/*
+ *================================================================
+ *
+ *  Externally visible routines.
+ *
+ *================================================================
+ */
+
+void qlog_init(void) {
+  unsigned long i;
+
+  if (!started) {
+    for (i = 0; i < RING_SIZE; i++) {
+      ring[i].sequence = i;
+    }
+    sem_init(&wakeup, 0, 0);
+    if (pthread_create(&writer, NULL, writer_main, NULL) != 0) {
+      LOG_Error("Failed to start log writer thread.\n");
+    } else {
+      started = TRUE;
+      atexit(qlog_shutdown);
+    }
+  }
+}
+
+void qlog_shutdown(void) {
+  /*
+   * Flush anything outstanding and stop the writer.
+   */
+  if (started) {
+    started = FALSE;
+    stopping = TRUE;
+    sem_post(&wakeup);
+    pthread_join(writer, NULL);
+  }
+}
+
+unsigned long qlog_dropped(void) {
+  return dropped;
+}
+
+void qlog_error(const char *format, ...) {
+  va_list args;
+
+  va_start(args, format);
+  post(QLOG_ERROR, format, args);
+  va_end(args);
+}
+
+void qlog_warning(const char *format, ...) {
+  va_list args;
+
+  va_start(args, format);
+  post(QLOG_WARNING, format, args);
+  va_end(args);
+}
+
+void qlog_info(const char *format, ...) {
+  va_list args;
+
+  va_start(args, format);
+  post(QLOG_INFO, format, args);
+  va_end(args);
+}
+
+void qlog_debug(const char *format, ...) {
+  va_list args;
+
+  va_start(args, format);
+  post(QLOG_DEBUG, format, args);
+  va_end(args);
+}
+
+/*
+ *================================================================
+ *
+ *  Local routines.
+ *
+ *================================================================
+ */
+
+static void post(int level, const char *format, va_list args) {
+  /*
+   * Runs on the caller's thread so must be quick and must never block.
+   * Until the writer is running, and once it has stopped, there's
+   * nobody to hand the message to so it's written out here instead.
+   */
+  long          difference;
+  t_slot        direct;
+  unsigned long position;
+  t_slot       *slot;
+
+  if (!started) {
+    capture(&direct, level, format, args);
+    write_slot(&direct);
+    return;
+  }
+  /*
+   * Claim a slot.
+   */
+  position = tail;
+  while (TRUE) {
+    slot = ring + (position & RING_MASK);
+    difference = (long) (slot->sequence - position);
+    if (difference == 0) {
+      if (__sync_bool_compare_and_swap(&tail, position, position + 1)) {
+        break;
+      }
+      position = tail;
+    } else if (difference < 0) {
+      /*
+       * Full.  The writer hasn't caught up with us.
+       */
+      __sync_fetch_and_add(&dropped, 1);
+      return;
+    } else {
+      position = tail;
+    }
+  }
+  capture(slot, level, format, args);
+  /*
+   * Publish it.
+   */
+  __sync_synchronize();
+  slot->sequence = position + 1;
+  sem_post(&wakeup);
+}
+
+
+static void capture(
+    t_slot     *slot,
+    int         level,
+    const char *format,
+    va_list     args) {
+  /*
+   * Copy the arguments into the slot.  Formatting is left to the
+   * writer.
+   */
+  int         arg = 0;
+  t_arg_kind  kind;
+  int         length;
+  const char *ptr;
+  const char *string;
+  int         used = 0;
+
+  clock_gettime(CLOCK_REALTIME, &slot->when);
+  slot->level = level;
+  slot->format = format;
+  for (ptr = format; (*ptr != '\0') && (arg < MAX_ARGS); ptr++) {
+    if (*ptr == '%') {
+      ptr += parse_spec(ptr, &kind) - 1;
+      switch (kind) {
+        case a_int:
+          slot->args[arg++].i = va_arg(args, int);
+          break;
+
+        case a_long:
+          slot->args[arg++].l = va_arg(args, long);
+          break;
+
+        case a_double:
+          slot->args[arg++].d = va_arg(args, double);
+          break;
+
+        case a_pointer:
+          slot->args[arg++].p = va_arg(args, void *);
+          break;
+
+        case a_string:
+          /*
+           * The last byte of the space is always an empty string
+           * to fall back on when we run out.
+           */
+          string = va_arg(args, const char *);
+          if (string == NULL) {
+            string = "(null)";
+          }
+          length = strlen(string);
+          if (length > (STRING_SPACE - 1) - used - 1) {
+            length = (STRING_SPACE - 1) - used - 1;
+          }
+          if (length < 0) {
+            slot->args[arg++].offset = STRING_SPACE - 1;
+          } else {
+            memcpy(slot->strings + used, string, length);
+            slot->strings[used + length] = '\0';
+            slot->args[arg++].offset = used;
+            used += length + 1;
+          }
+          break;
+
+        default:
+          break;
+
+      }
+    }
+  }
+  slot->strings[STRING_SPACE - 1] = '\0';
+}
+
+
+static int parse_spec(const char *spec, t_arg_kind *kind) {
+  /*
+   * Given a pointer to a '%', work out how long the conversion
+   * specification is and what sort of argument it takes.
+   */
+  bool        is_long = FALSE;
+  const char *ptr;
+
+  ptr = spec + 1;
+  while ((*ptr != '\0') && (strchr("-+ #0123456789.", *ptr) != NULL)) {
+    ptr++;
+  }
+  while ((*ptr == 'h') || (*ptr == 'l')) {
+    if (*ptr == 'l') {
+      is_long = TRUE;
+    }
+    ptr++;
+  }
+  switch (*ptr) {
+    case '%':
+      *kind = a_literal;
+      break;
+
+    case 'd':
+    case 'i':
+    case 'u':
+    case 'o':
+    case 'x':
+    case 'X':
+    case 'c':
+      *kind = is_long ? a_long : a_int;
+      break;
+
+    case 'e':
+    case 'E':
+    case 'f':
+    case 'g':
+    case 'G':
+      *kind = a_double;
+      break;
+
+    case 's':
+      *kind = a_string;
+      break;
+
+    case 'p':
+      *kind = a_pointer;
+      break;
+
+    default:
+      *kind = a_invalid;
+      break;
+
+  }
+  if (*ptr == '\0') {
+    return ptr - spec;
+  } else {
+    return (ptr - spec) + 1;
+  }
+}
+
+
+static void *writer_main(void *unused) {
+  unsigned long reported = 0;
+  unsigned long now_dropped;
+
+  while (!stopping) {
+    sem_wait(&wakeup);
+    drain();
+    now_dropped = dropped;
+    if (now_dropped != reported) {
+      fprintf(stderr, "Log ring overflowed - %lu messages dropped.\n",
+              now_dropped - reported);
+      reported = now_dropped;
+    }
+  }
+  drain();
+  return NULL;
+}
+
+
+static void drain(void) {
+  t_slot *slot;
+
+  while (TRUE) {
+    slot = ring + (head & RING_MASK);
+    if (slot->sequence != head + 1) {
+      break;
+    }
+    __sync_synchronize();
+    write_slot(slot);
+    slot->sequence = head + RING_SIZE;
+    head++;
+  }
+}
+
+
+static void write_slot(t_slot *slot) {
+  int         arg = 0;
+  t_arg_kind  kind;
+  int         length;
+  char        line[LINE_LENGTH];
+  const char *ptr;
+  char        spec[SPEC_LENGTH];
+  time_t      seconds;
+  struct tm   tm;
+  int         used;
+
+  seconds = slot->when.tv_sec;
+  localtime_r(&seconds, &tm);
+  used = strftime(line, LINE_LENGTH, "%H:%M:%S", &tm);
+  used += sprintf(line + used,
+                  ".%03ld %s ",
+                  slot->when.tv_nsec / 1000000,
+                  level_names[slot->level]);
+  ptr = slot->format;
+  while ((*ptr != '\0') && (used < LINE_LENGTH - 1)) {
+    if (*ptr != '%') {
+      line[used++] = *ptr++;
+    } else {
+      length = parse_spec(ptr, &kind);
+      if ((length >= SPEC_LENGTH) ||
+          (kind == a_invalid) ||
+          ((kind != a_literal) && (arg >= MAX_ARGS))) {
+        /*
+         * Can't do anything sensible with it so copy it as it is.
+         */
+        line[used++] = *ptr++;
+        continue;
+      }
+      memcpy(spec, ptr, length);
+      spec[length] = '\0';
+      ptr += length;
+      switch (kind) {
+        case a_literal:
+          length = snprintf(line + used, LINE_LENGTH - used, "%%");
+          break;
+
+        case a_int:
+          length = snprintf(line + used, LINE_LENGTH - used, spec,
+                            slot->args[arg++].i);
+          break;
+
+        case a_long:
+          length = snprintf(line + used, LINE_LENGTH - used, spec,
+                            slot->args[arg++].l);
+          break;
+
+        case a_double:
+          length = snprintf(line + used, LINE_LENGTH - used, spec,
+                            slot->args[arg++].d);
+          break;
+
+        case a_string:
+          length = snprintf(line + used, LINE_LENGTH - used, spec,
+                            slot->strings + slot->args[arg++].offset);
+          break;
+
+        default:
+          length = snprintf(line + used, LINE_LENGTH - used, spec,
+                            slot->args[arg++].p);
+          break;
+
+      }
+      if (length > 0) {
+        used += length;
+      }
+    }
+  }
+  if (used > LINE_LENGTH - 1) {
+    used = LINE_LENGTH - 1;
+  }
+  line[used] = '\0';
+  fputs(line, stderr);
+}
@@ -0,0 +1,88 @@
+/*
+ *  Queued logging for the render and alarm paths.
+ *
+ *  A call just captures the format and its arguments into a slot in a
+ *  fixed-size lock-free ring; a background thread does the formatting
+ *  and the actual I/O.  If the ring is full the message is dropped and
+ *  counted rather than waiting.
+ *
+ *  Levels below QLOG_LEVEL are compiled out entirely.  Since we're C89
+ *  the macros take their arguments in an extra set of brackets:
+ *
+ *    QLOG_Debug(("Repainted in %ld us\n", elapsed));
+ *
+ *  The format must be a literal - only the pointer is queued.  Supported
+ *  conversions are d, i, u, o, x, X, c (with h or l), e, f, g, s and p.
+ */
+
+/*
+ *================================================================
+ *
+ *  Constants.
+ *
+ *================================================================
+ */
+
+#define QLOG_NONE    0
+#define QLOG_ERROR   1
+#define QLOG_WARNING 2
+#define QLOG_INFO    3
+#define QLOG_DEBUG   4
+
+#if !defined QLOG_LEVEL
+#define QLOG_LEVEL QLOG_INFO
+#endif
+
+/*
+ *================================================================
+ *
+ *  Macros.
+ *
+ *================================================================
+ */
+
+#if QLOG_LEVEL >= QLOG_ERROR
+#define QLOG_Error(args)   qlog_error args
+#else
+#define QLOG_Error(args)   ((void) 0)
+#endif
+
+#if QLOG_LEVEL >= QLOG_WARNING
+#define QLOG_Warning(args) qlog_warning args
+#else
+#define QLOG_Warning(args) ((void) 0)
+#endif
+
+#if QLOG_LEVEL >= QLOG_INFO
+#define QLOG_Info(args)    qlog_info args
+#else
+#define QLOG_Info(args)    ((void) 0)
+#endif
+
+#if QLOG_LEVEL >= QLOG_DEBUG
+#define QLOG_Debug(args)   qlog_debug args
+#else
+#define QLOG_Debug(args)   ((void) 0)
+#endif
+
+/*
+ *================================================================
+ *
+ *  External declarations.
+ *
+ *================================================================
+ */
+
+extern void qlog_init(void);
+
+extern void qlog_shutdown(void);
+
+extern unsigned long qlog_dropped(void);
+
+extern void qlog_error(const char *format, ...);
+
+extern void qlog_warning(const char *format, ...);
+
+extern void qlog_info(const char *format, ...);
+
+extern void qlog_debug(const char *format, ...);
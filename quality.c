@@ -0,0 +1,148 @@
+/*
+ *  Render-quality governor.  See quality.h.
+ *
+ *  Time is measured with the thread's CPU clock, so that waiting for
+ *  the display to take a frame doesn't count against the budget.
+ */
+
+#include "includes.h"
+
+/*
+ *================================================================
+ *
+ *  Constants.
+ *
+ *================================================================
+ */
+
+#define LOAD_FRAMES 8                 /* Averaged over, roughly */
+
+/*
+ *================================================================
+ *
+ *  Local data.
+ *
+ *================================================================
+ */
+
+static t_metric    solid_metric = NO_METRIC;
+static t_metric    blended_metric = NO_METRIC;
+static t_metric    over_budget_metric = NO_METRIC;
+static t_histogram frame_histogram = NO_HISTOGRAM;
+
+static bool            in_pass = FALSE;
+static bool            moving;
+static struct timespec pass_began;
+static long            step_began;       /* -1 before the first step */
+static long            average_us = 0;   /* CPU per painted frame */
+
+/*
+ *================================================================
+ *
+ *  Forward declarations.
+ *
+ *================================================================
+ */
+
+static long budget_us(void);
+
+static long used_us(void);
+
+/*
+ *================================================================
+ *
+ *  Externally visible routines.
+ *
+ *================================================================
+ */
+
+void quality_init(void) {
+  solid_metric = metric_register("text drawn solid");
+  blended_metric = metric_register("text drawn blended");
+  over_budget_metric = metric_register("passes over render budget");
+  frame_histogram = histogram_register("frame cpu us");
+}
+
+void quality_pass_begin(bool animating) {
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &pass_began);
+  moving = animating;
+  step_began = -1;
+  in_pass = TRUE;
+}
+
+t_render_quality quality_choose(void) {
+  /*
+   * Blended if nothing's moving, recent frames have kept within the
+   * budget and this pass still has some of it left.
+   */
+  t_render_quality result = rq_solid;
+
+  if (in_pass &&
+      !moving &&
+      (budget_us() > 0) &&
+      (average_us <= budget_us()) &&
+      (used_us() < budget_us())) {
+    result = rq_blended;
+  }
+  return result;
+}
+
+bool quality_spare(void) {
+  /*
+   * For optional work done in steps - is there room in this pass for
+   * another, going by how long the last one took?
+   */
+  long now;
+  long step = 0;
+
+  now = used_us();
+  if (step_began >= 0) {
+    step = now - step_began;
+  }
+  step_began = now;
+  return (quality_choose() == rq_blended) && (now + step < budget_us());
+}
+
+void quality_used(t_render_quality quality) {
+  metric_add((quality == rq_blended) ? blended_metric : solid_metric, 1);
+}
+
+void quality_pass_end(bool painted) {
+  long used;
+
+  if (in_pass) {
+    in_pass = FALSE;
+    used = used_us();
+    if (painted) {
+      histogram_add(frame_histogram, used);
+      average_us += (used - average_us) / LOAD_FRAMES;
+    }
+    if ((budget_us() > 0) && (used > budget_us())) {
+      metric_add(over_budget_metric, 1);
+      QLOG_Debug(("Pass took %ld us of CPU - budget is %d ms.\n",
+                  used,
+                  get_render_budget()));
+    }
+  }
+}
+
+/*
+ *================================================================
+ *
+ *  Local routines.
+ *
+ *================================================================
+ */
+
+static long budget_us(void) {
+  return get_render_budget() * 1000L;
+}
+
+
+static long used_us(void) {
+  struct timespec now;
+
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+  return ((now.tv_sec - pass_began.tv_sec) * 1000000L) +
+         ((now.tv_nsec - pass_began.tv_nsec) / 1000L);
+}
@@ -0,0 +1,46 @@
+/*
+ *  Render-quality governor.  Text can be drawn Solid - cheap to render
+ *  but jagged at large sizes - or Blended, which is anti-aliased but
+ *  costs several times as much.  Each pass of the main loop (a frame,
+ *  if anything is painted) is timed in CPU, and while passes are coming
+ *  in under the render_budget setting and nothing is animating, each
+ *  piece of text as it's drawn may use Blended.  Otherwise, or once the
+ *  pass has spent its budget, it's Solid.  Work which makes Blended
+ *  text possible can be fitted into what's left - see fonts.c.
+ *
+ *  What each piece of text was drawn with, CPU per frame and passes
+ *  over budget all go into the metrics.
+ */
+
+/*
+ *================================================================
+ *
+ *  Type definitions.
+ *
+ *================================================================
+ */
+
+typedef enum {
+  rq_solid,
+  rq_blended
+} t_render_quality;
+
+/*
+ *================================================================
+ *
+ *  External declarations.
+ *
+ *================================================================
+ */
+
+extern void quality_init(void);
+
+extern void quality_pass_begin(bool animating);
+
+extern t_render_quality quality_choose(void);
+
+extern bool quality_spare(void);
+
+extern void quality_used(t_render_quality quality);
+
+extern void quality_pass_end(bool painted);
@@ -0,0 +1,680 @@
+/*
+ *  Recurrence rules.  See recurrence.h.
+ */
+
+#include "includes.h"
+
+/*
+ *================================================================
+ *
+ *  Constants.
+ *
+ *================================================================
+ */
+
+#define MAX_RULE_DATES (MAX_ALARMS + 4096)   /* Imports are often one-offs */
+#define MAX_SKIP_YEARS 256
+#define BITS_PER_WORD  32
+#define WORDS_PER_YEAR ((366 + BITS_PER_WORD - 1) / BITS_PER_WORD)
+
+/*
+ *  However long a run of skipped days we'll search through before
+ *  giving up on an alarm.
+ */
+#define MAX_SKIP_RUN   1000
+
+/*
+ *================================================================
+ *
+ *  Type definitions.
+ *
+ *================================================================
+ */
+
+typedef struct {
+  int           year;
+  unsigned long bits[WORDS_PER_YEAR];   /* Bit n is day n of the year */
+} t_skip_year;
+
+/*
+ *================================================================
+ *
+ *  Local data.
+ *
+ *================================================================
+ */
+
+/*
+ *  Rules refer to slices of these two pools.  Each slice is built in
+ *  one go while its alarm is being read, so slices never interleave,
+ *  and a removed alarm's slices are closed up so that the pools stay
+ *  packed.
+ */
+static int         rule_dates[MAX_RULE_DATES];
+static int         num_rule_dates = 0;
+static t_skip_year skip_years[MAX_SKIP_YEARS];
+static int         num_skip_years = 0;
+
+static t_slice     holidays = {0, 0};
+
+static const char *ordinals[] = {
+  "1st",
+  "2nd",
+  "3rd",
+  "4th",
+  "5th"
+};
+
+/*
+ *================================================================
+ *
+ *  Forward declarations.
+ *
+ *================================================================
+ */
+
+static int parse_date(const char *text);
+
+static void civil_date(int day, int *year, int *month, int *mday);
+
+static int weekday_of(int day);
+
+static bool add_to_skips(t_slice *slice, const char *text);
+
+static bool in_skips(const t_slice *slice, int day);
+
+static bool skipped(const t_recurrence *rule, int day);
+
+static int occurrence_from(
+    const t_recurrence *rule,
+    const bool         *days,
+    int                 day);
+
+static int weekly_from(
+    const t_recurrence *rule,
+    const bool         *days,
+    int                 day);
+
+static int dated_from(const t_recurrence *rule, int day);
+
+static int monthly_from(const t_recurrence *rule, int day);
+
+static int nth_weekday(int year, int month, int nth, int weekday);
+
+static int compare_ints(const void *first, const void *second);
+
+static void relocate_slice(t_slice *slice, const t_slice *released);
+
+/*
+ *================================================================
+ *
+ *  Externally visible routines.
+ *
+ *================================================================
+ */
+
+void recurrence_init(t_recurrence *rule) {
+  memset(rule, 0, sizeof(t_recurrence));
+  rule->kind     = rk_weekly;
+  rule->interval = 1;
+}
+
+bool recurrence_set_interval(t_recurrence *rule, const char *text) {
+  /*
+   * Weeks are counted from the week holding start_day (a Sunday to
+   * Saturday week) or from 1970 if no start is given.
+   */
+  bool result = FALSE;
+  int  weeks;
+
+  weeks = integer(text);
+  if (weeks > 0) {
+    rule->interval = weeks;
+    result = TRUE;
+  }
+  return result;
+}
+
+bool recurrence_set_start(t_recurrence *rule, const char *text) {
+  bool result = FALSE;
+  int  day;
+
+  day = parse_date(text);
+  if (day != NO_DAY) {
+    rule->start_day = day;
+    result = TRUE;
+  }
+  return result;
+}
+
+bool recurrence_set_monthly(t_recurrence *rule, const char *text) {
+  /*
+   * e.g. "2nd Tuesday" or "last Friday".
+   */
+  int         i;
+  const char *name;
+  int         nth = 0;
+  bool        result = FALSE;
+
+  name = strchr(text, ' ');
+  if (name != NULL) {
+    if (strncmp(text, "last ", 5) == 0) {
+      nth = -1;
+    } else {
+      for (i = 0; i < 5; i++) {
+        if (strncmp(text, ordinals[i], 3) == 0) {
+          nth = i + 1;
+          break;
+        }
+      }
+    }
+    rule->weekday = identify_alarm_day((yaml_char_t *) name + 1);
+    if ((nth != 0) && (rule->weekday != -1)) {
+      rule->kind = rk_monthly;
+      rule->nth = nth;
+      result = TRUE;
+    }
+  }
+  return result;
+}
+
+bool recurrence_add_date(t_recurrence *rule, const char *text) {
+  bool result = FALSE;
+  int  day;
+
+  day = parse_date(text);
+  if (day == NO_DAY) {
+    LOG_Error("Can't make sense of date \"%s\".\n", text);
+  } else if (num_rule_dates >= MAX_RULE_DATES) {
+    LOG_Error("Too many alarm dates - limit is %d.\n", MAX_RULE_DATES);
+  } else {
+    if (rule->dates.count == 0) {
+      rule->dates.first = num_rule_dates;
+    }
+    rule_dates[num_rule_dates++] = day;
+    rule->dates.count++;
+    rule->kind = rk_dates;
+    result = TRUE;
+  }
+  return result;
+}
+
+bool recurrence_add_skip(t_recurrence *rule, const char *text) {
+  return add_to_skips(&rule->skips, text);
+}
+
+bool add_holiday(const char *text) {
+  return add_to_skips(&holidays, text);
+}
+
+void recurrence_compile(t_recurrence *rule) {
+  /*
+   * Sort the dates so that they can be searched.  Skip years are kept
+   * in order as they're added.
+   */
+  qsort(rule_dates + rule->dates.first,
+        rule->dates.count,
+        sizeof(int),
+        compare_ints);
+}
+
+bool recurrence_release(const t_recurrence *rule) {
+  /*
+   * Give the rule's dates and skip years back to their pools.  What
+   * came after them moves down, so if anything did (the result) every
+   * rule still in use must then be put through recurrence_relocate().
+   */
+  const t_slice *dates;
+  bool           result = FALSE;
+  const t_slice *skips;
+
+  dates = &rule->dates;
+  if (dates->count > 0) {
+    result = (dates->first + dates->count < num_rule_dates);
+    memmove(rule_dates + dates->first,
+            rule_dates + dates->first + dates->count,
+            (num_rule_dates - dates->first - dates->count) * sizeof(int));
+    num_rule_dates -= dates->count;
+  }
+  skips = &rule->skips;
+  if (skips->count > 0) {
+    result = result || (skips->first + skips->count < num_skip_years);
+    memmove(skip_years + skips->first,
+            skip_years + skips->first + skips->count,
+            (num_skip_years - skips->first - skips->count) *
+              sizeof(t_skip_year));
+    num_skip_years -= skips->count;
+    relocate_slice(&holidays, skips);
+  }
+  return result;
+}
+
+void recurrence_relocate(t_recurrence *rule, const t_recurrence *released) {
+  relocate_slice(&rule->dates, &released->dates);
+  relocate_slice(&rule->skips, &released->skips);
+}
+
+unsigned long recurrence_hash(
+    const t_recurrence *rule,
+    unsigned long       hash) {
+  /*
+   * Fold everything which decides the rule's days, its dates and skips
+   * included, into a hash_fold() hash.  Where its slices sit in the
+   * pools doesn't matter.
+   */
+  int i;
+  int word;
+
+  hash = hash_fold(hash, rule->kind);
+  hash = hash_fold(hash, rule->interval);
+  hash = hash_fold(hash, rule->start_day);
+  hash = hash_fold(hash, rule->nth);
+  hash = hash_fold(hash, rule->weekday);
+  hash = hash_fold(hash, rule->skip_holidays);
+  for (i = 0; i < rule->dates.count; i++) {
+    hash = hash_fold(hash, rule_dates[rule->dates.first + i]);
+  }
+  for (i = 0; i < rule->skips.count; i++) {
+    hash = hash_fold(hash, skip_years[rule->skips.first + i].year);
+    for (word = 0; word < WORDS_PER_YEAR; word++) {
+      hash = hash_fold(hash, skip_years[rule->skips.first + i].bits[word]);
+    }
+  }
+  return hash;
+}
+
+int recurrence_next_day(
+    const t_recurrence *rule,
+    const bool         *days,
+    int                 from_day) {
+  /*
+   * The first day on or after from_day when the rule says to go off,
+   * or NO_DAY if it never will again.
+   */
+  int day;
+  int run;
+
+  day = occurrence_from(rule, days, from_day);
+  for (run = 0; (day != NO_DAY) && skipped(rule, day); run++) {
+    if (run == MAX_SKIP_RUN) {
+      day = NO_DAY;
+    } else {
+      day = occurrence_from(rule, days, day + 1);
+    }
+  }
+  return day;
+}
+
+int day_number(int year, int month, int mday) {
+  /*
+   * Days since 1st January 1970 for a date in the proleptic Gregorian
+   * calendar.  Months are 1 to 12.
+   */
+  int day_of_era;
+  int day_of_year;
+  int era;
+  int year_of_era;
+
+  if (month <= 2) {
+    year--;
+  }
+  era = ((year >= 0) ? year : year - 399) / 400;
+  year_of_era = year - (era * 400);
+  day_of_year = ((153 * (month + ((month > 2) ? -3 : 9)) + 2) / 5) + mday - 1;
+  day_of_era = (year_of_era * 365) + (year_of_era / 4) - (year_of_era / 100) +
+               day_of_year;
+  return (era * 146097) + day_of_era - 719468;
+}
+
+void dump_recurrence(const t_recurrence *rule) {
+  int i;
+  int mday;
+  int month;
+  int year;
+
+  switch (rule->kind) {
+    case rk_weekly:
+      if (rule->interval != 1) {
+        QLOG_Debug(("  Every %d weeks\n", rule->interval));
+      }
+      break;
+
+    case rk_dates:
+      for (i = 0; i < rule->dates.count; i++) {
+        civil_date(rule_dates[rule->dates.first + i], &year, &month, &mday);
+        QLOG_Debug(("  On %04d-%02d-%02d\n", year, month, mday));
+      }
+      break;
+
+    case rk_monthly:
+      QLOG_Debug(("  On the %d %d of each month\n", rule->nth, rule->weekday));
+      break;
+
+  }
+  if (rule->skips.count > 0) {
+    QLOG_Debug(("  Skipping dates in %d years\n", rule->skips.count));
+  }
+  if (rule->skip_holidays) {
+    QLOG_Debug(("  Skipping holidays\n"));
+  }
+}
+
+/*
+ *================================================================
+ *
+ *  Local routines.
+ *
+ *================================================================
+ */
+
+static int parse_date(const char *text) {
+  /*
+   * YYYY-MM-DD
+   */
+  int mday;
+  int month;
+  int result = NO_DAY;
+  int year;
+
+  if ((sscanf(text, "%d-%d-%d", &year, &month, &mday) == 3) &&
+      (month >= 1) && (month <= 12) &&
+      (mday >= 1) && (mday <= 31)) {
+    result = day_number(year, month, mday);
+  }
+  return result;
+}
+
+
+static void civil_date(int day, int *year, int *month, int *mday) {
+  /*
+   * The reverse of day_number().
+   */
+  int day_of_era;
+  int day_of_year;
+  int era;
+  int month_index;
+  int year_of_era;
+
+  day += 719468;
+  era = ((day >= 0) ? day : day - 146096) / 146097;
+  day_of_era = day - (era * 146097);
+  year_of_era = (day_of_era - (day_of_era / 1460) + (day_of_era / 36524) -
+                 (day_of_era / 146096)) / 365;
+  day_of_year = day_of_era - ((365 * year_of_era) + (year_of_era / 4) -
+                              (year_of_era / 100));
+  month_index = ((5 * day_of_year) + 2) / 153;
+  *mday = day_of_year - (((153 * month_index) + 2) / 5) + 1;
+  *month = month_index + ((month_index < 10) ? 3 : -9);
+  *year = year_of_era + (era * 400) + ((*month <= 2) ? 1 : 0);
+}
+
+
+static int weekday_of(int day) {
+  /*
+   * 1st January 1970 was a Thursday.
+   */
+  return ((day % 7) + 11) % 7;
+}
+
+
+static bool add_to_skips(t_slice *slice, const char *text) {
+  int          day;
+  int          i;
+  int          mday;
+  int          month;
+  bool         result = FALSE;
+  t_skip_year *entry = NULL;
+  int          year;
+  int          yday;
+
+  day = parse_date(text);
+  if (day == NO_DAY) {
+    LOG_Error("Can't make sense of date \"%s\".\n", text);
+  } else {
+    civil_date(day, &year, &month, &mday);
+    for (i = 0; i < slice->count; i++) {
+      if (skip_years[slice->first + i].year == year) {
+        entry = skip_years + slice->first + i;
+        break;
+      }
+    }
+    if (entry == NULL) {
+      if (num_skip_years >= MAX_SKIP_YEARS) {
+        LOG_Error("Too many years of skip dates - limit is %d.\n",
+                  MAX_SKIP_YEARS);
+      } else if ((slice->count > 0) &&
+                 (slice->first + slice->count != num_skip_years)) {
+        LOG_Error("Skip dates for \"%s\" must be given together.\n", text);
+      } else {
+        /*
+         * Keep the slice in year order as it's built.  It's always the
+         * last thing in the pool so there's room to shuffle up.
+         */
+        if (slice->count == 0) {
+          slice->first = num_skip_years;
+        }
+        for (i = slice->first + slice->count;
+             (i > slice->first) && (skip_years[i - 1].year > year);
+             i--) {
+          skip_years[i] = skip_years[i - 1];
+        }
+        num_skip_years++;
+        entry = skip_years + i;
+        memset(entry, 0, sizeof(t_skip_year));
+        entry->year = year;
+        slice->count++;
+      }
+    }
+    if (entry != NULL) {
+      yday = day - day_number(year, 1, 1);
+      entry->bits[yday / BITS_PER_WORD] |= 1UL << (yday % BITS_PER_WORD);
+      result = TRUE;
+    }
+  }
+  return result;
+}
+
+
+static bool in_skips(const t_slice *slice, int day) {
+  /*
+   * Binary search for the year, then one bit.
+   */
+  const t_skip_year *entry;
+  int                high;
+  int                low;
+  int                mday;
+  int                middle;
+  int                month;
+  bool               result = FALSE;
+  int                year;
+  int                yday;
+
+  if (slice->count > 0) {
+    civil_date(day, &year, &month, &mday);
+    low = slice->first;
+    high = slice->first + slice->count - 1;
+    while (low <= high) {
+      middle = (low + high) / 2;
+      entry = skip_years + middle;
+      if (entry->year < year) {
+        low = middle + 1;
+      } else if (entry->year > year) {
+        high = middle - 1;
+      } else {
+        yday = day - day_number(year, 1, 1);
+        result = (entry->bits[yday / BITS_PER_WORD] &
+                  (1UL << (yday % BITS_PER_WORD))) != 0;
+        break;
+      }
+    }
+  }
+  return result;
+}
+
+
+static bool skipped(const t_recurrence *rule, int day) {
+  return in_skips(&rule->skips, day) ||
+         (rule->skip_holidays && in_skips(&holidays, day));
+}
+
+
+static int occurrence_from(
+    const t_recurrence *rule,
+    const bool         *days,
+    int                 day) {
+  /*
+   * The first day on or after this one which the rule allows, before
+   * considering skips.
+   */
+  int result = NO_DAY;
+
+  if (day < rule->start_day) {
+    day = rule->start_day;
+  }
+  switch (rule->kind) {
+    case rk_weekly:
+      result = weekly_from(rule, days, day);
+      break;
+
+    case rk_dates:
+      result = dated_from(rule, day);
+      break;
+
+    case rk_monthly:
+      result = monthly_from(rule, day);
+      break;
+
+  }
+  return result;
+}
+
+
+static int weekly_from(
+    const t_recurrence *rule,
+    const bool         *days,
+    int                 day) {
+  /*
+   * Weeks run Sunday to Saturday and are numbered so that week 0 ends
+   * on Saturday 3rd January 1970.  Finish off the current week if it's
+   * one of ours, then jump straight to the next week which is.
+   */
+  int anchor;
+  int behind;
+  int i;
+  int result = NO_DAY;
+  int week;
+
+  anchor = (rule->start_day + 4) / 7;
+  week = (day + 4) / 7;
+  behind = (week - anchor) % rule->interval;
+  if (behind < 0) {
+    behind += rule->interval;
+  }
+  if (behind == 0) {
+    for (i = weekday_of(day); i < 7; i++) {
+      if (days[i]) {
+        result = (week * 7) - 4 + i;
+        break;
+      }
+    }
+  }
+  if (result == NO_DAY) {
+    week += rule->interval - behind;
+    for (i = 0; i < 7; i++) {
+      if (days[i]) {
+        result = (week * 7) - 4 + i;
+        break;
+      }
+    }
+  }
+  return result;
+}
+
+
+static int dated_from(const t_recurrence *rule, int day) {
+  /*
+   * Binary search for the first listed date on or after this one.
+   */
+  int high;
+  int low;
+  int middle;
+  int result = NO_DAY;
+
+  low = rule->dates.first;
+  high = rule->dates.first + rule->dates.count;
+  while (low < high) {
+    middle = (low + high) / 2;
+    if (rule_dates[middle] < day) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  if (low < rule->dates.first + rule->dates.count) {
+    result = rule_dates[low];
+  }
+  return result;
+}
+
+
+static int monthly_from(const t_recurrence *rule, int day) {
+  /*
+   * Try this month, then following ones.  A 5th weekday is missing
+   * from most months but there's always one within the year.
+   */
+  int candidate;
+  int i;
+  int mday;
+  int month;
+  int result = NO_DAY;
+  int year;
+
+  civil_date(day, &year, &month, &mday);
+  for (i = 0; i < 13; i++) {
+    candidate = nth_weekday(year, month, rule->nth, rule->weekday);
+    if ((candidate != NO_DAY) && (candidate >= day)) {
+      result = candidate;
+      break;
+    }
+    if (++month > 12) {
+      month = 1;
+      year++;
+    }
+  }
+  return result;
+}
+
+
+static int nth_weekday(int year, int month, int nth, int weekday) {
+  int first;
+  int next_first;
+  int result;
+
+  first = day_number(year, month, 1);
+  next_first = (month == 12) ? day_number(year + 1, 1, 1)
+                             : day_number(year, month + 1, 1);
+  if (nth > 0) {
+    result = first + ((weekday - weekday_of(first) + 7) % 7) + ((nth - 1) * 7);
+    if (result >= next_first) {
+      result = NO_DAY;
+    }
+  } else {
+    result = (next_first - 1) -
+             ((weekday_of(next_first - 1) - weekday + 7) % 7);
+  }
+  return result;
+}
+
+
+static int compare_ints(const void *first, const void *second) {
+  return *(const int *) first - *(const int *) second;
+}
+
+
+static void relocate_slice(t_slice *slice, const t_slice *released) {
+  if ((slice->count > 0) &&
+      (released->count > 0) &&
+      (slice->first > released->first)) {
+    slice->first -= released->count;
+  }
+}
@@ -0,0 +1,93 @@
+/*
+ *  Recurrence rules for alarms.  Beyond the plain "these days of the
+ *  week" an alarm can go off every N weeks, on a list of dates, or on
+ *  the Nth (or last) given weekday of each month, and can skip listed
+ *  dates and/or the shared holiday calendar.
+ *
+ *  Everything works in day numbers - days since 1st January 1970 in
+ *  the local calendar - so finding the next occurrence is arithmetic
+ *  rather than a day-by-day search.
+ */
+
+/*
+ *================================================================
+ *
+ *  Constants.
+ *
+ *================================================================
+ */
+
+#define NO_DAY -1
+
+/*
+ *================================================================
+ *
+ *  Type definitions.
+ *
+ *================================================================
+ */
+
+typedef enum {
+  rk_weekly,                  /* On the alarm's days, every N weeks */
+  rk_dates,                   /* On listed dates only */
+  rk_monthly                  /* Nth weekday of each month */
+} t_recurrence_kind;
+
+typedef struct {
+  int first;
+  int count;
+} t_slice;                    /* Part of one of the shared pools */
+
+typedef struct {
+  t_recurrence_kind kind;
+  int               interval;       /* rk_weekly - in weeks */
+  int               start_day;      /* Nothing before this day */
+  int               nth;            /* rk_monthly - 1 to 5, or -1 for last */
+  int               weekday;        /* rk_monthly - 0 = Sunday */
+  t_slice           dates;          /* rk_dates - sorted day numbers */
+  t_slice           skips;          /* Per-year bitsets of days to skip */
+  bool              skip_holidays;
+} t_recurrence;
+
+/*
+ *================================================================
+ *
+ *  External declarations.
+ *
+ *================================================================
+ */
+
+extern void recurrence_init(t_recurrence *rule);
+
+extern bool recurrence_set_interval(t_recurrence *rule, const char *text);
+
+extern bool recurrence_set_start(t_recurrence *rule, const char *text);
+
+extern bool recurrence_set_monthly(t_recurrence *rule, const char *text);
+
+extern bool recurrence_add_date(t_recurrence *rule, const char *text);
+
+extern bool recurrence_add_skip(t_recurrence *rule, const char *text);
+
+extern bool add_holiday(const char *text);
+
+extern void recurrence_compile(t_recurrence *rule);
+
+extern bool recurrence_release(const t_recurrence *rule);
+
+extern void recurrence_relocate(
+    t_recurrence       *rule,
+    const t_recurrence *released);
+
+extern unsigned long recurrence_hash(
+    const t_recurrence *rule,
+    unsigned long       hash);
+
+extern int recurrence_next_day(
+    const t_recurrence *rule,
+    const bool         *days,
+    int                 from_day);
+
+extern int day_number(int year, int month, int mday);
+
+extern void dump_recurrence(const t_recurrence *rule);
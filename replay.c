@@ -0,0 +1,360 @@
+/*
+ *  Event recording and replay.  See replay.h.
+ *
+ *  A log is LOG_MAGIC followed by one t_event_header and then that
+ *  many bytes of the SDL_Event for each event.  Like the atlas cache
+ *  it's only meant to be read back by the same build, so the event is
+ *  stored as it is in memory.
+ */
+
+#define NEED_SDL
+#include "includes.h"
+
+/*
+ *================================================================
+ *
+ *  Constants.
+ *
+ *================================================================
+ */
+
+#define LOG_MAGIC     "ACEVLOG1"
+#define LOG_MAGIC_LEN 8
+#define RECORD_BUFFER 8192
+
+/*
+ *================================================================
+ *
+ *  Type definitions.
+ *
+ *================================================================
+ */
+
+typedef struct {
+  Uint32 ticks;               /* The event's SDL timestamp */
+  Uint32 length;              /* Bytes of event following */
+  long   seconds;             /* Virtual time it was taken */
+  long   nanoseconds;
+} t_event_header;
+
+/*
+ *================================================================
+ *
+ *  Local data.
+ *
+ *================================================================
+ */
+
+static FILE *record_file = NULL;
+static char  record_buffer[RECORD_BUFFER];
+
+static bool            active = FALSE;
+static bool            fast = FALSE;
+static unsigned char  *log_map = NULL;
+static size_t          log_length;
+static size_t          log_offset;
+static bool            have_next = FALSE;
+static t_event_header  next_header;
+static SDL_Event       next_event;
+static Uint32          first_ticks;
+static struct timespec virtual_began;   /* On the virtual monotonic clock */
+static struct timespec real_began;
+static long            events_replayed = 0;
+static long            shown_minutes[MAX_DISPLAYS];  /* time_t / 60 */
+
+/*
+ *================================================================
+ *
+ *  Forward declarations.
+ *
+ *================================================================
+ */
+
+static int event_length(const SDL_Event *event);
+
+static void read_next(void);
+
+static long due_in(void);
+
+static void pass_time(long ms);
+
+static int take(SDL_Event *event);
+
+static long ms_between(
+    const struct timespec *from,
+    const struct timespec *to);
+
+/*
+ *================================================================
+ *
+ *  Externally visible routines.
+ *
+ *================================================================
+ */
+
+bool record_start(const char *file_name) {
+  /*
+   * The file's given a buffer of our own so that stdio doesn't
+   * allocate one on the first event.
+   */
+  bool result = FALSE;
+
+  record_file = fopen(file_name, "wb");
+  if (record_file == NULL) {
+    LOG_Error("Failed to create event log \"%s\".\n", file_name);
+  } else {
+    setvbuf(record_file, record_buffer, _IOFBF, sizeof(record_buffer));
+    fwrite(LOG_MAGIC, LOG_MAGIC_LEN, 1, record_file);
+    result = TRUE;
+  }
+  return result;
+}
+
+void record_stop(void) {
+  if (record_file != NULL) {
+    fclose(record_file);
+    record_file = NULL;
+  }
+}
+
+void record_event(const SDL_Event *event) {
+  t_event_header  header;
+  struct timespec now;
+
+  if ((record_file != NULL) && (event->type < SDL_USEREVENT)) {
+    vclock_gettime(&now);
+    header.ticks = event->common.timestamp;
+    header.length = event_length(event);
+    header.seconds = now.tv_sec;
+    header.nanoseconds = now.tv_nsec;
+    if ((fwrite(&header, sizeof(header), 1, record_file) != 1) ||
+        (fwrite(event, header.length, 1, record_file) != 1)) {
+      QLOG_Error(("Failed to write to event log.\n"));
+      fclose(record_file);
+      record_file = NULL;
+    }
+  }
+}
+
+bool replay_start(const char *file_name, bool fast_as_possible) {
+  /*
+   * Sets the virtual clock to the time of the first event.
+   */
+  int             fd;
+  bool            result = FALSE;
+  struct stat     status;
+  struct timespec started;
+
+  fd = open(file_name, O_RDONLY);
+  if ((fd >= 0) && (fstat(fd, &status) == 0) &&
+      (status.st_size >= LOG_MAGIC_LEN)) {
+    log_length = status.st_size;
+    log_map = mmap(NULL, log_length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (log_map == MAP_FAILED) {
+      log_map = NULL;
+    }
+  }
+  if (fd >= 0) {
+    close(fd);
+  }
+  if ((log_map == NULL) ||
+      (memcmp(log_map, LOG_MAGIC, LOG_MAGIC_LEN) != 0)) {
+    LOG_Error("\"%s\" isn't an event log.\n", file_name);
+  } else {
+    log_offset = LOG_MAGIC_LEN;
+    read_next();
+    if (have_next) {
+      started.tv_sec = next_header.seconds;
+      started.tv_nsec = next_header.nanoseconds;
+      vclock_settime(&started);
+      first_ticks = next_header.ticks;
+    }
+    vclock_monotonic(&virtual_began);
+    clock_gettime(CLOCK_MONOTONIC, &real_began);
+    fast = fast_as_possible;
+    active = TRUE;
+    result = TRUE;
+    LOG_Info("Replaying \"%s\"%s.\n", file_name, fast ? " fast" : "");
+  }
+  return result;
+}
+
+bool replaying(void) {
+  return active;
+}
+
+bool replay_finished(void) {
+  return active && !have_next;
+}
+
+int replay_wait(SDL_Event *event, int timeout) {
+  /*
+   * Like SDL_WaitEventTimeout().
+   */
+  long wait;
+  int  result = 0;
+
+  wait = have_next ? due_in() : timeout + 1;
+  if (wait <= timeout) {
+    pass_time(wait);
+    result = take(event);
+  } else {
+    pass_time(timeout);
+  }
+  return result;
+}
+
+int replay_poll(SDL_Event *event) {
+  /*
+   * Like SDL_PollEvent().
+   */
+  int result = 0;
+
+  if (have_next && (due_in() <= 0)) {
+    result = take(event);
+  }
+  return result;
+}
+
+void replay_report(void) {
+  struct timespec now;
+  struct timespec real_now;
+
+  if (active) {
+    vclock_monotonic(&now);
+    clock_gettime(CLOCK_MONOTONIC, &real_now);
+    LOG_Info("Replayed %ld events covering %ld ms in %ld ms.\n",
+             events_replayed,
+             ms_between(&virtual_began, &now),
+             ms_between(&real_began, &real_now));
+    LOG_Info("Painted %ld frames.\n",
+             metric_value(metric_register("batched frames")));
+  }
+}
+
+void replay_presented(int display, time_t shown) {
+  /*
+   * Called for each display as its frame goes up.
+   */
+  struct timespec now;
+
+  if (active && ((shown / 60) != shown_minutes[display])) {
+    shown_minutes[display] = shown / 60;
+    vclock_gettime(&now);
+    QLOG_Info(("Display %d showing minute %ld at %ld.%03ld.\n",
+               display,
+               (long) (shown / 60),
+               (long) now.tv_sec,
+               now.tv_nsec / 1000000L));
+  }
+}
+
+/*
+ *================================================================
+ *
+ *  Local routines.
+ *
+ *================================================================
+ */
+
+static int event_length(const SDL_Event *event) {
+  int result;
+
+  switch (event->type) {
+    case SDL_MOUSEMOTION:
+      result = sizeof(SDL_MouseMotionEvent);
+      break;
+
+    case SDL_MOUSEBUTTONDOWN:
+    case SDL_MOUSEBUTTONUP:
+      result = sizeof(SDL_MouseButtonEvent);
+      break;
+
+    case SDL_FINGERDOWN:
+    case SDL_FINGERUP:
+    case SDL_FINGERMOTION:
+      result = sizeof(SDL_TouchFingerEvent);
+      break;
+
+    case SDL_KEYDOWN:
+    case SDL_KEYUP:
+      result = sizeof(SDL_KeyboardEvent);
+      break;
+
+    case SDL_WINDOWEVENT:
+      result = sizeof(SDL_WindowEvent);
+      break;
+
+    case SDL_QUIT:
+      result = sizeof(SDL_CommonEvent);
+      break;
+
+    default:
+      result = sizeof(SDL_Event);
+      break;
+
+  }
+  return result;
+}
+
+
+static void read_next(void) {
+  have_next = FALSE;
+  if (log_offset + sizeof(t_event_header) <= log_length) {
+    memcpy(&next_header, log_map + log_offset, sizeof(t_event_header));
+    log_offset += sizeof(t_event_header);
+    if ((next_header.length > sizeof(SDL_Event)) ||
+        (log_offset + next_header.length > log_length)) {
+      LOG_Warning("Event log ends part way through an event.\n");
+    } else {
+      memset(&next_event, 0, sizeof(next_event));
+      memcpy(&next_event, log_map + log_offset, next_header.length);
+      log_offset += next_header.length;
+      have_next = TRUE;
+    }
+  }
+}
+
+
+static long due_in(void) {
+  /*
+   * Milliseconds until the next event is due, by the virtual clock.
+   */
+  struct timespec now;
+
+  vclock_monotonic(&now);
+  return (long) (next_header.ticks - first_ticks) -
+         ms_between(&virtual_began, &now);
+}
+
+
+static void pass_time(long ms) {
+  if (ms > 0) {
+    if (fast) {
+      vclock_advance(ms);
+    } else {
+      SDL_Delay(ms);
+    }
+  }
+}
+
+
+static int take(SDL_Event *event) {
+  /*
+   * Hand over the next event, stamped as if it had just arrived.
+   */
+  *event = next_event;
+  event->common.timestamp = SDL_GetTicks();
+  events_replayed++;
+  read_next();
+  return 1;
+}
+
+
+static long ms_between(
+    const struct timespec *from,
+    const struct timespec *to) {
+
+  return ((to->tv_sec - from->tv_sec) * 1000L) +
+         ((to->tv_nsec - from->tv_nsec) / 1000000L);
+}
@@ -0,0 +1,52 @@
+/*
+ *  Event recording and replay.
+ *
+ *  Recording writes every SDL input event the main loop takes, with
+ *  its SDL timestamp and the virtual time, to a compact binary log.
+ *  Only as much of each event as its type uses is kept, and events
+ *  which can't mean anything in another run - control socket requests
+ *  and other user events - are left out.
+ *
+ *  Replaying feeds a log back through the main loop in place of the
+ *  real event queue, with the virtual clock (see vclock.h) started at
+ *  the recorded time.  In real time it waits for each event as it
+ *  happened.  Fast, it never waits at all but moves the clock straight
+ *  on to whatever comes next - the next event, frame or minute - so
+ *  everything happens as it would have, only sooner.  Either way it's
+ *  deterministic, and run against the headless renderer it turns a
+ *  recorded session into a repeatable benchmark.
+ *
+ *  While replaying, the first frame of each minute on each display is
+ *  logged with the virtual time it was presented, so that a replay
+ *  shows whether a clock wall changed together.
+ */
+
+/*
+ *================================================================
+ *
+ *  External declarations.
+ *
+ *================================================================
+ */
+
+extern bool record_start(const char *file_name);
+
+extern void record_stop(void);
+
+extern bool replay_start(const char *file_name, bool fast);
+
+extern bool replaying(void);
+
+extern bool replay_finished(void);
+
+extern void replay_report(void);
+
+extern void replay_presented(int display, time_t shown);
+
+#if defined NEED_SDL
+extern void record_event(const SDL_Event *event);
+
+extern int replay_wait(SDL_Event *event, int timeout);
+
+extern int replay_poll(SDL_Event *event);
+#endif
@@ -10,6 +10,37 @@
  */
 
 #define MAX_STRING_LENGTH 80
+#define UNSET_STRING "<Unset>"
+
+/*
+ *  Defaults to use for anything not given in the configuration file.
+ *  These match the defaults in clock.rb where it has them.
+ */
+#define DEFAULT_TITLE          "Alarm clock"
+#define DEFAULT_SOUND_FILE     ""       /* Built in if empty */
+#define DEFAULT_SCREEN_WIDTH   1024
+#define DEFAULT_SCREEN_HEIGHT  600
+#define DEFAULT_DIM_DELAY      60
+#define DEFAULT_BRIGHT         200
+#define DEFAULT_DIM            30
+#define DEFAULT_STARTUP_BUDGET 3000     /* Milliseconds, 0 for none */
+#define DEFAULT_FONT_CACHE     "/var/tmp"
+#define DEFAULT_SNOOZE_TIME    540      /* Seconds */
+#define DEFAULT_CONTROL_SOCKET "/tmp/alarmclock.socket"
+#define DEFAULT_STATE_JOURNAL  "/var/tmp/alarmclock.journal"
+#define DEFAULT_MAX_FPS        30
+#define DEFAULT_FADE_TIME      400      /* Milliseconds */
+#define DEFAULT_SUNRISE_TIME   300      /* Seconds, 0 for none */
+#define DEFAULT_DRIFT_TIME     300      /* Seconds, 0 to jump each minute */
+#define DEFAULT_CLOCK_FACE     "digital" /* Or "analog" */
+#define DEFAULT_SECOND_HAND    0        /* Frames per second, 0 for none */
+#define DEFAULT_LATENCY_BUDGET 100      /* Milliseconds, 0 for none */
+#define DEFAULT_STATUS_PAGE    "/dev/shm/alarmclock.status"
+#define DEFAULT_FRAME_DEADLINE 2000     /* Milliseconds, 0 for no watchdog */
+#define DEFAULT_NOTIFY_SOCKET  ""       /* Or $NOTIFY_SOCKET */
+#define DEFAULT_MENU_ICON      ""       /* Built in if empty */
+#define DEFAULT_ALARM_IMPORT   ""       /* CSV or iCalendar - see import.h */
+#define DEFAULT_RENDER_BUDGET  30       /* CPU ms a frame, 0 for Solid only */
 
 /*
  *================================================================
@@ -37,6 +68,16 @@ typedef enum {
   had_alarm_time,
   had_alarm_days,
   in_alarm_days,
+  had_alarm_rule,
+  had_alarm_dates,
+  in_alarm_dates,
+  had_alarm_display,
+  had_holidays,
+  in_holidays,
+  had_displays,
+  in_displays,
+  in_display,
+  had_display_item,
   finished
 } t_parsing_state;
 
@@ -49,6 +90,24 @@ typedef enum {
   k_dim_delay,
   k_bright,
   k_dim,
+  k_startup_budget,
+  k_font_cache,
+  k_snooze_time,
+  k_control_socket,
+  k_state_journal,
+  k_max_fps,
+  k_fade_time,
+  k_sunrise_time,
+  k_drift_time,
+  k_clock_face,
+  k_second_hand_fps,
+  k_latency_budget,
+  k_status_page,
+  k_frame_deadline,
+  k_watchdog_socket,
+  k_menu_icon_file,
+  k_alarm_import_file,
+  k_render_budget,
   k_fonts,
   k_large,
   k_medium,
@@ -58,9 +117,24 @@ typedef enum {
   k_alarms,
   k_time,
   k_days,
+  k_every_weeks,
+  k_starting,
+  k_monthly,
+  k_skip_holidays,
+  k_dates,
+  k_skip,
+  k_holidays,
+  k_display,
+  k_displays,
   k_unknown
 } t_known_keyword;
 
+typedef struct {
+  char title[MAX_STRING_LENGTH + 1];
+  int  screen_width;
+  int  screen_height;
+} t_display_settings;
+
 /*
  *================================================================
  *
@@ -69,13 +143,39 @@ typedef enum {
  *================================================================
  */
 
-static char title[MAX_STRING_LENGTH + 1] = "<Unset>";
-static char sound_file_name[MAX_STRING_LENGTH + 1] = "<Unset>";
+static char title[MAX_STRING_LENGTH + 1] = UNSET_STRING;
+static char sound_file_name[MAX_STRING_LENGTH + 1] = UNSET_STRING;
 static int screen_width = -1;
 static int screen_height = -1;
 static int dim_delay = -1;
 static int bright_value = -1;
 static int dim_value = -1;
+static int startup_budget = -1;
+static char font_cache[MAX_STRING_LENGTH + 1] = UNSET_STRING;
+static int snooze_time = -1;
+static char control_socket[MAX_STRING_LENGTH + 1] = UNSET_STRING;
+static char state_journal[MAX_STRING_LENGTH + 1] = UNSET_STRING;
+static int max_fps = -1;
+static int fade_time = -1;
+static int sunrise_time = -1;
+static int drift_time = -1;
+static char clock_face[MAX_STRING_LENGTH + 1] = UNSET_STRING;
+static int second_hand_fps = -1;
+static int latency_budget = -1;
+static char status_page[MAX_STRING_LENGTH + 1] = UNSET_STRING;
+static int frame_deadline = -1;
+static char watchdog_socket[MAX_STRING_LENGTH + 1] = UNSET_STRING;
+static char menu_icon_file[MAX_STRING_LENGTH + 1] = UNSET_STRING;
+static char alarm_import_file[MAX_STRING_LENGTH + 1] = UNSET_STRING;
+static int render_budget = -1;
+
+/*
+ *  With no displays section there's just the one display, set up by
+ *  the main settings.  Anything a display doesn't give comes from
+ *  there too.
+ */
+static t_display_settings display_settings[MAX_DISPLAYS];
+static int                num_displays = 0;
 
 /*
  *================================================================
@@ -93,6 +193,13 @@ static bool setting_keyword(t_known_keyword keyword);
 
 static bool a_font_size(t_known_keyword keyword);
 
+static bool a_rule_setting(t_known_keyword keyword);
+
+static bool store_rule(
+    t_recurrence      *rule,
+    t_known_keyword    keyword,
+    const yaml_char_t *value);
+
 static bool a_font_setting(t_known_keyword keyword);
 
 static bool store_away(
@@ -104,6 +211,17 @@ static bool save_font_detail(
     t_known_keyword attribute,
     const yaml_char_t *value);
 
+static bool a_display_setting(t_known_keyword keyword);
+
+static bool save_display_detail(
+    t_display_settings *display,
+    t_known_keyword     keyword,
+    const yaml_char_t  *value);
+
+static const char *string_or_default(const char *value, const char *fallback);
+
+static int int_or_default(int value, int fallback);
+
 /*
  *================================================================
  *
@@ -136,7 +254,8 @@ bool parse_config(void) {
       if (yaml_parser_parse(&parser, &event)) {
         handled = FALSE;
         /*
-        LOG_Debug("Current state is \"%s\".\n", state_text(parsing_state));
+        QLOG_Debug(("Current state is \"%s\".\n",
+                    state_text(parsing_state)));
         */
         switch (parsing_state) {
           case initial:
@@ -179,6 +298,12 @@ bool parse_config(void) {
                 } else if (keyword == k_alarms) {
                   parsing_state = had_alarms;
                   handled = TRUE;
+                } else if (keyword == k_holidays) {
+                  parsing_state = had_holidays;
+                  handled = TRUE;
+                } else if (keyword == k_displays) {
+                  parsing_state = had_displays;
+                  handled = TRUE;
                 }
                 break;
 
@@ -354,6 +479,8 @@ bool parse_config(void) {
                 for (i = 0; i < 7; i++) {
                   building_alarm.days[i] = TRUE;   /* Default to all days */
                 }
+                recurrence_init(&building_alarm.rule);
+                building_alarm.display = 0;
                 parsing_state = in_alarm;
                 handled = TRUE;
                 break;
@@ -385,15 +512,26 @@ bool parse_config(void) {
                   }
                   parsing_state = had_alarm_days;
                   handled = TRUE;
+                } else if (a_rule_setting(keyword)) {
+                  parsing_state = had_alarm_rule;
+                  handled = TRUE;
+                } else if ((keyword == k_dates) || (keyword == k_skip)) {
+                  parsing_state = had_alarm_dates;
+                  handled = TRUE;
+                } else if (keyword == k_display) {
+                  parsing_state = had_alarm_display;
+                  handled = TRUE;
                 }
                 break;
 
               case YAML_MAPPING_END_EVENT:
-                if (add_alarm(building_alarm)) {
+                if (add_alarm(building_alarm) >= 0) {
                   building_alarm.trigger_time = -1;  /* Invalid */
                   for (i = 0; i < 7; i++) {
                     building_alarm.days[i] = TRUE;   /* Default to all days */
                   }
+                  recurrence_init(&building_alarm.rule);
+                  building_alarm.display = 0;
                   parsing_state = in_alarms;
                   handled = TRUE;
                 }
@@ -456,6 +594,184 @@ bool parse_config(void) {
             }
             break;
 
+          case had_alarm_rule:
+            switch (event.type) {
+              case YAML_SCALAR_EVENT:
+                if (store_rule(&building_alarm.rule,
+                               keyword,
+                               event.data.scalar.value)) {
+                  parsing_state = in_alarm;
+                  handled = TRUE;
+                }
+                break;
+
+              default:
+                break;
+
+            }
+            break;
+
+          case had_alarm_dates:
+            switch (event.type) {
+              case YAML_SEQUENCE_START_EVENT:
+                parsing_state = in_alarm_dates;
+                handled = TRUE;
+                break;
+
+              default:
+                break;
+
+            }
+            break;
+
+          case in_alarm_dates:
+            switch (event.type) {
+              case YAML_SCALAR_EVENT:
+                if (keyword == k_dates) {
+                  handled = recurrence_add_date(
+                              &building_alarm.rule,
+                              (const char *) event.data.scalar.value);
+                } else {
+                  handled = recurrence_add_skip(
+                              &building_alarm.rule,
+                              (const char *) event.data.scalar.value);
+                }
+                break;
+
+              case YAML_SEQUENCE_END_EVENT:
+                parsing_state = in_alarm;
+                handled = TRUE;
+                break;
+
+              default:
+                break;
+
+            }
+            break;
+
+          case had_alarm_display:
+            switch (event.type) {
+              case YAML_SCALAR_EVENT:
+                building_alarm.display =
+                  integer((const char *) event.data.scalar.value);
+                parsing_state = in_alarm;
+                handled = TRUE;
+                break;
+
+              default:
+                break;
+
+            }
+            break;
+
+          case had_holidays:
+            switch (event.type) {
+              case YAML_SEQUENCE_START_EVENT:
+                parsing_state = in_holidays;
+                handled = TRUE;
+                break;
+
+              default:
+                break;
+
+            }
+            break;
+
+          case in_holidays:
+            switch (event.type) {
+              case YAML_SCALAR_EVENT:
+                handled = add_holiday((const char *) event.data.scalar.value);
+                break;
+
+              case YAML_SEQUENCE_END_EVENT:
+                parsing_state = outer_mapping;
+                handled = TRUE;
+                break;
+
+              default:
+                break;
+
+            }
+            break;
+
+          case had_displays:
+            switch (event.type) {
+              case YAML_SEQUENCE_START_EVENT:
+                parsing_state = in_displays;
+                handled = TRUE;
+                break;
+
+              default:
+                break;
+
+            }
+            break;
+
+          case in_displays:
+            switch (event.type) {
+              case YAML_MAPPING_START_EVENT:
+                if (num_displays < MAX_DISPLAYS) {
+                  strcpy(display_settings[num_displays].title, UNSET_STRING);
+                  display_settings[num_displays].screen_width = -1;
+                  display_settings[num_displays].screen_height = -1;
+                  parsing_state = in_display;
+                  handled = TRUE;
+                } else {
+                  LOG_Error("Too many displays - limit is %d.\n",
+                            MAX_DISPLAYS);
+                }
+                break;
+
+              case YAML_SEQUENCE_END_EVENT:
+                parsing_state = outer_mapping;
+                handled = TRUE;
+                break;
+
+              default:
+                break;
+
+            }
+            break;
+
+          case in_display:
+            switch (event.type) {
+              case YAML_SCALAR_EVENT:
+                keyword = identify_keyword(event.data.scalar.value);
+                if (a_display_setting(keyword)) {
+                  parsing_state = had_display_item;
+                  handled = TRUE;
+                }
+                break;
+
+              case YAML_MAPPING_END_EVENT:
+                num_displays++;
+                parsing_state = in_displays;
+                handled = TRUE;
+                break;
+
+              default:
+                break;
+
+            }
+            break;
+
+          case had_display_item:
+            switch (event.type) {
+              case YAML_SCALAR_EVENT:
+                if (save_display_detail(display_settings + num_displays,
+                                        keyword,
+                                        event.data.scalar.value)) {
+                  parsing_state = in_display;
+                  handled = TRUE;
+                }
+                break;
+
+              default:
+                break;
+
+            }
+            break;
+
           case finished:
             switch (event.type) {
               case YAML_DOCUMENT_END_EVENT:
@@ -481,57 +797,60 @@ bool parse_config(void) {
           switch (event.type) {
 
             case YAML_STREAM_START_EVENT:
-              LOG_Debug("Stream start.\n");
+              QLOG_Debug(("Stream start.\n"));
               break;
 
             case YAML_STREAM_END_EVENT:
-              LOG_Debug("Stream end.\n");
+              QLOG_Debug(("Stream end.\n"));
               done = TRUE;
               break;
 
             case YAML_DOCUMENT_START_EVENT:
-              LOG_Debug("Document start.\n");
+              QLOG_Debug(("Document start.\n"));
               break;
 
             case YAML_DOCUMENT_END_EVENT:
-              LOG_Debug("Document end.\n");
+              QLOG_Debug(("Document end.\n"));
               break;
 
             case YAML_ALIAS_EVENT:
-              LOG_Debug("Alias event.\n");
+              QLOG_Debug(("Alias event.\n"));
               break;
 
             case YAML_SCALAR_EVENT:
-              LOG_Debug("Scalar event.\n");
-  /*            LOG_Debug("Anchor - %s\n", event.data.scalar.anchor);        */
-  /*            LOG_Debug("Tag    - %s\n", event.data.scalar.tag);           */
-              LOG_Debug("Value  - %s\n", event.data.scalar.value);
+              QLOG_Debug(("Scalar event.\n"));
+  /*            QLOG_Debug(("Anchor - %s\n", event.data.scalar.anchor));        */
+  /*            QLOG_Debug(("Tag    - %s\n", event.data.scalar.tag));           */
+              QLOG_Debug(("Value  - %s\n", event.data.scalar.value));
               break;
 
             case YAML_SEQUENCE_START_EVENT:
-              LOG_Debug("Sequence start event.\n");
+              QLOG_Debug(("Sequence start event.\n"));
               break;
 
             case YAML_SEQUENCE_END_EVENT:
-              LOG_Debug("Sequence end event.\n");
+              QLOG_Debug(("Sequence end event.\n"));
               break;
 
             case YAML_MAPPING_START_EVENT:
-              LOG_Debug("Mapping start event.\n");
-              LOG_Debug("Anchor - %s\n", event.data.mapping_start.anchor);
-              LOG_Debug("Tag    - %s\n", event.data.mapping_start.tag);
+              QLOG_Debug(("Mapping start event.\n"));
+              QLOG_Debug(("Anchor - %s\n",
+                          event.data.mapping_start.anchor));
+              QLOG_Debug(("Tag    - %s\n",
+                          event.data.mapping_start.tag));
               break;
 
             case YAML_MAPPING_END_EVENT:
-              LOG_Debug("Mapping end event.\n");
+              QLOG_Debug(("Mapping end event.\n"));
               break;
 
             default:
-              LOG_Debug("Got event %d\n", event.type);
+              QLOG_Debug(("Got event %d\n", event.type));
               break;
 
           }
-          LOG_Debug("Final state is \"%s\".\n", state_text(parsing_state));
+          QLOG_Error(("Final state is \"%s\".\n",
+                      state_text(parsing_state)));
           exit(EXIT_FAILURE);
         }       /* !handled */
       } else {
@@ -550,18 +869,174 @@ void dump_settings(void) {
   /*
    *  Print out all the settings for debug purposes.
    */
-  LOG_Debug("Title - \"%s\"\n", title);
-  LOG_Debug("Sound file name - \"%s\"\n", sound_file_name);
-  LOG_Debug("Screen width - %d\n", screen_width);
-  LOG_Debug("Screen height - %d\n", screen_height);
-  LOG_Debug("Dim delay - %d\n", dim_delay);
-  LOG_Debug("Bright value - %d\n", bright_value);
-  LOG_Debug("Dim value - %d\n", dim_value);
+  int i;
+
+  QLOG_Debug(("Title - \"%s\"\n", title));
+  QLOG_Debug(("Sound file name - \"%s\"\n", sound_file_name));
+  QLOG_Debug(("Screen width - %d\n", screen_width));
+  QLOG_Debug(("Screen height - %d\n", screen_height));
+  QLOG_Debug(("Dim delay - %d\n", dim_delay));
+  QLOG_Debug(("Bright value - %d\n", bright_value));
+  QLOG_Debug(("Dim value - %d\n", dim_value));
+  QLOG_Debug(("Startup budget - %d\n", startup_budget));
+  QLOG_Debug(("Font cache directory - \"%s\"\n", font_cache));
+  QLOG_Debug(("Snooze time - %d\n", snooze_time));
+  QLOG_Debug(("Control socket - \"%s\"\n", control_socket));
+  QLOG_Debug(("State journal - \"%s\"\n", state_journal));
+  QLOG_Debug(("Max frames per second - %d\n", max_fps));
+  QLOG_Debug(("Fade time - %d\n", fade_time));
+  QLOG_Debug(("Sunrise time - %d\n", sunrise_time));
+  QLOG_Debug(("Drift time - %d\n", drift_time));
+  QLOG_Debug(("Clock face - \"%s\"\n", clock_face));
+  QLOG_Debug(("Second hand fps - %d\n", second_hand_fps));
+  QLOG_Debug(("Latency budget - %d\n", latency_budget));
+  QLOG_Debug(("Status page - \"%s\"\n", status_page));
+  QLOG_Debug(("Frame deadline - %d\n", frame_deadline));
+  QLOG_Debug(("Watchdog socket - \"%s\"\n", watchdog_socket));
+  QLOG_Debug(("Menu icon file - \"%s\"\n", menu_icon_file));
+  QLOG_Debug(("Alarm import file - \"%s\"\n", alarm_import_file));
+  QLOG_Debug(("Render budget - %d\n", render_budget));
+  for (i = 0; i < num_displays; i++) {
+    QLOG_Debug(("Display %d - \"%s\", %d x %d\n",
+                i,
+                display_settings[i].title,
+                display_settings[i].screen_width,
+                display_settings[i].screen_height));
+  }
 
   dump_fonts();
   dump_alarms();
 }
 
+/*
+ *  Accessors for the running program.  Each falls back to the default
+ *  if the configuration file didn't provide a value.
+ */
+
+const char *get_title(void) {
+  return string_or_default(title, DEFAULT_TITLE);
+}
+
+const char *get_sound_file_name(void) {
+  return string_or_default(sound_file_name, DEFAULT_SOUND_FILE);
+}
+
+int get_screen_width(void) {
+  return int_or_default(screen_width, DEFAULT_SCREEN_WIDTH);
+}
+
+int get_screen_height(void) {
+  return int_or_default(screen_height, DEFAULT_SCREEN_HEIGHT);
+}
+
+int get_dim_delay(void) {
+  return int_or_default(dim_delay, DEFAULT_DIM_DELAY);
+}
+
+int get_bright_value(void) {
+  return int_or_default(bright_value, DEFAULT_BRIGHT);
+}
+
+int get_dim_value(void) {
+  return int_or_default(dim_value, DEFAULT_DIM);
+}
+
+int get_startup_budget(void) {
+  return int_or_default(startup_budget, DEFAULT_STARTUP_BUDGET);
+}
+
+const char *get_font_cache(void) {
+  return string_or_default(font_cache, DEFAULT_FONT_CACHE);
+}
+
+int get_snooze_time(void) {
+  return int_or_default(snooze_time, DEFAULT_SNOOZE_TIME);
+}
+
+const char *get_control_socket(void) {
+  return string_or_default(control_socket, DEFAULT_CONTROL_SOCKET);
+}
+
+const char *get_state_journal(void) {
+  return string_or_default(state_journal, DEFAULT_STATE_JOURNAL);
+}
+
+int get_max_fps(void) {
+  return int_or_default(max_fps, DEFAULT_MAX_FPS);
+}
+
+int get_fade_time(void) {
+  return int_or_default(fade_time, DEFAULT_FADE_TIME);
+}
+
+int get_sunrise_time(void) {
+  return int_or_default(sunrise_time, DEFAULT_SUNRISE_TIME);
+}
+
+int get_drift_time(void) {
+  return int_or_default(drift_time, DEFAULT_DRIFT_TIME);
+}
+
+const char *get_clock_face(void) {
+  return string_or_default(clock_face, DEFAULT_CLOCK_FACE);
+}
+
+int get_second_hand_fps(void) {
+  return int_or_default(second_hand_fps, DEFAULT_SECOND_HAND);
+}
+
+int get_latency_budget(void) {
+  return int_or_default(latency_budget, DEFAULT_LATENCY_BUDGET);
+}
+
+const char *get_status_page(void) {
+  return string_or_default(status_page, DEFAULT_STATUS_PAGE);
+}
+
+int get_frame_deadline(void) {
+  return int_or_default(frame_deadline, DEFAULT_FRAME_DEADLINE);
+}
+
+const char *get_watchdog_socket(void) {
+  return string_or_default(watchdog_socket, DEFAULT_NOTIFY_SOCKET);
+}
+
+const char *get_menu_icon_file(void) {
+  return string_or_default(menu_icon_file, DEFAULT_MENU_ICON);
+}
+
+int get_display_count(void) {
+  return (num_displays > 0) ? num_displays : 1;
+}
+
+const char *get_display_title(int display) {
+  return (display < num_displays) ?
+           string_or_default(display_settings[display].title, get_title()) :
+           get_title();
+}
+
+int get_display_width(int display) {
+  return (display < num_displays) ?
+           int_or_default(display_settings[display].screen_width,
+                          get_screen_width()) :
+           get_screen_width();
+}
+
+int get_display_height(int display) {
+  return (display < num_displays) ?
+           int_or_default(display_settings[display].screen_height,
+                          get_screen_height()) :
+           get_screen_height();
+}
+
+const char *get_alarm_import_file(void) {
+  return string_or_default(alarm_import_file, DEFAULT_ALARM_IMPORT);
+}
+
+int get_render_budget(void) {
+  return int_or_default(render_budget, DEFAULT_RENDER_BUDGET);
+}
+
 /*
  *================================================================
  *
@@ -589,6 +1064,16 @@ static const char *state_text(t_parsing_state state) {
     "had_alarm_time",
     "had_alarm_days",
     "in_alarm_days",
+    "had_alarm_rule",
+    "had_alarm_dates",
+    "in_alarm_dates",
+    "had_alarm_display",
+    "had_holidays",
+    "in_holidays",
+    "had_displays",
+    "in_displays",
+    "in_display",
+    "had_display_item",
     "finished"
   };
 
@@ -606,6 +1091,24 @@ static t_known_keyword identify_keyword(yaml_char_t *candidate) {
     ":dim_delay",
     ":bright",
     ":dim",
+    ":startup_budget",
+    ":font_cache",
+    ":snooze_time",
+    ":control_socket",
+    ":state_journal",
+    ":max_fps",
+    ":fade_time",
+    ":sunrise_time",
+    ":drift_time",
+    ":clock_face",
+    ":second_hand_fps",
+    ":latency_budget",
+    ":status_page",
+    ":frame_deadline",
+    ":watchdog_socket",
+    ":menu_icon_file",
+    ":alarm_import_file",
+    ":render_budget",
     ":fonts",
     ":large",
     ":medium",
@@ -614,7 +1117,16 @@ static t_known_keyword identify_keyword(yaml_char_t *candidate) {
     ":size",
     ":alarms",
     ":time",
-    ":days"
+    ":days",
+    ":every_weeks",
+    ":starting",
+    ":monthly",
+    ":skip_holidays",
+    ":dates",
+    ":skip",
+    ":holidays",
+    ":display",
+    ":displays"
   };
 
   t_known_keyword index = k_settings;   /* The first one */
@@ -644,7 +1156,25 @@ static bool setting_keyword(t_known_keyword keyword) {
          (keyword == k_alarm_sound_file) ||
          (keyword == k_dim_delay) ||
          (keyword == k_bright) ||
-         (keyword == k_dim);
+         (keyword == k_dim) ||
+         (keyword == k_startup_budget) ||
+         (keyword == k_font_cache) ||
+         (keyword == k_snooze_time) ||
+         (keyword == k_control_socket) ||
+         (keyword == k_state_journal) ||
+         (keyword == k_max_fps) ||
+         (keyword == k_fade_time) ||
+         (keyword == k_sunrise_time) ||
+         (keyword == k_drift_time) ||
+         (keyword == k_clock_face) ||
+         (keyword == k_second_hand_fps) ||
+         (keyword == k_latency_budget) ||
+         (keyword == k_status_page) ||
+         (keyword == k_frame_deadline) ||
+         (keyword == k_watchdog_socket) ||
+         (keyword == k_menu_icon_file) ||
+         (keyword == k_alarm_import_file) ||
+         (keyword == k_render_budget);
 }
 
 
@@ -667,6 +1197,52 @@ static bool a_font_setting(t_known_keyword keyword) {
 }
 
 
+static bool a_rule_setting(t_known_keyword keyword) {
+  /*
+   * Is this keyword one for a single-valued part of an alarm's rule?
+   */
+  return (keyword == k_every_weeks) ||
+         (keyword == k_starting) ||
+         (keyword == k_monthly) ||
+         (keyword == k_skip_holidays);
+}
+
+
+static bool store_rule(
+    t_recurrence      *rule,
+    t_known_keyword    keyword,
+    const yaml_char_t *value) {
+
+  bool  result = FALSE;
+  char *ptr;
+
+  ptr = (char *) value;
+  switch (keyword) {
+    case k_every_weeks:
+      result = recurrence_set_interval(rule, ptr);
+      break;
+
+    case k_starting:
+      result = recurrence_set_start(rule, ptr);
+      break;
+
+    case k_monthly:
+      result = recurrence_set_monthly(rule, ptr);
+      break;
+
+    case k_skip_holidays:
+      rule->skip_holidays = (strcmp(ptr, "true") == 0);
+      result = TRUE;
+      break;
+
+    default:
+      break;
+
+  }
+  return result;
+}
+
+
 static bool store_away(
     t_known_keyword    keyword,
     const yaml_char_t *value) {
@@ -704,6 +1280,78 @@ static bool store_away(
       dim_value = integer(ptr);
       break;
 
+    case k_startup_budget:
+      startup_budget = integer(ptr);
+      break;
+
+    case k_font_cache:
+      safe_copy(font_cache, ptr, MAX_STRING_LENGTH, "Font cache directory");
+      break;
+
+    case k_snooze_time:
+      snooze_time = integer(ptr);
+      break;
+
+    case k_control_socket:
+      safe_copy(control_socket, ptr, MAX_STRING_LENGTH, "Control socket");
+      break;
+
+    case k_state_journal:
+      safe_copy(state_journal, ptr, MAX_STRING_LENGTH, "State journal");
+      break;
+
+    case k_max_fps:
+      max_fps = integer(ptr);
+      break;
+
+    case k_fade_time:
+      fade_time = integer(ptr);
+      break;
+
+    case k_sunrise_time:
+      sunrise_time = integer(ptr);
+      break;
+
+    case k_drift_time:
+      drift_time = integer(ptr);
+      break;
+
+    case k_clock_face:
+      safe_copy(clock_face, ptr, MAX_STRING_LENGTH, "Clock face");
+      break;
+
+    case k_second_hand_fps:
+      second_hand_fps = integer(ptr);
+      break;
+
+    case k_latency_budget:
+      latency_budget = integer(ptr);
+      break;
+
+    case k_status_page:
+      safe_copy(status_page, ptr, MAX_STRING_LENGTH, "Status page");
+      break;
+
+    case k_frame_deadline:
+      frame_deadline = integer(ptr);
+      break;
+
+    case k_watchdog_socket:
+      safe_copy(watchdog_socket, ptr, MAX_STRING_LENGTH, "Watchdog socket");
+      break;
+
+    case k_menu_icon_file:
+      safe_copy(menu_icon_file, ptr, MAX_STRING_LENGTH, "Menu icon file");
+      break;
+
+    case k_alarm_import_file:
+      safe_copy(alarm_import_file, ptr, MAX_STRING_LENGTH,
+                "Alarm import file");
+      break;
+
+    case k_render_budget:
+      render_budget = integer(ptr);
+      break;
 
     default:
       result = FALSE;
@@ -737,3 +1385,48 @@ static bool save_font_detail(
 }
 
 
+static bool a_display_setting(t_known_keyword keyword) {
+  /*
+   * Is this keyword one which a display can have for itself?
+   */
+  return (keyword == k_title) ||
+         (keyword == k_screen_width) ||
+         (keyword == k_screen_height);
+}
+
+
+static bool save_display_detail(
+    t_display_settings *display,
+    t_known_keyword     keyword,
+    const yaml_char_t  *value) {
+
+  char *ptr;
+
+  ptr = (char *) value;
+  if (keyword == k_title) {
+    safe_copy(display->title, ptr, MAX_STRING_LENGTH, "Display title");
+  } else if (keyword == k_screen_width) {
+    display->screen_width = integer(ptr);
+  } else if (keyword == k_screen_height) {
+    display->screen_height = integer(ptr);
+  }
+  return TRUE;
+}
+
+
+static const char *string_or_default(const char *value, const char *fallback) {
+  if (strcmp(value, UNSET_STRING) == 0) {
+    return fallback;
+  } else {
+    return value;
+  }
+}
+
+
+static int int_or_default(int value, int fallback) {
+  if (value < 0) {
+    return fallback;
+  } else {
+    return value;
+  }
+}
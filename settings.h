@@ -1,4 +1,18 @@
 
+/*
+ *================================================================
+ *
+ *  Constants.
+ *
+ *================================================================
+ */
+
+/*
+ *  A clock wall - one process driving several panels, each with its
+ *  own window and alarms (see the displays section of the config).
+ */
+#define MAX_DISPLAYS 4
+
 /*
  *================================================================
  *
@@ -19,3 +33,61 @@
 extern bool parse_config(void);
 
 extern void dump_settings(void);
+
+extern const char *get_title(void);
+
+extern const char *get_sound_file_name(void);
+
+extern int get_screen_width(void);
+
+extern int get_screen_height(void);
+
+extern int get_dim_delay(void);
+
+extern int get_bright_value(void);
+
+extern int get_dim_value(void);
+
+extern int get_startup_budget(void);
+
+extern const char *get_font_cache(void);
+
+extern int get_snooze_time(void);
+
+extern const char *get_control_socket(void);
+
+extern const char *get_state_journal(void);
+
+extern int get_max_fps(void);
+
+extern int get_fade_time(void);
+
+extern int get_sunrise_time(void);
+
+extern int get_drift_time(void);
+
+extern const char *get_clock_face(void);
+
+extern int get_second_hand_fps(void);
+
+extern int get_latency_budget(void);
+
+extern const char *get_status_page(void);
+
+extern int get_frame_deadline(void);
+
+extern const char *get_watchdog_socket(void);
+
+extern const char *get_menu_icon_file(void);
+
+extern int get_display_count(void);
+
+extern const char *get_display_title(int display);
+
+extern int get_display_width(int display);
+
+extern int get_display_height(int display);
+
+extern const char *get_alarm_import_file(void);
+
+extern int get_render_budget(void);
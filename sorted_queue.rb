@@ -0,0 +1,30 @@
+#
+#  The plain Ruby stand-in for ClockCore::TimerQueue (see
+#  ext/clock_core), used by clock.rb's Alarmer when the extension hasn't
+#  been built.  It re-sorts on every change, which is fine for the
+#  handful we have.
+#
+class SortedQueue
+  def initialize
+    @entries = []
+  end
+
+  def push(at_when, item)
+    @entries << [at_when, item]
+    @entries.sort_by!(&:first)
+    self
+  end
+
+  def next_time
+    @entries.empty? ? nil : @entries[0][0]
+  end
+
+  def shift
+    entry = @entries.shift
+    entry && entry[1]
+  end
+
+  def empty?
+    @entries.empty?
+  end
+end
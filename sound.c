@@ -0,0 +1,215 @@
+/*
+ *  Alarm sound.
+ */
+
+#define NEED_SDL
+#include "includes.h"
+
+/*
+ *================================================================
+ *
+ *  Constants.
+ *
+ *================================================================
+ */
+
+#define ALARM_CHANNEL    0
+#define ALARM_VOLUME     128
+#define FADE_IN_MS       600
+
+/*
+ *================================================================
+ *
+ *  Local data.
+ *
+ *================================================================
+ */
+
+static bool       ready = FALSE;
+static Mix_Chunk *alarm_sound = NULL;
+
+/*
+ *  The raw contents of the sound file, read in at start-up so that
+ *  getting ready for an alarm doesn't have to wait on the SD card.
+ */
+static void      *sound_data = NULL;
+static long       sound_length = 0;
+
+/*
+ *  The built-in sound, if the mixer didn't open at the format it was
+ *  decoded for.
+ */
+static Uint8     *converted = NULL;
+
+/*
+ *================================================================
+ *
+ *  Forward declarations.
+ *
+ *================================================================
+ */
+
+static Mix_Chunk *load_builtin_sound(void);
+
+/*
+ *================================================================
+ *
+ *  Externally visible routines.
+ *
+ *================================================================
+ */
+
+void preload_sound(void) {
+  /*
+   * Read the sound file, if there is one, into memory.  Safe to call
+   * on a worker thread.  If this fails we just fall back to loading
+   * from the file later.  The built-in sound needs no reading.
+   */
+  FILE *sound_file;
+
+  if (*get_sound_file_name() != '\0') {
+    sound_file = fopen(get_sound_file_name(), "rb");
+    if (sound_file == NULL) {
+      LOG_Warning("Failed to open \"%s\".\n", get_sound_file_name());
+    } else {
+      if ((fseek(sound_file, 0, SEEK_END) == 0) &&
+          ((sound_length = ftell(sound_file)) > 0) &&
+          (fseek(sound_file, 0, SEEK_SET) == 0)) {
+        sound_data = malloc(sound_length);
+        if ((sound_data != NULL) &&
+            (fread(sound_data, 1, sound_length, sound_file) !=
+             sound_length)) {
+          LOG_Warning("Failed to read \"%s\".\n", get_sound_file_name());
+          free(sound_data);
+          sound_data = NULL;
+        }
+      }
+      fclose(sound_file);
+    }
+  }
+}
+
+bool prepare_sound(void) {
+  /*
+   * Bring up the audio subsystem and load the alarm sound.  Called
+   * lazily, just before the first alarm which needs it.
+   */
+  if (!ready) {
+    if (SDL_InitSubSystem(SDL_INIT_AUDIO) != 0) {
+      LOG_Error("Failed to initialise audio - %s\n", SDL_GetError());
+    } else {
+      Mix_Init(MIX_INIT_OGG);
+      if (Mix_OpenAudio(AUDIO_FREQUENCY,
+                        MIX_DEFAULT_FORMAT,
+                        AUDIO_CHANNELS,
+                        AUDIO_CHUNK_SIZE) != 0) {
+        LOG_Error("Failed to open audio - %s\n", Mix_GetError());
+        Mix_Quit();
+        SDL_QuitSubSystem(SDL_INIT_AUDIO);
+      } else {
+        if (sound_data != NULL) {
+          alarm_sound =
+            Mix_LoadWAV_RW(SDL_RWFromConstMem(sound_data, sound_length), 1);
+        } else if (*get_sound_file_name() != '\0') {
+          alarm_sound = Mix_LoadWAV(get_sound_file_name());
+        }
+        if ((alarm_sound == NULL) && (*get_sound_file_name() != '\0')) {
+          LOG_Error("Failed to load \"%s\" - %s\n",
+                    get_sound_file_name(),
+                    Mix_GetError());
+        }
+        if (alarm_sound == NULL) {
+          alarm_sound = load_builtin_sound();
+        }
+        ready = TRUE;
+      }
+    }
+  }
+  return ready;
+}
+
+bool sound_ready(void) {
+  return ready;
+}
+
+void start_alarm_sound(void) {
+  if (ready && (alarm_sound != NULL)) {
+    Mix_Volume(ALARM_CHANNEL, ALARM_VOLUME);
+    Mix_FadeInChannel(ALARM_CHANNEL, alarm_sound, 0, FADE_IN_MS);
+  }
+}
+
+void stop_alarm_sound(void) {
+  if (ready) {
+    Mix_HaltChannel(ALARM_CHANNEL);
+  }
+}
+
+bool sound_playing(void) {
+  return ready && (Mix_Playing(ALARM_CHANNEL) != 0);
+}
+
+void release_sound(void) {
+  /*
+   * Shut audio down again so that there's no mixer thread running
+   * while we're idle.
+   */
+  if (ready) {
+    Mix_HaltChannel(ALARM_CHANNEL);
+    if (alarm_sound != NULL) {
+      Mix_FreeChunk(alarm_sound);
+      alarm_sound = NULL;
+    }
+    free(converted);
+    converted = NULL;
+    Mix_CloseAudio();
+    Mix_Quit();
+    SDL_QuitSubSystem(SDL_INIT_AUDIO);
+    ready = FALSE;
+  }
+}
+
+/*
+ *================================================================
+ *
+ *  Local routines.
+ *
+ *================================================================
+ */
+
+static Mix_Chunk *load_builtin_sound(void) {
+  /*
+   * Normally the mixer opens at the format the sound was decoded for
+   * and it's played straight out of the binary.  If it didn't, the
+   * sound is converted to suit (once per alarm).
+   */
+  SDL_AudioCVT cvt;
+  int          channels;
+  Uint16       format;
+  int          frequency;
+  Mix_Chunk   *result = NULL;
+
+  Mix_QuerySpec(&frequency, &format, &channels);
+  if (SDL_BuildAudioCVT(&cvt,
+                        MIX_DEFAULT_FORMAT, AUDIO_CHANNELS, AUDIO_FREQUENCY,
+                        format, channels, frequency) < 0) {
+    LOG_Error("Can't convert built-in sound - %s\n", SDL_GetError());
+  } else if (!cvt.needed) {
+    result = Mix_QuickLoad_RAW((Uint8 *) builtin_alarm_pcm,
+                               builtin_alarm_length);
+  } else {
+    converted = malloc(builtin_alarm_length * cvt.len_mult);
+    if (converted != NULL) {
+      memcpy(converted, builtin_alarm_pcm, builtin_alarm_length);
+      cvt.buf = converted;
+      cvt.len = builtin_alarm_length;
+      if (SDL_ConvertAudio(&cvt) == 0) {
+        result = Mix_QuickLoad_RAW(converted, cvt.len_cvt);
+      }
+    }
+  }
+  if (result == NULL) {
+    LOG_Error("Failed to load built-in sound.\n");
+  }
+  return result;
+}
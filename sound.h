@@ -0,0 +1,43 @@
+/*
+ *  Alarm sound.  The audio subsystem is only brought up shortly before
+ *  it's needed and shut down again once the sound has finished.
+ */
+
+/*
+ *================================================================
+ *
+ *  Constants.
+ *
+ *================================================================
+ */
+
+#define SOUND_LEAD_TIME 30      /* Seconds before an alarm to get ready */
+
+/*
+ *  As used by clock.rb.  The built-in sound is decoded to match.
+ */
+#define AUDIO_FREQUENCY  22050
+#define AUDIO_CHANNELS   2
+#define AUDIO_CHUNK_SIZE 512
+
+/*
+ *================================================================
+ *
+ *  External declarations.
+ *
+ *================================================================
+ */
+
+extern void preload_sound(void);
+
+extern bool prepare_sound(void);
+
+extern bool sound_ready(void);
+
+extern void start_alarm_sound(void);
+
+extern void stop_alarm_sound(void);
+
+extern bool sound_playing(void);
+
+extern void release_sound(void);
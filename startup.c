@@ -0,0 +1,131 @@
+/*
+ *  Start-up timing.
+ */
+
+#include "includes.h"
+
+/*
+ *================================================================
+ *
+ *  Constants.
+ *
+ *================================================================
+ */
+
+#define MAX_PHASES 16
+
+/*
+ *================================================================
+ *
+ *  Type definitions.
+ *
+ *================================================================
+ */
+
+typedef struct {
+  const char *name;
+  double      began;          /* Milliseconds since startup_begin() */
+  double      ended;
+} t_phase;
+
+/*
+ *================================================================
+ *
+ *  Local data.
+ *
+ *================================================================
+ */
+
+static struct timespec zero;
+
+static t_phase phases[MAX_PHASES];
+static int     num_phases = 0;
+
+/*
+ *================================================================
+ *
+ *  Forward declarations.
+ *
+ *================================================================
+ */
+
+static double elapsed_ms(void);
+
+/*
+ *================================================================
+ *
+ *  Externally visible routines.
+ *
+ *================================================================
+ */
+
+void startup_begin(void) {
+  clock_gettime(CLOCK_MONOTONIC, &zero);
+  num_phases = 0;
+}
+
+int startup_phase_begin(const char *name) {
+  /*
+   * Returns a handle to pass to startup_phase_end(), or -1 if we've
+   * run out of room in which case the phase just isn't recorded.
+   */
+  int phase;
+
+  phase = __sync_fetch_and_add(&num_phases, 1);
+  if (phase >= MAX_PHASES) {
+    phase = -1;
+  } else {
+    phases[phase].name = name;
+    phases[phase].began = elapsed_ms();
+    phases[phase].ended = -1.0;
+  }
+  return phase;
+}
+
+void startup_phase_end(int phase) {
+  if ((phase >= 0) && (phase < MAX_PHASES)) {
+    phases[phase].ended = elapsed_ms();
+  }
+}
+
+void startup_report(int budget_ms) {
+  int     i;
+  t_phase *phase;
+  double  total = 0.0;
+
+  QLOG_Info(("Start-up times:\n"));
+  for (i = 0; (i < num_phases) && (i < MAX_PHASES); i++) {
+    phase = phases + i;
+    if (phase->ended >= 0.0) {
+      QLOG_Info(("  %-14s %8.1f ms  (%8.1f - %8.1f)\n",
+                 phase->name,
+                 phase->ended - phase->began,
+                 phase->began,
+                 phase->ended));
+      if (phase->ended > total) {
+        total = phase->ended;
+      }
+    }
+  }
+  QLOG_Info(("  %-14s %8.1f ms\n", "total", total));
+  if ((budget_ms > 0) && (total > budget_ms)) {
+    QLOG_Warning(("Start-up took %.1f ms - budget is %d ms.\n",
+                  total, budget_ms));
+  }
+}
+
+/*
+ *================================================================
+ *
+ *  Local routines.
+ *
+ *================================================================
+ */
+
+static double elapsed_ms(void) {
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return ((now.tv_sec - zero.tv_sec) * 1000.0) +
+         ((now.tv_nsec - zero.tv_nsec) / 1000000.0);
+}
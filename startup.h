@@ -0,0 +1,21 @@
+/*
+ *  Start-up timing.  Each phase of start-up is timed against a common
+ *  zero so that we can report where cold start goes and warn when it
+ *  runs over budget.
+ */
+
+/*
+ *================================================================
+ *
+ *  External declarations.
+ *
+ *================================================================
+ */
+
+extern void startup_begin(void);
+
+extern int startup_phase_begin(const char *name);
+
+extern void startup_phase_end(int phase);
+
+extern void startup_report(int budget_ms);
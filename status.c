@@ -0,0 +1,73 @@
+/*
+ *  Status page.  See status.h.
+ */
+
+#include "includes.h"
+
+/*
+ *================================================================
+ *
+ *  Local data.
+ *
+ *================================================================
+ */
+
+static t_status_page *page = NULL;
+
+/*
+ *================================================================
+ *
+ *  Externally visible routines.
+ *
+ *================================================================
+ */
+
+void status_open(void) {
+  /*
+   * The page is created afresh each time.  Readers can tell it's
+   * ready from the magic number, which goes in last.
+   */
+  int   fd;
+  void *map = MAP_FAILED;
+
+  fd = open(get_status_page(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if ((fd >= 0) && (ftruncate(fd, sizeof(t_status_page)) == 0)) {
+    map = mmap(NULL, sizeof(t_status_page), PROT_READ | PROT_WRITE,
+               MAP_SHARED, fd, 0);
+  }
+  if (fd >= 0) {
+    close(fd);
+  }
+  if (map == MAP_FAILED) {
+    LOG_Error("Failed to set up status page \"%s\".\n", get_status_page());
+  } else {
+    page = map;
+    page->version = STATUS_VERSION;
+    page->sequence = 0;
+    page->status.next_alarm_id = -1;
+    __sync_synchronize();
+    memcpy(page->magic, STATUS_MAGIC, STATUS_MAGIC_LEN);
+  }
+}
+
+void status_close(void) {
+  if (page != NULL) {
+    munmap(page, sizeof(t_status_page));
+    page = NULL;
+    unlink(get_status_page());
+  }
+}
+
+void status_publish(const t_status *status) {
+  /*
+   * Only ever called from the main loop, so there's just the one
+   * writer.
+   */
+  if (page != NULL) {
+    page->sequence++;
+    __sync_synchronize();
+    page->status = *status;
+    __sync_synchronize();
+    page->sequence++;
+  }
+}
@@ -0,0 +1,69 @@
+/*
+ *  Status page.  The clock publishes its state in a small shared
+ *  memory file (see the status_page setting) for monitoring programs
+ *  to read without asking it anything.  The file holds one
+ *  t_status_page, laid out exactly as below.
+ *
+ *  It's updated under a sequence lock.  The writer makes sequence odd,
+ *  writes the status and then makes sequence even again, so a reader
+ *  gets a consistent copy with no locking and no system calls by:
+ *
+ *    do {
+ *      before = page->sequence;
+ *      (memory barrier)
+ *      copy = page->status;
+ *      (memory barrier)
+ *    } while ((before & 1) || (page->sequence != before));
+ */
+
+/*
+ *================================================================
+ *
+ *  Constants.
+ *
+ *================================================================
+ */
+
+#define STATUS_MAGIC     "ACSTATUS"
+#define STATUS_MAGIC_LEN 8
+#define STATUS_VERSION   1
+
+/*
+ *================================================================
+ *
+ *  Type definitions.
+ *
+ *================================================================
+ */
+
+typedef struct {
+  long next_alarm;            /* time_t, or 0 for none */
+  int  next_alarm_id;         /* -1 for none */
+  int  dimmed;
+  int  brightness;            /* As currently shown, 0 - 255 */
+  int  sounding;
+  long last_frame;            /* time_t of the last present ... */
+  long last_frame_ns;         /* ... and nanoseconds into that second */
+  long frames;                /* Presented since start-up */
+} t_status;
+
+typedef struct {
+  char                  magic[STATUS_MAGIC_LEN];
+  int                   version;
+  volatile unsigned int sequence;
+  t_status              status;
+} t_status_page;
+
+/*
+ *================================================================
+ *
+ *  External declarations.
+ *
+ *================================================================
+ */
+
+extern void status_open(void);
+
+extern void status_close(void);
+
+extern void status_publish(const t_status *status);
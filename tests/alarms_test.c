@@ -0,0 +1,253 @@
+/*
+ *  Runs a daily alarm through 2024 under the virtual clock in zones
+ *  where it falls in the hour the clocks skip or repeat, a quarter of
+ *  an hour at a time.  Checks that it goes off exactly once a day, at
+ *  the earliest moment its local time has been reached - the jump on
+ *  the day the clocks go forward, the first time round on the day they
+ *  go back - and that working its next time out afresh at any moment,
+ *  as after a restart, agrees.
+ *
+ *  Exits non-zero if anything disagrees.
+ */
+
+#include "../includes.h"
+
+/*
+ *================================================================
+ *
+ *  Constants.
+ *
+ *================================================================
+ */
+
+#define SWEEP_STEP   (15 * 60)        /* Transitions fall on a quarter */
+#define SWEEP_YEAR   2024
+#define MAX_DAYS     367              /* And the first of the next year */
+#define MAX_REPORTED 10               /* Failures shown per zone */
+
+/*
+ *================================================================
+ *
+ *  Type definitions.
+ *
+ *================================================================
+ */
+
+typedef struct {
+  const char *zone;
+  int         trigger_time;
+  time_t      spring_forward;         /* When it goes off on those days */
+  time_t      fall_back;
+} t_dst_case;
+
+/*
+ *================================================================
+ *
+ *  Local data.
+ *
+ *================================================================
+ */
+
+static const t_dst_case cases[] = {
+  {"Europe/London",    (1 * 60 + 30) * 60, 1711846800, 1729989000},
+  {"America/New_York", (2 * 60 + 30) * 60, 1710054000, 1730619000}
+};
+
+#define NUM_CASES ((int) (sizeof(cases) / sizeof(cases[0])))
+
+static time_t expected[MAX_DAYS];     /* Going off, by day of the year */
+static int    fired[MAX_DAYS];
+static time_t fired_at[MAX_DAYS];
+
+static int failures;                  /* In the current zone */
+
+/*
+ *================================================================
+ *
+ *  Forward declarations.
+ *
+ *================================================================
+ */
+
+static void sweep_case(const t_dst_case *dst_case);
+
+static void expect_times(int trigger_time, time_t start, int days);
+
+static int day_of_year(time_t when);
+
+static void check_day(const char *what, int day, time_t wanted);
+
+static void fail(const char *what, time_t when, long got, long wanted);
+
+/*
+ *================================================================
+ *
+ *  Stand-ins.
+ *
+ *================================================================
+ */
+
+const char *get_state_journal(void) {
+  /*
+   * journal.o is only linked for alarms.o - nothing's journalled.
+   */
+  return "";
+}
+
+/*
+ *================================================================
+ *
+ *  Main.
+ *
+ *================================================================
+ */
+
+int main(int argc, char **argv) {
+  int i;
+  int result = EXIT_SUCCESS;
+
+  for (i = 0; i < NUM_CASES; i++) {
+    sweep_case(cases + i);
+    printf("alarms_test: %-20s %02d:%02d daily, %d failures\n",
+           cases[i].zone,
+           cases[i].trigger_time / 3600,
+           (cases[i].trigger_time / 60) % 60,
+           failures);
+    if (failures > 0) {
+      result = EXIT_FAILURE;
+    }
+  }
+  return result;
+}
+
+/*
+ *================================================================
+ *
+ *  Local routines.
+ *
+ *================================================================
+ */
+
+static void sweep_case(const t_dst_case *dst_case) {
+  t_individual_alarm alarm;
+  int                day;
+  int                days;
+  bool               due[MAX_DISPLAYS];
+  time_t             end;
+  int                id;
+  int                next;
+  time_t             previous;
+  time_t             start;
+  struct tm          tm;
+  time_t             when;
+
+  setenv("TZ", dst_case->zone, 1);
+  tzset();
+  zone_reset();
+  failures = 0;
+  memset(&tm, 0, sizeof(tm));
+  tm.tm_year = SWEEP_YEAR - 1900;
+  tm.tm_mday = 1;
+  tm.tm_isdst = -1;
+  start = mktime(&tm);
+  tm.tm_year++;
+  tm.tm_isdst = -1;
+  end = mktime(&tm);
+  days = day_of_year(end - 1) + 1;
+  expect_times(dst_case->trigger_time, start, days + 1);
+  memset(fired, 0, sizeof(fired));
+  vclock_set(start);
+  memset(&alarm, 0, sizeof(alarm));
+  recurrence_init(&alarm.rule);
+  alarm.trigger_time = dst_case->trigger_time;
+  for (day = 0; day < 7; day++) {
+    alarm.days[day] = TRUE;
+  }
+  id = add_alarm(alarm);
+  next = 0;
+  previous = start;
+  for (when = start; when < end; when += SWEEP_STEP) {
+    vclock_set(when);
+    if (alarms_due(previous, when, due) && due[0]) {
+      day = day_of_year(when);
+      fired[day]++;
+      fired_at[day] = when;
+    }
+    /*
+     * As if we'd just started up.  Nothing's due now, so this doesn't
+     * lose anything.
+     */
+    resume_alarms(when);
+    while (expected[next] <= when) {
+      next++;
+    }
+    if (seconds_until_next_alarm(0, when) != expected[next] - when) {
+      fail("next alarm afresh",
+           when,
+           seconds_until_next_alarm(0, when),
+           expected[next] - when);
+    }
+    previous = when;
+  }
+  remove_alarm(id);
+  for (day = 0; day < days; day++) {
+    if (fired[day] != 1) {
+      fail("times gone off", expected[day], fired[day], 1);
+    } else if (fired_at[day] != expected[day]) {
+      fail("went off", expected[day], fired_at[day], expected[day]);
+    }
+  }
+  check_day("spring forward", day_of_year(dst_case->spring_forward),
+            dst_case->spring_forward);
+  check_day("fall back", day_of_year(dst_case->fall_back),
+            dst_case->fall_back);
+}
+
+
+static void expect_times(int trigger_time, time_t start, int days) {
+  /*
+   * For each day, the first quarter of an hour at which the local time
+   * has reached the alarm's, worked out from the C library.
+   */
+  int       day = 0;
+  struct tm tm;
+  time_t    when;
+
+  for (when = start; day < days; when += SWEEP_STEP) {
+    localtime_r(&when, &tm);
+    if ((tm.tm_yday + (tm.tm_year - (SWEEP_YEAR - 1900)) * 366 == day) &&
+        ((tm.tm_hour * 60 + tm.tm_min) * 60 >= trigger_time)) {
+      expected[day++] = when;
+    }
+  }
+}
+
+
+static int day_of_year(time_t when) {
+  struct tm tm;
+
+  localtime_r(&when, &tm);
+  return tm.tm_yday;
+}
+
+
+static void check_day(const char *what, int day, time_t wanted) {
+  if (expected[day] != wanted) {
+    fail(what, wanted, expected[day], wanted);
+  }
+  if (fired_at[day] != wanted) {
+    fail(what, wanted, fired_at[day], wanted);
+  }
+}
+
+
+static void fail(const char *what, time_t when, long got, long wanted) {
+  if (failures < MAX_REPORTED) {
+    printf("alarms_test: %s at %ld gave %ld, wanted %ld\n",
+           what,
+           (long) when,
+           got,
+           wanted);
+  }
+  failures++;
+}
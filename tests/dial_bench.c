@@ -0,0 +1,176 @@
+/*
+ *  Times painting the analogue dial (see dial.h) into a hidden window
+ *  on the software renderer, as a headless run does - a minute of
+ *  frames with the second hand ticking once a second and the same
+ *  sweeping at 30 fps.  A frame is the clear, the dial and hands, and
+ *  the present.
+ */
+
+#define NEED_SDL
+#include "../includes.h"
+
+/*
+ *================================================================
+ *
+ *  Constants.
+ *
+ *================================================================
+ */
+
+#define WINDOW_WIDTH  1920
+#define WINDOW_HEIGHT 1080
+#define DIAL_DIAMETER (WINDOW_HEIGHT * 75 / 100)    /* As clock.c */
+#define CLOCK_SECONDS 60
+#define START_TIME    1718000040
+
+/*
+ *================================================================
+ *
+ *  Local data.
+ *
+ *================================================================
+ */
+
+static const int fps_settings[] = {
+  1,
+  30
+};
+
+#define NUM_SETTINGS ((int) (sizeof(fps_settings) / sizeof(fps_settings[0])))
+
+/*
+ *================================================================
+ *
+ *  Forward declarations.
+ *
+ *================================================================
+ */
+
+static double time_frames(SDL_Renderer *renderer, int fps);
+
+/*
+ *================================================================
+ *
+ *  Stand-ins.
+ *
+ *================================================================
+ */
+
+t_box size_face_text(
+    t_face       face,
+    const char  *text) {
+  /*
+   * The numerals are drawn once into the dial's texture, outside the
+   * timing, so fonts.o isn't needed for them.
+   */
+  t_box result;
+
+  result.width = 0;
+  result.height = 0;
+  return result;
+}
+
+void paint_face_text(
+    SDL_Renderer *renderer,
+    const char  *text,
+    t_face       face,
+    t_href       href,
+    t_vref       vref,
+    int          hoff,
+    int          voff,
+    int          density) {
+}
+
+/*
+ *================================================================
+ *
+ *  Main.
+ *
+ *================================================================
+ */
+
+int main(int argc, char **argv) {
+  int           i;
+  SDL_Renderer *renderer = NULL;
+  int           result = EXIT_FAILURE;
+  double        seconds;
+  SDL_Window   *window;
+
+  SDL_setenv("SDL_VIDEODRIVER", "offscreen", 0);
+  if (SDL_Init(SDL_INIT_VIDEO) != 0) {
+    printf("dial_bench: %s\n", SDL_GetError());
+  } else {
+    window = SDL_CreateWindow("dial_bench",
+                              SDL_WINDOWPOS_CENTERED,
+                              SDL_WINDOWPOS_CENTERED,
+                              WINDOW_WIDTH,
+                              WINDOW_HEIGHT,
+                              SDL_WINDOW_HIDDEN);
+    if (window != NULL) {
+      renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_SOFTWARE);
+    }
+    if (renderer == NULL) {
+      printf("dial_bench: %s\n", SDL_GetError());
+    } else {
+      build_dial(renderer, DIAL_DIAMETER, 0);
+      for (i = 0; i < NUM_SETTINGS; i++) {
+        seconds = time_frames(renderer, fps_settings[i]);
+        printf("dial_bench: second_hand_fps %2d %8.1f us a frame  "
+               "%6.1f ms a second\n",
+               fps_settings[i],
+               seconds * 1e6 / (CLOCK_SECONDS * fps_settings[i]),
+               seconds * 1e3 / CLOCK_SECONDS);
+      }
+      release_dial();
+      SDL_DestroyRenderer(renderer);
+      result = EXIT_SUCCESS;
+    }
+    if (window != NULL) {
+      SDL_DestroyWindow(window);
+    }
+    SDL_Quit();
+  }
+  return result;
+}
+
+/*
+ *================================================================
+ *
+ *  Local routines.
+ *
+ *================================================================
+ */
+
+static double time_frames(SDL_Renderer *renderer, int fps) {
+  /*
+   * A minute's worth of frames, with the second hand wherever a run at
+   * that setting would put it.
+   */
+  struct timespec finished;
+  int             frame;
+  time_t          now;
+  struct timespec started;
+  struct tm       tm;
+
+  now = START_TIME;
+  localtime_r(&now, &tm);
+  clock_gettime(CLOCK_MONOTONIC, &started);
+  for (frame = 0; frame < CLOCK_SECONDS * fps; frame++) {
+    tm.tm_sec = frame / fps;
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+    SDL_RenderClear(renderer);
+    batch_begin(renderer);
+    paint_dial(renderer,
+               (WINDOW_WIDTH - DIAL_DIAMETER) / 2,
+               (WINDOW_HEIGHT - DIAL_DIAMETER) / 4,
+               DIAL_DIAMETER,
+               &tm,
+               (double) frame / fps,
+               255);
+    batch_end();
+    SDL_RenderPresent(renderer);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &finished);
+  return (finished.tv_sec - started.tv_sec) +
+         (finished.tv_nsec - started.tv_nsec) / 1e9;
+}
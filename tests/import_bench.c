@@ -0,0 +1,220 @@
+/*
+ *  Times bulk alarm imports (see import.h) - a rota's worth of lines
+ *  from CSV and the same from iCalendar.  The alarm pool only holds
+ *  MAX_ALARMS, so each is read as several files, with the pool emptied
+ *  between them outside the timing.
+ */
+
+#include "../includes.h"
+
+/*
+ *================================================================
+ *
+ *  Constants.
+ *
+ *================================================================
+ */
+
+#define BATCH_ALARMS 10000            /* Per file - under MAX_ALARMS */
+#define NUM_BATCHES  10
+
+/*
+ *================================================================
+ *
+ *  Local data.
+ *
+ *================================================================
+ */
+
+static const char *day_names[] = {
+  "Sunday",
+  "Monday",
+  "Tuesday",
+  "Wednesday",
+  "Thursday",
+  "Friday",
+  "Saturday"
+};
+
+static const char *ical_days[] = {
+  "SU",
+  "MO",
+  "TU",
+  "WE",
+  "TH",
+  "FR",
+  "SA"
+};
+
+/*
+ *================================================================
+ *
+ *  Forward declarations.
+ *
+ *================================================================
+ */
+
+static bool write_csv(const char *file_name, int year);
+
+static bool write_ical(const char *file_name, int year);
+
+static double time_import(const char *file_name);
+
+static void remove_all(void);
+
+/*
+ *================================================================
+ *
+ *  Stand-ins.
+ *
+ *================================================================
+ */
+
+const char *get_state_journal(void) {
+  /*
+   * journal.o is only linked for alarms.o - nothing's journalled.
+   */
+  return "";
+}
+
+/*
+ *================================================================
+ *
+ *  Main.
+ *
+ *================================================================
+ */
+
+int main(int argc, char **argv) {
+  char       csv[64];
+  char       directory[] = "/tmp/import_benchXXXXXX";
+  char       ical[64];
+  time_t     now;
+  int        result = EXIT_FAILURE;
+  double     seconds;
+  struct tm  tm;
+
+  now = time(NULL);
+  localtime_r(&now, &tm);
+  if (mkdtemp(directory) == NULL) {
+    perror("import_bench: mkdtemp");
+  } else {
+    sprintf(csv, "%s/rota.csv", directory);
+    sprintf(ical, "%s/rota.ics", directory);
+    if (write_csv(csv, tm.tm_year + 1901) &&
+        write_ical(ical, tm.tm_year + 1901)) {
+      seconds = time_import(csv);
+      printf("import_bench: CSV       %d lines in %.3fs - %.0f a second\n",
+             BATCH_ALARMS * NUM_BATCHES,
+             seconds,
+             BATCH_ALARMS * NUM_BATCHES / seconds);
+      seconds = time_import(ical);
+      printf("import_bench: iCalendar %d events in %.3fs - %.0f a second\n",
+             BATCH_ALARMS * NUM_BATCHES,
+             seconds,
+             BATCH_ALARMS * NUM_BATCHES / seconds);
+      result = EXIT_SUCCESS;
+    } else {
+      perror("import_bench: writing");
+    }
+    unlink(csv);
+    unlink(ical);
+    rmdir(directory);
+  }
+  return result;
+}
+
+/*
+ *================================================================
+ *
+ *  Local routines.
+ *
+ *================================================================
+ */
+
+static bool write_csv(const char *file_name, int year) {
+  /*
+   * A mixture of weekly alarms and one-offs, as a rota would have.
+   */
+  FILE *file;
+  int   i;
+  bool  result = FALSE;
+
+  file = fopen(file_name, "w");
+  if (file != NULL) {
+    fprintf(file, "# time,days,display,date\n");
+    for (i = 0; i < BATCH_ALARMS; i++) {
+      if (i % 3 == 0) {
+        fprintf(file, "%02d:%02d,%s %s,%d\n",
+                i % 24, i % 60,
+                day_names[i % 7], day_names[(i / 7) % 7],
+                i % 2);
+      } else {
+        fprintf(file, "%02d:%02d:%02d,,%d,%04d-%02d-%02d\n",
+                i % 24, i % 60, i % 59,
+                i % 2,
+                year, (i % 12) + 1, (i % 28) + 1);
+      }
+    }
+    result = (fclose(file) == 0);
+  }
+  return result;
+}
+
+
+static bool write_ical(const char *file_name, int year) {
+  FILE *file;
+  int   i;
+  bool  result = FALSE;
+
+  file = fopen(file_name, "w");
+  if (file != NULL) {
+    fprintf(file, "BEGIN:VCALENDAR\r\nVERSION:2.0\r\n");
+    for (i = 0; i < BATCH_ALARMS; i++) {
+      fprintf(file, "BEGIN:VEVENT\r\nUID:%d@rota\r\n", i);
+      fprintf(file, "DTSTART:%04d%02d%02dT%02d%02d00\r\n",
+              year, (i % 12) + 1, (i % 28) + 1, i % 24, i % 60);
+      fprintf(file, "SUMMARY:Shift %d with a description long enough to "
+                    "be fol\r\n ded over the line\r\n", i);
+      if (i % 3 == 0) {
+        fprintf(file, "RRULE:FREQ=WEEKLY;BYDAY=%s,%s\r\n",
+                ical_days[i % 7], ical_days[(i / 7) % 7]);
+      }
+      fprintf(file, "END:VEVENT\r\n");
+    }
+    fprintf(file, "END:VCALENDAR\r\n");
+    result = (fclose(file) == 0);
+  }
+  return result;
+}
+
+
+static double time_import(const char *file_name) {
+  int             batch;
+  struct timespec finished;
+  double          result = 0.0;
+  struct timespec started;
+
+  for (batch = 0; batch < NUM_BATCHES; batch++) {
+    clock_gettime(CLOCK_MONOTONIC, &started);
+    import_alarms(file_name);
+    clock_gettime(CLOCK_MONOTONIC, &finished);
+    result += (finished.tv_sec - started.tv_sec) +
+              ((finished.tv_nsec - started.tv_nsec) / 1e9);
+    if (alarm_count() != BATCH_ALARMS) {
+      printf("import_bench: %s gave %d alarms, not %d\n",
+             file_name,
+             alarm_count(),
+             BATCH_ALARMS);
+    }
+    remove_all();
+  }
+  return result;
+}
+
+
+static void remove_all(void) {
+  while (alarm_count() > 0) {
+    remove_alarm(alarm_at(alarm_count() - 1)->id);
+  }
+}
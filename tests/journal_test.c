@@ -0,0 +1,190 @@
+/*
+ *  Checks that the state journal puts a skipped alarm back the way it
+ *  was after a restart - onto the same alarm even when the alarms are
+ *  loaded in a different order, and not at all once the alarm has been
+ *  changed - and that this survives the journal being compacted.
+ *
+ *  Exits non-zero if anything disagrees.
+ */
+
+#include "../includes.h"
+
+/*
+ *================================================================
+ *
+ *  Constants.
+ *
+ *================================================================
+ */
+
+#define START_TIME  1718000000        /* 06:13 UTC */
+#define NUM_TIMES   3
+#define SNOOZES     600               /* Over COMPACT_AFTER records */
+#define MIN_RECORD  16                /* Bytes */
+
+/*
+ *================================================================
+ *
+ *  Local data.
+ *
+ *================================================================
+ */
+
+static char journal_name[PATH_MAX + 1];
+
+static int failures = 0;
+
+/*
+ *================================================================
+ *
+ *  Forward declarations.
+ *
+ *================================================================
+ */
+
+static void load(const int *times, int first);
+
+static void remove_all(void);
+
+static void restart(const int *times, int first);
+
+static void expect_next(const char *what, int trigger_time);
+
+/*
+ *================================================================
+ *
+ *  Stand-ins.
+ *
+ *================================================================
+ */
+
+const char *get_state_journal(void) {
+  return journal_name;
+}
+
+/*
+ *================================================================
+ *
+ *  Main.
+ *
+ *================================================================
+ */
+
+int main(int argc, char **argv) {
+  char             directory[] = "/tmp/journal_testXXXXXX";
+  int              i;
+  static const int original[NUM_TIMES] = {7 * 3600, 8 * 3600, 9 * 3600};
+  static const int changed[NUM_TIMES] = {7 * 3600 + 1800, 8 * 3600,
+                                         9 * 3600};
+  int              result = EXIT_FAILURE;
+  struct stat      status;
+
+  setenv("TZ", "UTC", 1);
+  tzset();
+  vclock_set(START_TIME);
+  if (mkdtemp(directory) == NULL) {
+    perror("journal_test: mkdtemp");
+  } else {
+    sprintf(journal_name, "%s/state", directory);
+    load(original, 0);
+    journal_open();
+    skip_next_alarm(0);
+    expect_next("after skipping", 8 * 3600);
+    /*
+     * Loaded the other way round, the alarms get different ids.
+     */
+    restart(original, NUM_TIMES - 1);
+    expect_next("reloaded in another order", 8 * 3600);
+    /*
+     * Enough records to make the journal compact itself.
+     */
+    for (i = 0; i < SNOOZES; i++) {
+      snooze_alarm(0, START_TIME + 600);
+      cancel_snooze(0);
+    }
+    if ((stat(journal_name, &status) != 0) ||
+        (status.st_size >= 2 * SNOOZES * MIN_RECORD)) {
+      printf("journal_test: journal wasn't compacted\n");
+      failures++;
+    }
+    restart(original, 0);
+    expect_next("after compacting", 8 * 3600);
+    /*
+     * The skipped alarm now goes off half an hour later, so it's not
+     * the one which was skipped.
+     */
+    restart(changed, 0);
+    expect_next("with the alarm changed", 7 * 3600 + 1800);
+    journal_close();
+    remove_all();
+    unlink(journal_name);
+    rmdir(directory);
+    printf("journal_test: %d failures\n", failures);
+    if (failures == 0) {
+      result = EXIT_SUCCESS;
+    }
+  }
+  return result;
+}
+
+/*
+ *================================================================
+ *
+ *  Local routines.
+ *
+ *================================================================
+ */
+
+static void load(const int *times, int first) {
+  /*
+   * Daily alarms at the given times, starting with times[first] and
+   * going round.
+   */
+  t_individual_alarm alarm;
+  int                day;
+  int                i;
+
+  for (i = 0; i < NUM_TIMES; i++) {
+    memset(&alarm, 0, sizeof(alarm));
+    recurrence_init(&alarm.rule);
+    alarm.trigger_time = times[(first + i) % NUM_TIMES];
+    for (day = 0; day < 7; day++) {
+      alarm.days[day] = TRUE;
+    }
+    alarm.display = 0;
+    add_alarm(alarm);
+  }
+}
+
+
+static void remove_all(void) {
+  while (alarm_count() > 0) {
+    remove_alarm(alarm_at(alarm_count() - 1)->id);
+  }
+}
+
+
+static void restart(const int *times, int first) {
+  journal_close();
+  remove_all();
+  load(times, first);
+  journal_open();
+}
+
+
+static void expect_next(const char *what, int trigger_time) {
+  /*
+   * All of them are still to come today.
+   */
+  int wanted;
+
+  wanted = (START_TIME / SECONDS_PER_DAY) * SECONDS_PER_DAY +
+           trigger_time - START_TIME;
+  if (seconds_until_next_alarm(0, START_TIME) != wanted) {
+    printf("journal_test: %s, next alarm in %d s, wanted %d s\n",
+           what,
+           seconds_until_next_alarm(0, START_TIME),
+           wanted);
+    failures++;
+  }
+}
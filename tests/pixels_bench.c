@@ -0,0 +1,105 @@
+/*
+ *  Times each pixel kernel this machine can run against the plain C
+ *  one, expanding a screenful of glyph rows over and over.
+ */
+
+#define NEED_SDL
+#include "../includes.h"
+
+/*
+ *================================================================
+ *
+ *  Constants.
+ *
+ *================================================================
+ */
+
+#define ROW_PIXELS 1024
+#define ROWS       600
+#define REPEATS    50
+
+/*
+ *================================================================
+ *
+ *  Local data.
+ *
+ *================================================================
+ */
+
+static const char *kernels[] = {
+  "scalar",
+  "SSE2",
+  "AVX2",
+  "NEON"
+};
+
+#define NUM_KERNELS ((int) (sizeof(kernels) / sizeof(kernels[0])))
+
+static Uint8  source[ROW_PIXELS];
+static Uint32 destination[ROWS][ROW_PIXELS];
+
+/*
+ *================================================================
+ *
+ *  Forward declarations.
+ *
+ *================================================================
+ */
+
+static double time_expand(void);
+
+/*
+ *================================================================
+ *
+ *  Main.
+ *
+ *================================================================
+ */
+
+int main(int argc, char **argv) {
+  int    i;
+  double scalar = 0.0;
+  double seconds;
+
+  for (i = 0; i < ROW_PIXELS; i++) {
+    source[i] = ((i % 5) < 2) ? 0 : (Uint8) i;
+  }
+  for (i = 0; i < NUM_KERNELS; i++) {
+    if (pixels_use_kernel(kernels[i])) {
+      seconds = time_expand();
+      if (i == 0) {
+        scalar = seconds;
+      }
+      printf("pixels_bench: %-6s %8.2f Mpixel/s  %5.2fx\n",
+             kernels[i],
+             (double) ROW_PIXELS * ROWS * REPEATS / seconds / 1e6,
+             scalar / seconds);
+    }
+  }
+  return EXIT_SUCCESS;
+}
+
+/*
+ *================================================================
+ *
+ *  Local routines.
+ *
+ *================================================================
+ */
+
+static double time_expand(void) {
+  struct timespec finished;
+  int             repeat;
+  int             row;
+  struct timespec started;
+
+  clock_gettime(CLOCK_MONOTONIC, &started);
+  for (repeat = 0; repeat < REPEATS; repeat++) {
+    for (row = 0; row < ROWS; row++) {
+      pixels_expand(destination[row], source, ROW_PIXELS, 0xffffffff);
+    }
+  }
+  clock_gettime(CLOCK_MONOTONIC, &finished);
+  return (finished.tv_sec - started.tv_sec) +
+         ((finished.tv_nsec - started.tv_nsec) / 1e9);
+}
@@ -0,0 +1,139 @@
+/*
+ *  Checks that every pixel kernel this machine can run gives exactly
+ *  what the plain C one does - over every row length up to a few
+ *  vectors' worth, at each alignment, with background scattered among
+ *  glyph bytes of all sorts.
+ *
+ *  Exits non-zero if anything disagrees.
+ */
+
+#define NEED_SDL
+#include "../includes.h"
+
+/*
+ *================================================================
+ *
+ *  Constants.
+ *
+ *================================================================
+ */
+
+#define MAX_COUNT   200               /* Pixels in a row */
+#define MAX_SHIFT   4                 /* Alignments tried */
+#define NUM_COLOURS 3
+
+/*
+ *================================================================
+ *
+ *  Local data.
+ *
+ *================================================================
+ */
+
+static const char *kernels[] = {
+  "SSE2",
+  "AVX2",
+  "NEON"
+};
+
+#define NUM_KERNELS ((int) (sizeof(kernels) / sizeof(kernels[0])))
+
+static const Uint32 colours[NUM_COLOURS] = {
+  0xffffffff,
+  0x80402010,
+  0x00000001
+};
+
+static Uint8  source[MAX_COUNT + MAX_SHIFT];
+static Uint32 wanted[MAX_COUNT + MAX_SHIFT + 1];
+static Uint32 got[MAX_COUNT + MAX_SHIFT + 1];
+
+/*
+ *================================================================
+ *
+ *  Forward declarations.
+ *
+ *================================================================
+ */
+
+static int check_expand(const char *kernel);
+
+/*
+ *================================================================
+ *
+ *  Main.
+ *
+ *================================================================
+ */
+
+int main(int argc, char **argv) {
+  int failures;
+  int i;
+  int result = EXIT_SUCCESS;
+
+  /*
+   * Runs of background among all the other values, so that both the
+   * vector loops and the tails see a mixture.
+   */
+  for (i = 0; i < MAX_COUNT + MAX_SHIFT; i++) {
+    source[i] = ((i % 7) < 3) ? 0 : (Uint8) (i * 37);
+  }
+  for (i = 0; i < NUM_KERNELS; i++) {
+    if (!pixels_use_kernel(kernels[i])) {
+      printf("pixels_test: %-6s not available here\n", kernels[i]);
+    } else {
+      failures = check_expand(kernels[i]);
+      printf("pixels_test: %-6s %d failures\n", kernels[i], failures);
+      if (failures > 0) {
+        result = EXIT_FAILURE;
+      }
+    }
+  }
+  return result;
+}
+
+/*
+ *================================================================
+ *
+ *  Local routines.
+ *
+ *================================================================
+ */
+
+static int check_expand(const char *kernel) {
+  /*
+   * The row is followed by a guard pixel, which mustn't be touched.
+   */
+  int colour;
+  int count;
+  int result = 0;
+  int shift;
+
+  for (colour = 0; colour < NUM_COLOURS; colour++) {
+    for (shift = 0; shift < MAX_SHIFT; shift++) {
+      for (count = 0; count <= MAX_COUNT; count++) {
+        memset(wanted, 0x5a, sizeof(wanted));
+        memset(got, 0x5a, sizeof(got));
+        pixels_use_kernel("scalar");
+        pixels_expand(wanted + shift,
+                      source + shift,
+                      count,
+                      colours[colour]);
+        pixels_use_kernel(kernel);
+        pixels_expand(got + shift, source + shift, count, colours[colour]);
+        if (memcmp(wanted, got, sizeof(wanted)) != 0) {
+          if (result == 0) {
+            printf("pixels_test: %s differs - %d pixels from %d, "
+                   "colour %08lx\n",
+                   kernel,
+                   count,
+                   shift,
+                   (unsigned long) colours[colour]);
+          }
+          result++;
+        }
+      }
+    }
+  }
+  return result;
+}
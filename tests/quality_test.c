@@ -0,0 +1,181 @@
+/*
+ *  Checks the render-quality governor's choices (see quality.h) -
+ *  Solid while animating or with no budget, Blended within it, back to
+ *  Solid once frames have been running over and Blended again once
+ *  they've come back under - and that quality_spare() won't start a
+ *  step which would take the pass over.  The CPU a pass uses is real,
+ *  burnt in a loop.
+ *
+ *  Exits non-zero if anything disagrees.
+ */
+
+#include "../includes.h"
+
+/*
+ *================================================================
+ *
+ *  Constants.
+ *
+ *================================================================
+ */
+
+#define SLOW_FRAMES 16
+#define FAST_FRAMES 40
+
+/*
+ *================================================================
+ *
+ *  Local data.
+ *
+ *================================================================
+ */
+
+static int budget_ms;
+
+static int failures = 0;
+
+static const char *quality_names[] = {
+  "Solid",
+  "Blended"
+};
+
+/*
+ *================================================================
+ *
+ *  Forward declarations.
+ *
+ *================================================================
+ */
+
+static void frame(long cpu_us);
+
+static void burn(long cpu_us);
+
+static void expect(const char *what, t_render_quality wanted);
+
+static void expect_spare(const char *what, bool wanted);
+
+/*
+ *================================================================
+ *
+ *  Stand-ins.
+ *
+ *================================================================
+ */
+
+int get_render_budget(void) {
+  return budget_ms;
+}
+
+/*
+ *================================================================
+ *
+ *  Main.
+ *
+ *================================================================
+ */
+
+int main(int argc, char **argv) {
+  int i;
+
+  quality_init();
+  budget_ms = 20;
+  quality_pass_begin(TRUE);
+  expect("while animating", rq_solid);
+  quality_pass_end(FALSE);
+  budget_ms = 0;
+  quality_pass_begin(FALSE);
+  expect("with no budget", rq_solid);
+  quality_pass_end(FALSE);
+  budget_ms = 20;
+  quality_pass_begin(FALSE);
+  expect("within budget", rq_blended);
+  burn(30000);
+  expect("once the pass has spent its budget", rq_solid);
+  quality_pass_end(FALSE);
+  /*
+   * Frames of 6 ms against 2 ms pull the average over, after which a
+   * pass goes Solid from the start.
+   */
+  budget_ms = 2;
+  for (i = 0; i < SLOW_FRAMES; i++) {
+    frame(6000);
+  }
+  quality_pass_begin(FALSE);
+  expect("after frames over budget", rq_solid);
+  quality_pass_end(FALSE);
+  for (i = 0; i < FAST_FRAMES; i++) {
+    frame(0);
+  }
+  quality_pass_begin(FALSE);
+  expect("once frames are back under budget", rq_blended);
+  quality_pass_end(FALSE);
+  /*
+   * A 6 ms step with 10 ms to spend leaves room for another only if
+   * it would take no longer than the last.
+   */
+  budget_ms = 10;
+  quality_pass_begin(FALSE);
+  expect_spare("at the start of a pass", TRUE);
+  burn(6000);
+  expect_spare("when another step would overrun", FALSE);
+  expect("after a step which left some budget", rq_blended);
+  quality_pass_end(FALSE);
+  printf("quality_test: %d failures\n", failures);
+  return (failures == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*
+ *================================================================
+ *
+ *  Local routines.
+ *
+ *================================================================
+ */
+
+static void frame(long cpu_us) {
+  quality_pass_begin(FALSE);
+  burn(cpu_us);
+  quality_pass_end(TRUE);
+}
+
+
+static void burn(long cpu_us) {
+  struct timespec began;
+  long            elapsed;
+  struct timespec now;
+
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &began);
+  do {
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    elapsed = ((now.tv_sec - began.tv_sec) * 1000000L) +
+              ((now.tv_nsec - began.tv_nsec) / 1000L);
+  } while (elapsed < cpu_us);
+}
+
+
+static void expect(const char *what, t_render_quality wanted) {
+  t_render_quality got;
+
+  got = quality_choose();
+  if (got != wanted) {
+    printf("quality_test: %s, chose %s, wanted %s\n",
+           what,
+           quality_names[got],
+           quality_names[wanted]);
+    failures++;
+  }
+}
+
+
+static void expect_spare(const char *what, bool wanted) {
+  bool got;
+
+  got = quality_spare();
+  if (got != wanted) {
+    printf("quality_test: %s, quality_spare() gave %s\n",
+           what,
+           got ? "TRUE" : "FALSE");
+    failures++;
+  }
+}
@@ -0,0 +1,181 @@
+/*
+ *  Checks that each individual setting can be given in config.yaml -
+ *  parse_config() gives up on any keyword it doesn't know what to do
+ *  with - and comes back out of its get_ routine.
+ *
+ *  Exits non-zero if anything disagrees.
+ */
+
+#include "../includes.h"
+
+/*
+ *================================================================
+ *
+ *  Type definitions.
+ *
+ *================================================================
+ */
+
+typedef struct {
+  const char  *keyword;
+  const char  *value;               /* Not the default */
+  int        (*get_int)(void);      /* One or the other */
+  const char *(*get_string)(void);
+} t_setting_check;
+
+/*
+ *================================================================
+ *
+ *  Local data.
+ *
+ *================================================================
+ */
+
+static const t_setting_check checks[] = {
+  {"max_fps",           "17",           get_max_fps, NULL},
+  {"fade_time",         "1234",         get_fade_time, NULL},
+  {"sunrise_time",      "99",           get_sunrise_time, NULL},
+  {"drift_time",        "45",           get_drift_time, NULL},
+  {"clock_face",        "analog",       NULL, get_clock_face},
+  {"second_hand_fps",   "4",            get_second_hand_fps, NULL},
+  {"latency_budget",    "250",          get_latency_budget, NULL},
+  {"status_page",       "/tmp/st.page", NULL, get_status_page},
+  {"frame_deadline",    "5000",         get_frame_deadline, NULL},
+  {"watchdog_socket",   "/tmp/wd.sock", NULL, get_watchdog_socket},
+  {"menu_icon_file",    "/tmp/m.png",   NULL, get_menu_icon_file},
+  {"alarm_import_file", "/tmp/a.csv",   NULL, get_alarm_import_file},
+  {"render_budget",     "12",           get_render_budget, NULL}
+};
+
+#define NUM_CHECKS ((int) (sizeof(checks) / sizeof(checks[0])))
+
+/*
+ *================================================================
+ *
+ *  Forward declarations.
+ *
+ *================================================================
+ */
+
+static bool write_config(const char *directory);
+
+static int check_setting(const t_setting_check *check);
+
+/*
+ *================================================================
+ *
+ *  Stand-ins.
+ *
+ *================================================================
+ */
+
+void set_font_file_name(
+  t_font_size        which_font,
+  const yaml_char_t *file_name) {
+}
+
+void set_font_size(
+  t_font_size         which_font,
+  const yaml_char_t  *size_str) {
+}
+
+void dump_fonts(void) {
+}
+
+/*
+ *================================================================
+ *
+ *  Main.
+ *
+ *================================================================
+ */
+
+int main(int argc, char **argv) {
+  char directory[] = "/tmp/settings_testXXXXXX";
+  int  failures = 0;
+  int  i;
+  int  result = EXIT_FAILURE;
+
+  if (mkdtemp(directory) == NULL) {
+    perror("settings_test: mkdtemp");
+  } else {
+    if (!write_config(directory)) {
+      perror("settings_test: config.yaml");
+    } else if (!parse_config()) {
+      printf("settings_test: parse_config() failed\n");
+    } else {
+      for (i = 0; i < NUM_CHECKS; i++) {
+        failures += check_setting(checks + i);
+      }
+      printf("settings_test: %d settings, %d failures\n",
+             NUM_CHECKS,
+             failures);
+      if (failures == 0) {
+        result = EXIT_SUCCESS;
+      }
+    }
+    unlink("config.yaml");
+    rmdir(directory);
+  }
+  return result;
+}
+
+/*
+ *================================================================
+ *
+ *  Local routines.
+ *
+ *================================================================
+ */
+
+static bool write_config(const char *directory) {
+  /*
+   * parse_config() reads config.yaml from the current directory.
+   */
+  FILE *file;
+  int   i;
+  bool  result = FALSE;
+
+  if (chdir(directory) == 0) {
+    file = fopen("config.yaml", "w");
+    if (file != NULL) {
+      fprintf(file, "---\n:settings:\n");
+      for (i = 0; i < NUM_CHECKS; i++) {
+        fprintf(file, "  :%s: %s\n", checks[i].keyword, checks[i].value);
+      }
+      result = (fclose(file) == 0);
+    }
+  }
+  return result;
+}
+
+
+static int check_setting(const t_setting_check *check) {
+  /*
+   * 1 if the setting didn't come back as given.
+   */
+  const char *got_string;
+  int         got_int;
+  int         result = 0;
+
+  if (check->get_int != NULL) {
+    got_int = check->get_int();
+    if (got_int != atoi(check->value)) {
+      printf("settings_test: %s is %d, wanted %s\n",
+             check->keyword,
+             got_int,
+             check->value);
+      result = 1;
+    }
+  } else {
+    got_string = check->get_string();
+    if (strcmp(got_string, check->value) != 0) {
+      printf("settings_test: %s is \"%s\", wanted \"%s\"\n",
+             check->keyword,
+             got_string,
+             check->value);
+      result = 1;
+    }
+  }
+  return result;
+}
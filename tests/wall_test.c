@@ -0,0 +1,290 @@
+/*
+ *  Replays a few minutes of a three-display clock wall, headless and
+ *  fast, with an alarm on the middle display.  Checks from the clock's
+ *  log that every display showed each new minute in the same frame,
+ *  presented on the minute, and that the alarm went off on the middle
+ *  display and no other.
+ *
+ *  Runs the clock built alongside it, so needs SDL and the fonts.
+ *  Exits non-zero if anything disagrees.
+ */
+
+#define NEED_SDL
+#include "../includes.h"
+
+/*
+ *================================================================
+ *
+ *  Constants.
+ *
+ *================================================================
+ */
+
+#define START_TIME    1718000010      /* Half a minute in, UTC */
+#define REPLAY_MS     240000          /* From the first event to the last */
+#define WALL_DISPLAYS 3
+#define ALARM_DISPLAY 1
+#define ALARM_MINUTE  2               /* After the start */
+#define MAX_MINUTES   8
+#define MAX_LINE      256
+
+/*
+ *================================================================
+ *
+ *  Local data.
+ *
+ *================================================================
+ */
+
+static char directory[] = "/tmp/wall_testXXXXXX";
+
+static const char *file_names[] = {   /* What goes in it */
+  "config.yaml",
+  "events",
+  "control",
+  "state",
+  "status"
+};
+
+#define NUM_FILES ((int) (sizeof(file_names) / sizeof(file_names[0])))
+
+static long presented[WALL_DISPLAYS][MAX_MINUTES];  /* ms, 0 for not */
+static int  alarms[MAX_DISPLAYS];
+
+static int failures = 0;
+
+/*
+ *================================================================
+ *
+ *  Forward declarations.
+ *
+ *================================================================
+ */
+
+static bool write_config(void);
+
+static bool write_events(const char *file_name);
+
+static bool run_clock(const char *clock_name);
+
+static void read_line(const char *line);
+
+static void check_minutes(void);
+
+static void check_alarms(void);
+
+/*
+ *================================================================
+ *
+ *  Main.
+ *
+ *================================================================
+ */
+
+int main(int argc, char **argv) {
+  char clock_name[PATH_MAX + 1];
+  char file_name[PATH_MAX + 1];
+  int  i;
+  int  result = EXIT_FAILURE;
+
+  if ((getcwd(clock_name, sizeof(clock_name) - 6) == NULL) ||
+      (mkdtemp(directory) == NULL)) {
+    perror("wall_test");
+  } else {
+    strcat(clock_name, "/clock");
+    sprintf(file_name, "%s/events", directory);
+    if (!write_config() || !write_events(file_name)) {
+      perror("wall_test: writing");
+    } else if (run_clock(clock_name)) {
+      check_minutes();
+      check_alarms();
+      printf("wall_test: %d displays, %d failures\n",
+             WALL_DISPLAYS,
+             failures);
+      if (failures == 0) {
+        result = EXIT_SUCCESS;
+      }
+    }
+    for (i = 0; i < NUM_FILES; i++) {
+      sprintf(file_name, "%s/%s", directory, file_names[i]);
+      unlink(file_name);
+    }
+    rmdir(directory);
+  }
+  return result;
+}
+
+/*
+ *================================================================
+ *
+ *  Local routines.
+ *
+ *================================================================
+ */
+
+static bool write_config(void) {
+  /*
+   * Everything the clock keeps goes in the test's directory, so that
+   * it doesn't meet one which is really running.
+   */
+  FILE *file;
+  char  file_name[PATH_MAX + 1];
+  int   i;
+  bool  result = FALSE;
+
+  sprintf(file_name, "%s/config.yaml", directory);
+  file = fopen(file_name, "w");
+  if (file != NULL) {
+    fprintf(file, ":settings:\n");
+    fprintf(file, "  :control_socket: %s/control\n", directory);
+    fprintf(file, "  :state_journal: %s/state\n", directory);
+    fprintf(file, "  :status_page: %s/status\n", directory);
+    fprintf(file, "  :sunrise_time: 0\n");
+    fprintf(file, ":displays:\n");
+    for (i = 0; i < WALL_DISPLAYS; i++) {
+      fprintf(file, "  - :title: Panel %d\n", i);
+      fprintf(file, "    :screen_width: 320\n");
+      fprintf(file, "    :screen_height: 240\n");
+    }
+    fprintf(file, ":alarms:\n");
+    fprintf(file, "  - :time: %ld\n",
+            (long) (((START_TIME / 60 + ALARM_MINUTE) * 60) %
+                    SECONDS_PER_DAY));
+    fprintf(file, "    :display: %d\n", ALARM_DISPLAY);
+    result = (fclose(file) == 0);
+  }
+  return result;
+}
+
+
+static bool write_events(const char *file_name) {
+  /*
+   * Two key releases, which do nothing, REPLAY_MS apart - all the
+   * replay needs to know how long to run for.
+   */
+  SDL_Event event;
+  bool      result = FALSE;
+
+  if (record_start(file_name)) {
+    memset(&event, 0, sizeof(event));
+    event.type = SDL_KEYUP;
+    event.key.keysym.sym = SDLK_a;
+    event.common.timestamp = 1000;
+    vclock_set(START_TIME);
+    record_event(&event);
+    event.common.timestamp += REPLAY_MS;
+    vclock_set(START_TIME + REPLAY_MS / 1000);
+    record_event(&event);
+    record_stop();
+    result = TRUE;
+  }
+  return result;
+}
+
+
+static bool run_clock(const char *clock_name) {
+  char  command[3 * PATH_MAX];
+  char  line[MAX_LINE];
+  FILE *output;
+  bool  result = FALSE;
+
+  sprintf(command,
+          "cd %s && TZ=UTC %s --headless --replay events --fast 2>&1",
+          directory,
+          clock_name);
+  output = popen(command, "r");
+  if (output == NULL) {
+    perror("wall_test: popen");
+  } else {
+    while (fgets(line, sizeof(line), output) != NULL) {
+      read_line(line);
+    }
+    if (pclose(output) != 0) {
+      printf("wall_test: the clock failed\n");
+    } else {
+      result = TRUE;
+    }
+  }
+  return result;
+}
+
+
+static void read_line(const char *line) {
+  /*
+   * Picks out the frames each display showed a new minute in, and the
+   * alarms.
+   */
+  int         display;
+  long        minute;
+  long        ms;
+  const char *ptr;
+  long        seconds;
+
+  ptr = strstr(line, "Display ");
+  if ((ptr != NULL) &&
+      (sscanf(ptr, "Display %d showing minute %ld at %ld.%ld",
+              &display, &minute, &seconds, &ms) == 4)) {
+    minute -= START_TIME / 60;
+    if ((display >= 0) && (display < WALL_DISPLAYS) &&
+        (minute >= 0) && (minute < MAX_MINUTES)) {
+      presented[display][minute] = (seconds - START_TIME) * 1000 + ms;
+    }
+  }
+  ptr = strstr(line, "Alarm on display ");
+  if ((ptr != NULL) &&
+      (sscanf(ptr, "Alarm on display %d", &display) == 1) &&
+      (display >= 0) && (display < MAX_DISPLAYS)) {
+    alarms[display]++;
+  }
+}
+
+
+static void check_minutes(void) {
+  /*
+   * Every minute the replay went into, on every display, in the same
+   * frame and within its first second.
+   */
+  int  display;
+  long first;
+  int  minute;
+
+  for (minute = 1; minute <= REPLAY_MS / 60000; minute++) {
+    first = presented[0][minute];
+    for (display = 0; display < WALL_DISPLAYS; display++) {
+      if (presented[display][minute] == 0) {
+        printf("wall_test: display %d never showed minute %d\n",
+               display,
+               minute);
+        failures++;
+      } else if (presented[display][minute] != first) {
+        printf("wall_test: display %d showed minute %d at %ld ms, "
+               "display 0 at %ld ms\n",
+               display,
+               minute,
+               presented[display][minute],
+               first);
+        failures++;
+      }
+    }
+    if ((first / 1000 + START_TIME) % 60 != 0) {
+      printf("wall_test: minute %d presented %ld ms after the start\n",
+             minute,
+             first);
+      failures++;
+    }
+  }
+}
+
+
+static void check_alarms(void) {
+  int display;
+
+  for (display = 0; display < MAX_DISPLAYS; display++) {
+    if (alarms[display] != ((display == ALARM_DISPLAY) ? 1 : 0)) {
+      printf("wall_test: alarm went off %d times on display %d\n",
+             alarms[display],
+             display);
+      failures++;
+    }
+  }
+}
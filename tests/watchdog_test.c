@@ -0,0 +1,238 @@
+/*
+ *  Checks the frame watchdog (see watchdog.h) against a socket standing
+ *  in for whatever supervises the clock - READY=1 when it starts and
+ *  WATCHDOG=1 keepalives after that, none once the main loop has been
+ *  painting for longer than the frame deadline, a missed minute frame
+ *  counted once, and keepalives again when the frame's up.  Runs in
+ *  real time, so takes a few seconds.
+ *
+ *  Exits non-zero if anything disagrees.
+ */
+
+#include "../includes.h"
+
+/*
+ *================================================================
+ *
+ *  Constants.
+ *
+ *================================================================
+ */
+
+#define START_TIME   1718000040       /* On a minute */
+#define DEADLINE_MS  400
+#define TICK_MS      250              /* As in watchdog.c */
+#define KEEPALIVE_MS 1000
+#define MAX_MESSAGE  64
+
+/*
+ *================================================================
+ *
+ *  Local data.
+ *
+ *================================================================
+ */
+
+static char socket_name[PATH_MAX + 1];
+
+static int listener = -1;
+
+static int failures = 0;
+
+/*
+ *================================================================
+ *
+ *  Forward declarations.
+ *
+ *================================================================
+ */
+
+static void expect_message(const char *what, const char *wanted, int ms);
+
+static int count_messages(const char *wanted, int ms);
+
+static bool receive(char *message, int ms);
+
+static void expect_missed(const char *what, long wanted);
+
+static void pause_ms(int ms);
+
+static long elapsed_ms(const struct timespec *since);
+
+/*
+ *================================================================
+ *
+ *  Stand-ins.
+ *
+ *================================================================
+ */
+
+int get_frame_deadline(void) {
+  return DEADLINE_MS;
+}
+
+const char *get_watchdog_socket(void) {
+  return socket_name;
+}
+
+/*
+ *================================================================
+ *
+ *  Main.
+ *
+ *================================================================
+ */
+
+int main(int argc, char **argv) {
+  struct sockaddr_un address;
+  char               directory[] = "/tmp/watchdog_testXXXXXX";
+  int                result = EXIT_FAILURE;
+
+  if (mkdtemp(directory) == NULL) {
+    perror("watchdog_test: mkdtemp");
+  } else {
+    sprintf(socket_name, "%s/notify", directory);
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, socket_name);
+    listener = socket(AF_UNIX, SOCK_DGRAM, 0);
+    if ((listener < 0) ||
+        (bind(listener, (struct sockaddr *) &address, sizeof(address)) != 0)) {
+      perror("watchdog_test: socket");
+    } else {
+      vclock_set(START_TIME + 5);
+      watchdog_start();
+      expect_message("on starting", "READY=1", KEEPALIVE_MS);
+      expect_message("while all's well", "WATCHDOG=1", KEEPALIVE_MS + TICK_MS);
+      /*
+       * Stuck painting.  Anything sent before the watchdog noticed is
+       * thrown away.
+       */
+      watchdog_phase(wp_painting);
+      count_messages("WATCHDOG=1", DEADLINE_MS + 2 * TICK_MS);
+      if (count_messages("WATCHDOG=1", KEEPALIVE_MS + 2 * TICK_MS) != 0) {
+        printf("watchdog_test: keepalives carried on while stuck painting\n");
+        failures++;
+      }
+      expect_missed("before the minute", 0);
+      /*
+       * Still stuck as the next minute starts, so its frame is missed -
+       * and only counted the once.
+       */
+      vclock_set(START_TIME + 60);
+      pause_ms(DEADLINE_MS + 3 * TICK_MS);
+      expect_missed("once the next minute's frame is late", 1);
+      watchdog_phase(wp_presenting);
+      watchdog_presented(vclock_now());
+      watchdog_phase(wp_waiting);
+      expect_message("once the frame is up",
+                     "WATCHDOG=1",
+                     KEEPALIVE_MS + 2 * TICK_MS);
+      expect_missed("once the frame is up", 1);
+      watchdog_stop();
+      printf("watchdog_test: %d failures\n", failures);
+      if (failures == 0) {
+        result = EXIT_SUCCESS;
+      }
+    }
+    if (listener >= 0) {
+      close(listener);
+    }
+    unlink(socket_name);
+    rmdir(directory);
+  }
+  return result;
+}
+
+/*
+ *================================================================
+ *
+ *  Local routines.
+ *
+ *================================================================
+ */
+
+static void expect_message(const char *what, const char *wanted, int ms) {
+  bool            found = FALSE;
+  char            message[MAX_MESSAGE];
+  long            remaining;
+  struct timespec started;
+
+  clock_gettime(CLOCK_MONOTONIC, &started);
+  remaining = ms;
+  while (!found && (remaining > 0) && receive(message, (int) remaining)) {
+    found = (strcmp(message, wanted) == 0);
+    remaining = ms - elapsed_ms(&started);
+  }
+  if (!found) {
+    printf("watchdog_test: %s, no %s within %d ms\n", what, wanted, ms);
+    failures++;
+  }
+}
+
+
+static int count_messages(const char *wanted, int ms) {
+  /*
+   * How many of the given message arrive in the next so many ms.
+   */
+  int             count = 0;
+  char            message[MAX_MESSAGE];
+  long            remaining;
+  struct timespec started;
+
+  clock_gettime(CLOCK_MONOTONIC, &started);
+  remaining = ms;
+  while ((remaining > 0) && receive(message, (int) remaining)) {
+    if (strcmp(message, wanted) == 0) {
+      count++;
+    }
+    remaining = ms - elapsed_ms(&started);
+  }
+  return count;
+}
+
+
+static bool receive(char *message, int ms) {
+  ssize_t       length;
+  struct pollfd readable;
+  bool          result = FALSE;
+
+  readable.fd = listener;
+  readable.events = POLLIN;
+  if (poll(&readable, 1, ms) == 1) {
+    length = recv(listener, message, MAX_MESSAGE - 1, 0);
+    if (length >= 0) {
+      message[length] = '\0';
+      result = TRUE;
+    }
+  }
+  return result;
+}
+
+
+static void expect_missed(const char *what, long wanted) {
+  long got;
+
+  got = metric_value(metric_register("missed minute frames"));
+  if (got != wanted) {
+    printf("watchdog_test: %s, %ld missed minute frames, wanted %ld\n",
+           what,
+           got,
+           wanted);
+    failures++;
+  }
+}
+
+
+static void pause_ms(int ms) {
+  poll(NULL, 0, ms);
+}
+
+
+static long elapsed_ms(const struct timespec *since) {
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - since->tv_sec) * 1000L +
+         (now.tv_nsec - since->tv_nsec) / 1000000L;
+}
@@ -0,0 +1,287 @@
+/*
+ *  Checks zone.c against the C library over a whole year in several
+ *  time zones - zone_offset() and zone_local() against localtime_r(),
+ *  zone_utc() against mktime() - along with the rules in zone.h for
+ *  local times which are skipped or happen twice.
+ *
+ *  Exits non-zero if anything disagrees.
+ */
+
+#include "../includes.h"
+
+/*
+ *================================================================
+ *
+ *  Constants.
+ *
+ *================================================================
+ */
+
+#define SWEEP_STEP   (15 * 60)        /* Transitions fall on a quarter */
+#define SWEEP_YEAR   2024
+#define MAX_REPORTED 10               /* Failures shown per zone */
+
+/*
+ *================================================================
+ *
+ *  Local data.
+ *
+ *================================================================
+ */
+
+static const char *zones[] = {
+  "UTC",
+  "Europe/London",
+  "Europe/Dublin",                    /* Negative DST in newer tzdata */
+  "America/New_York",
+  "Australia/Sydney",                 /* Southern hemisphere */
+  "Australia/Lord_Howe",              /* Half-hour DST */
+  "Asia/Kolkata"                      /* Half-hour offset, no DST */
+};
+
+#define NUM_ZONES ((int) (sizeof(zones) / sizeof(zones[0])))
+
+static int failures;                  /* In the current zone */
+
+/*
+ *================================================================
+ *
+ *  Forward declarations.
+ *
+ *================================================================
+ */
+
+static void sweep_zone(const char *zone, int *checked, int *changes);
+
+static void check_moment(time_t when);
+
+static void check_transition(time_t before, time_t after);
+
+static time_t expected_utc(const struct tm *local);
+
+static int library_offset(time_t when);
+
+static void split_local(time_t local, int *day, int *seconds);
+
+static void fail(const char *what, time_t when, long got, long wanted);
+
+/*
+ *================================================================
+ *
+ *  Stand-ins.
+ *
+ *================================================================
+ */
+
+int identify_alarm_day(yaml_char_t *candidate) {
+  /*
+   * recurrence.o is only linked for day_number().
+   */
+  return -1;
+}
+
+/*
+ *================================================================
+ *
+ *  Main.
+ *
+ *================================================================
+ */
+
+int main(int argc, char **argv) {
+  int changes;
+  int checked;
+  int i;
+  int result = EXIT_SUCCESS;
+
+  for (i = 0; i < NUM_ZONES; i++) {
+    sweep_zone(zones[i], &checked, &changes);
+    printf("zone_test: %-20s %6d times, %d transitions, %d failures\n",
+           zones[i], checked, changes, failures);
+    if (failures > 0) {
+      result = EXIT_FAILURE;
+    }
+  }
+  return result;
+}
+
+/*
+ *================================================================
+ *
+ *  Local routines.
+ *
+ *================================================================
+ */
+
+static void sweep_zone(const char *zone, int *checked, int *changes) {
+  time_t    end;
+  time_t    previous;
+  time_t    start;
+  struct tm tm;
+  time_t    when;
+
+  setenv("TZ", zone, 1);
+  tzset();
+  zone_reset();
+  failures = 0;
+  *checked = 0;
+  *changes = 0;
+  memset(&tm, 0, sizeof(tm));
+  tm.tm_year = SWEEP_YEAR - 1900;
+  tm.tm_mday = 1;
+  tm.tm_isdst = -1;
+  start = mktime(&tm);
+  tm.tm_year++;
+  tm.tm_isdst = -1;
+  end = mktime(&tm);
+  previous = start;
+  for (when = start; when <= end; when += SWEEP_STEP) {
+    check_moment(when);
+    (*checked)++;
+    if (library_offset(when) != library_offset(previous)) {
+      check_transition(previous, when);
+      (*changes)++;
+    }
+    previous = when;
+  }
+}
+
+
+static void check_moment(time_t when) {
+  int       day;
+  int       seconds;
+  struct tm tm;
+  int       wanted_day;
+  int       wanted_seconds;
+
+  localtime_r(&when, &tm);
+  if (zone_offset(when) != library_offset(when)) {
+    fail("zone_offset", when, zone_offset(when), library_offset(when));
+  }
+  zone_local(when, &day, &seconds);
+  wanted_day = day_number(tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday);
+  wanted_seconds = (((tm.tm_hour * 60) + tm.tm_min) * 60) + tm.tm_sec;
+  if (day != wanted_day) {
+    fail("zone_local day", when, day, wanted_day);
+  }
+  if (seconds != wanted_seconds) {
+    fail("zone_local seconds", when, seconds, wanted_seconds);
+  }
+  if (zone_utc(wanted_day, wanted_seconds) != expected_utc(&tm)) {
+    fail("zone_utc",
+         when,
+         zone_utc(wanted_day, wanted_seconds),
+         expected_utc(&tm));
+  }
+}
+
+
+static void check_transition(time_t before, time_t after) {
+  /*
+   * Find the second the offset changes, then try the local times
+   * either side of it.  Going forward skips some - they should all
+   * come out as that second.  Going back repeats some - they should
+   * come out as the first time round, which the sweep has checked
+   * with mktime() already, so here it's just the edges.
+   */
+  int    day;
+  int    gap;
+  time_t middle;
+  int    new_offset;
+  int    old_offset;
+  int    seconds;
+
+  old_offset = library_offset(before);
+  while (after - before > 1) {
+    middle = before + ((after - before) / 2);
+    if (library_offset(middle) == old_offset) {
+      before = middle;
+    } else {
+      after = middle;
+    }
+  }
+  new_offset = library_offset(after);
+  gap = new_offset - old_offset;
+  if (gap > 0) {
+    split_local(after + old_offset, &day, &seconds);
+    if (zone_utc(day, seconds) != after) {
+      fail("zone_utc gap start", after, zone_utc(day, seconds), after);
+    }
+    split_local(after + old_offset + (gap / 2), &day, &seconds);
+    if (zone_utc(day, seconds) != after) {
+      fail("zone_utc gap middle", after, zone_utc(day, seconds), after);
+    }
+    split_local(after + new_offset - 1, &day, &seconds);
+    if (zone_utc(day, seconds) != after) {
+      fail("zone_utc gap end", after, zone_utc(day, seconds), after);
+    }
+  } else {
+    split_local(after + new_offset, &day, &seconds);
+    if (zone_utc(day, seconds) != after + gap) {
+      fail("zone_utc overlap start",
+           after,
+           zone_utc(day, seconds),
+           after + gap);
+    }
+    split_local(after + old_offset - 1, &day, &seconds);
+    if (zone_utc(day, seconds) != after - 1) {
+      fail("zone_utc overlap end", after, zone_utc(day, seconds), after - 1);
+    }
+  }
+}
+
+
+static time_t expected_utc(const struct tm *local) {
+  /*
+   * What mktime() makes of this local time, taking the earliest
+   * answer if it's one which happens twice.  Each guess at DST is
+   * tried, keeping only those which convert back to the same time.
+   */
+  struct tm back;
+  time_t    candidate;
+  int       dst;
+  time_t    result = (time_t) -1;
+  struct tm tm;
+
+  for (dst = -1; dst <= 1; dst++) {
+    tm = *local;
+    tm.tm_isdst = dst;
+    candidate = mktime(&tm);
+    localtime_r(&candidate, &back);
+    if ((back.tm_year == local->tm_year) &&
+        (back.tm_yday == local->tm_yday) &&
+        (back.tm_hour == local->tm_hour) &&
+        (back.tm_min == local->tm_min) &&
+        (back.tm_sec == local->tm_sec) &&
+        ((result == (time_t) -1) || (candidate < result))) {
+      result = candidate;
+    }
+  }
+  return result;
+}
+
+
+static int library_offset(time_t when) {
+  struct tm tm;
+
+  localtime_r(&when, &tm);
+  return tm.tm_gmtoff;
+}
+
+
+static void split_local(time_t local, int *day, int *seconds) {
+  *day = local / SECONDS_PER_DAY;
+  *seconds = local % SECONDS_PER_DAY;
+}
+
+
+static void fail(const char *what, time_t when, long got, long wanted) {
+  if (failures < MAX_REPORTED) {
+    printf("zone_test: %s at %ld gave %ld, wanted %ld\n",
+           what,
+           (long) when,
+           got,
+           wanted);
+  }
+  failures++;
+}
@@ -0,0 +1,271 @@
+/*
+ *  Tweens.  See tween.h.
+ */
+
+#include "includes.h"
+
+/*
+ *================================================================
+ *
+ *  Constants.
+ *
+ *================================================================
+ */
+
+#define MAX_TWEENS (8 * MAX_DISPLAYS)       /* A handful for each display */
+
+/*
+ *  e_smooth moves at up to one and a half times its average speed,
+ *  half way through.
+ */
+#define SMOOTH_PEAK_RATE 1.5
+
+/*
+ *================================================================
+ *
+ *  Local data.
+ *
+ *================================================================
+ */
+
+static t_tween *tweens[MAX_TWEENS];
+static int      num_tweens = 0;
+
+static double frame_time = 0.0;     /* Time the current frame shows */
+static double last_frame = 0.0;     /* When the last one was painted */
+
+/*
+ *================================================================
+ *
+ *  Forward declarations.
+ *
+ *================================================================
+ */
+
+static double monotonic_ms(void);
+
+static void retire(t_tween *tween, int value);
+
+/*
+ *================================================================
+ *
+ *  Externally visible routines.
+ *
+ *================================================================
+ */
+
+void tween_init(
+    t_tween    *tween,
+    const char *name,
+    t_easing    easing,
+    int         value) {
+  /*
+   * Once only for each tween, at start-up.  It sits at the given value
+   * until first started.
+   */
+  char metric_name[64];
+
+  memset(tween, 0, sizeof(t_tween));
+  tween->name = name;
+  tween->easing = easing;
+  tween->to = value;
+  snprintf(metric_name, sizeof(metric_name), "%s animations", name);
+  tween->runs_metric = metric_register(metric_name);
+  snprintf(metric_name, sizeof(metric_name), "%s frames", name);
+  tween->frames_metric = metric_register(metric_name);
+  if (num_tweens < MAX_TWEENS) {
+    tweens[num_tweens++] = tween;
+  } else {
+    LOG_Error("Too many tweens - \"%s\" won't animate.\n", name);
+  }
+}
+
+void tween_start(
+    t_tween *tween,
+    int      from,
+    int      to,
+    int      duration_ms) {
+  /*
+   * Starting one which is already running begins a fresh run.
+   */
+  if (tween->running) {
+    retire(tween, tween_value(tween));
+  }
+  tween->from = from;
+  tween->to = to;
+  tween->start = monotonic_ms();
+  tween->duration = (duration_ms > 0) ? duration_ms : 0;
+  tween->frames = 0;
+  tween->running = TRUE;
+}
+
+void tween_stop(t_tween *tween) {
+  /*
+   * Leaves it where it is now.
+   */
+  if (tween->running) {
+    retire(tween, tween_value(tween));
+  }
+}
+
+void tween_set(t_tween *tween, int value) {
+  /*
+   * Jump straight there.
+   */
+  tween_stop(tween);
+  tween->to = value;
+}
+
+bool tween_running(const t_tween *tween) {
+  return tween->running;
+}
+
+bool tween_arrived(const t_tween *tween) {
+  /*
+   * TRUE if it's stopped or the current frame is its final one.
+   */
+  return !tween->running ||
+         (frame_time >= tween->start + tween->duration);
+}
+
+int tween_value(const t_tween *tween) {
+  /*
+   * As at the time of the current frame.
+   */
+  double progress;
+  int    result;
+
+  if (!tween->running) {
+    result = tween->to;
+  } else {
+    if (tween->duration <= 0.0) {
+      progress = 1.0;
+    } else {
+      progress = (frame_time - tween->start) / tween->duration;
+      if (progress < 0.0) {
+        progress = 0.0;
+      } else if (progress > 1.0) {
+        progress = 1.0;
+      }
+    }
+    if (tween->easing == e_smooth) {
+      progress = progress * progress * (3.0 - 2.0 * progress);
+    }
+    result = tween->from + (int) ((tween->to - tween->from) * progress +
+                                  ((tween->to > tween->from) ? 0.5 : -0.5));
+  }
+  return result;
+}
+
+void tween_sample(void) {
+  /*
+   * Fix the time which the frame about to be painted represents.
+   */
+  frame_time = monotonic_ms();
+}
+
+void tween_painted(void) {
+  /*
+   * Called once the frame is on the screen.  Anything which has now
+   * shown its final value is finished with.
+   */
+  int      i;
+  t_tween *tween;
+
+  last_frame = frame_time;
+  for (i = 0; i < num_tweens; i++) {
+    tween = tweens[i];
+    if (tween->running) {
+      tween->frames++;
+      if (frame_time >= tween->start + tween->duration) {
+        retire(tween, tween->to);
+      }
+    }
+  }
+}
+
+int tween_wait_time(void) {
+  /*
+   * Milliseconds until the next frame is wanted, 0 if it's due now,
+   * or -1 if nothing is moving.
+   */
+  double   gap;
+  int      i;
+  double   interval;
+  int      ms;
+  double   now;
+  int      result = -1;
+  double   step;
+  int      steps;
+  t_tween *tween;
+  double   wait;
+
+  now = monotonic_ms();
+  interval = (get_max_fps() > 0) ? 1000.0 / get_max_fps() : 0.0;
+  for (i = 0; i < num_tweens; i++) {
+    tween = tweens[i];
+    if (tween->running) {
+      if (now >= tween->start + tween->duration) {
+        /*
+         * Still owes its final frame.
+         */
+        wait = 0.0;
+      } else {
+        /*
+         * No point drawing until the value has moved on by one.
+         */
+        steps = abs(tween->to - tween->from);
+        step = (steps > 0) ? tween->duration / steps : tween->duration;
+        if (tween->easing == e_smooth) {
+          step /= SMOOTH_PEAK_RATE;
+        }
+        gap = (step > interval) ? step : interval;
+        wait = (last_frame + gap) - now;
+        if (wait > (tween->start + tween->duration) - now) {
+          wait = (tween->start + tween->duration) - now;
+        }
+        if (wait < 0.0) {
+          wait = 0.0;
+        }
+      }
+      /*
+       * Rounded up - waking early would just mean going round again.
+       */
+      ms = (int) wait;
+      if (wait > ms) {
+        ms++;
+      }
+      if ((result < 0) || (ms < result)) {
+        result = ms;
+      }
+    }
+  }
+  return result;
+}
+
+/*
+ *================================================================
+ *
+ *  Local routines.
+ *
+ *================================================================
+ */
+
+static double monotonic_ms(void) {
+  struct timespec now;
+
+  vclock_monotonic(&now);
+  return (now.tv_sec * 1000.0) + (now.tv_nsec / 1000000.0);
+}
+
+
+static void retire(t_tween *tween, int value) {
+  tween->running = FALSE;
+  tween->to = value;
+  metric_add(tween->runs_metric, 1);
+  metric_add(tween->frames_metric, tween->frames);
+  QLOG_Debug(("Animation \"%s\" - %ld frames in %.0f ms.\n",
+              tween->name,
+              tween->frames,
+              tween->duration));
+}
@@ -0,0 +1,73 @@
+/*
+ *  Tweens - integer values which move from one setting to another
+ *  over a given time, such as the screen's brightness during a fade.
+ *
+ *  The main loop asks tween_wait_time() how long it can sleep.  While
+ *  nothing is moving the answer is "for ever" and no frames are drawn
+ *  at all.  While something is, frames are asked for only as often as
+ *  a value will actually have changed, and never faster than the
+ *  configured maximum frame rate.  All the values in one frame are
+ *  taken at the same instant - see tween_sample().
+ */
+
+/*
+ *================================================================
+ *
+ *  Type definitions.
+ *
+ *================================================================
+ */
+
+typedef enum {
+  e_linear,
+  e_smooth                    /* Eases in and out */
+} t_easing;
+
+typedef struct {
+  const char *name;
+  t_easing    easing;
+  bool        running;
+  int         from;
+  int         to;             /* And the value once stopped */
+  double      start;          /* Monotonic milliseconds */
+  double      duration;
+  long        frames;         /* Painted during this run */
+  t_metric    runs_metric;
+  t_metric    frames_metric;
+} t_tween;
+
+/*
+ *================================================================
+ *
+ *  External declarations.
+ *
+ *================================================================
+ */
+
+extern void tween_init(
+    t_tween    *tween,
+    const char *name,
+    t_easing    easing,
+    int         value);
+
+extern void tween_start(
+    t_tween *tween,
+    int      from,
+    int      to,
+    int      duration_ms);
+
+extern void tween_stop(t_tween *tween);
+
+extern void tween_set(t_tween *tween, int value);
+
+extern bool tween_running(const t_tween *tween);
+
+extern bool tween_arrived(const t_tween *tween);
+
+extern int tween_value(const t_tween *tween);
+
+extern void tween_sample(void);
+
+extern void tween_painted(void);
+
+extern int tween_wait_time(void);
@@ -1,5 +1,7 @@
 #include "includes.h"
 
+#define FNV_PRIME 16777619UL
+
 void safe_copy(
     char       *dest,
     const char *src,
@@ -21,4 +23,30 @@ int integer(const char *string) {
 }
 
 
+int random_offset(int range) {
+  /*
+   * A random number in the range 0..range inclusive.  A negative range
+   * (something bigger than the space available) just gives 0.
+   */
+  if (range <= 0) {
+    return 0;
+  } else {
+    return rand() % (range + 1);
+  }
+}
+
+
+unsigned long hash_fold(unsigned long hash, unsigned long value) {
+  /*
+   * 32-bit FNV-1a, starting from HASH_START.  The low 32 bits of the
+   * value go in a byte at a time so that the hash comes out the same
+   * whatever the size of a long.
+   */
+  int i;
 
+  for (i = 0; i < 4; i++) {
+    hash = ((hash ^ (value & 0xff)) * FNV_PRIME) & 0xffffffffUL;
+    value >>= 8;
+  }
+  return hash;
+}
@@ -1,3 +1,14 @@
+/*
+ *================================================================
+ *
+ *  Constants.
+ *
+ *================================================================
+ */
+
+#define SECONDS_PER_DAY 86400
+#define HASH_START      2166136261UL  /* For hash_fold() */
+
 /*
  *================================================================
  *
@@ -27,4 +38,8 @@ extern void safe_copy(
 
 extern int integer(const char *string);
 
+extern int random_offset(int range);
+
+extern unsigned long hash_fold(unsigned long hash, unsigned long value);
+
 
@@ -0,0 +1,126 @@
+/*
+ *  Virtual clock.  See vclock.h.
+ */
+
+#include "includes.h"
+
+/*
+ *================================================================
+ *
+ *  Constants.
+ *
+ *================================================================
+ */
+
+#define NS_PER_SECOND 1000000000L
+
+/*
+ *================================================================
+ *
+ *  Local data.
+ *
+ *================================================================
+ */
+
+static struct timespec offset = { 0, 0 };   /* Virtual time less real */
+static struct timespec skew = { 0, 0 };     /* Same for monotonic time */
+
+/*
+ *================================================================
+ *
+ *  Forward declarations.
+ *
+ *================================================================
+ */
+
+static void add_time(struct timespec *sum, time_t sec, long nsec);
+
+/*
+ *================================================================
+ *
+ *  Externally visible routines.
+ *
+ *================================================================
+ */
+
+void vclock_init(void) {
+  const char *start;
+  struct tm   tm;
+
+  start = getenv("ALARMCLOCK_TIME");
+  if (start != NULL) {
+    memset(&tm, 0, sizeof(tm));
+    if (strptime(start, "%Y-%m-%d %H:%M:%S", &tm) == NULL) {
+      LOG_Error("Can't make sense of ALARMCLOCK_TIME \"%s\".\n", start);
+    } else {
+      tm.tm_isdst = -1;
+      vclock_set(mktime(&tm));
+      LOG_Info("Running with the clock set to %s.\n", start);
+    }
+  }
+}
+
+time_t vclock_now(void) {
+  struct timespec now;
+
+  vclock_gettime(&now);
+  return now.tv_sec;
+}
+
+void vclock_gettime(struct timespec *now) {
+  clock_gettime(CLOCK_REALTIME, now);
+  add_time(now, offset.tv_sec, offset.tv_nsec);
+}
+
+void vclock_monotonic(struct timespec *now) {
+  clock_gettime(CLOCK_MONOTONIC, now);
+  add_time(now, skew.tv_sec, skew.tv_nsec);
+}
+
+void vclock_set(time_t when) {
+  /*
+   * The clock carries on running from the given time.
+   */
+  struct timespec exact;
+
+  exact.tv_sec = when;
+  exact.tv_nsec = 0;
+  vclock_settime(&exact);
+}
+
+void vclock_settime(const struct timespec *when) {
+  struct timespec now;
+
+  clock_gettime(CLOCK_REALTIME, &now);
+  offset = *when;
+  add_time(&offset, -now.tv_sec, -now.tv_nsec);
+}
+
+void vclock_advance(long ms) {
+  add_time(&offset, ms / 1000, (ms % 1000) * 1000000L);
+  add_time(&skew, ms / 1000, (ms % 1000) * 1000000L);
+}
+
+/*
+ *================================================================
+ *
+ *  Local routines.
+ *
+ *================================================================
+ */
+
+static void add_time(struct timespec *sum, time_t sec, long nsec) {
+  /*
+   * Keeps tv_nsec between 0 and a second, whatever the signs.
+   */
+  sum->tv_sec += sec;
+  sum->tv_nsec += nsec;
+  while (sum->tv_nsec >= NS_PER_SECOND) {
+    sum->tv_nsec -= NS_PER_SECOND;
+    sum->tv_sec++;
+  }
+  while (sum->tv_nsec < 0) {
+    sum->tv_nsec += NS_PER_SECOND;
+    sum->tv_sec--;
+  }
+}
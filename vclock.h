@@ -0,0 +1,33 @@
+/*
+ *  The clock as far as the rest of the program is concerned.  Normally
+ *  just the real time, but it can be shifted to any other time so that
+ *  things like daylight saving changes can be tried out without waiting
+ *  for them.  Setting ALARMCLOCK_TIME="YYYY-MM-DD HH:MM:SS" in the
+ *  environment starts the clock at that local time.
+ *
+ *  There's a monotonic clock to go with it, for timing animations.
+ *  vclock_advance() moves both on at once, which is how a replay runs
+ *  faster than real time - see replay.h.
+ */
+
+/*
+ *================================================================
+ *
+ *  External declarations.
+ *
+ *================================================================
+ */
+
+extern void vclock_init(void);
+
+extern time_t vclock_now(void);
+
+extern void vclock_gettime(struct timespec *now);
+
+extern void vclock_monotonic(struct timespec *now);
+
+extern void vclock_set(time_t when);
+
+extern void vclock_settime(const struct timespec *when);
+
+extern void vclock_advance(long ms);
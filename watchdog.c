@@ -0,0 +1,244 @@
+/*
+ *  Frame watchdog.  See watchdog.h.
+ *
+ *  The main loop only ever stores to the few words below; everything
+ *  else happens in the watchdog's thread.
+ */
+
+#include "includes.h"
+
+/*
+ *================================================================
+ *
+ *  Constants.
+ *
+ *================================================================
+ */
+
+#define WATCHDOG_TICK_MS 250
+#define KEEPALIVE_MS     1000
+
+/*
+ *================================================================
+ *
+ *  Local data.
+ *
+ *================================================================
+ */
+
+static const char *phase_names[NUM_WATCH_PHASES] = {
+  "waiting",
+  "events",
+  "alarms",
+  "painting",
+  "presenting"
+};
+
+static volatile int           current_phase = wp_waiting;
+static volatile unsigned long phase_entered = 0;    /* Monotonic ms */
+static volatile long          presented_minute = 0; /* time_t / 60 */
+
+static bool               started = FALSE;
+static volatile bool      stopping = FALSE;
+static pthread_t          watcher;
+static int                wake_pipe[2];
+static int                notify_fd = -1;
+static struct sockaddr_un notify_address;
+static socklen_t          notify_length;
+
+static t_metric missed_metric = NO_METRIC;
+static t_metric keepalive_metric = NO_METRIC;
+
+/*
+ *================================================================
+ *
+ *  Forward declarations.
+ *
+ *================================================================
+ */
+
+static void *watcher_main(void *unused);
+
+static bool check_frames(long *missed_minute);
+
+static void open_notify_socket(void);
+
+static void notify(const char *message);
+
+static unsigned long monotonic_ms(void);
+
+/*
+ *================================================================
+ *
+ *  Externally visible routines.
+ *
+ *================================================================
+ */
+
+void watchdog_start(void) {
+  /*
+   * The minute we start in gets a free pass - it may well not be
+   * painted again until the next one.
+   */
+  if (get_frame_deadline() > 0) {
+    missed_metric = metric_register("missed minute frames");
+    keepalive_metric = metric_register("watchdog keepalives");
+    presented_minute = vclock_now() / 60;
+    phase_entered = monotonic_ms();
+    open_notify_socket();
+    if (pipe(wake_pipe) != 0) {
+      LOG_Error("Failed to set up watchdog.\n");
+    } else if (pthread_create(&watcher, NULL, watcher_main, NULL) != 0) {
+      LOG_Error("Failed to start watchdog thread.\n");
+      close(wake_pipe[0]);
+      close(wake_pipe[1]);
+    } else {
+      started = TRUE;
+      notify("READY=1");
+    }
+  }
+}
+
+void watchdog_stop(void) {
+  if (started) {
+    started = FALSE;
+    stopping = TRUE;
+    write(wake_pipe[1], "", 1);
+    pthread_join(watcher, NULL);
+    close(wake_pipe[0]);
+    close(wake_pipe[1]);
+    notify("STOPPING=1");
+  }
+  if (notify_fd >= 0) {
+    close(notify_fd);
+    notify_fd = -1;
+  }
+}
+
+void watchdog_phase(t_watch_phase phase) {
+  phase_entered = monotonic_ms();
+  __sync_synchronize();
+  current_phase = phase;
+}
+
+void watchdog_presented(time_t shown) {
+  presented_minute = shown / 60;
+}
+
+/*
+ *================================================================
+ *
+ *  Local routines.
+ *
+ *================================================================
+ */
+
+static void *watcher_main(void *unused) {
+  unsigned long last_keepalive;
+  long          missed_minute = -1;
+  unsigned long now;
+  struct pollfd wake;
+
+  last_keepalive = monotonic_ms() - KEEPALIVE_MS;
+  wake.fd = wake_pipe[0];
+  wake.events = POLLIN;
+  while (!stopping) {
+    poll(&wake, 1, WATCHDOG_TICK_MS);
+    if (!stopping && check_frames(&missed_minute)) {
+      now = monotonic_ms();
+      if (now - last_keepalive >= KEEPALIVE_MS) {
+        notify("WATCHDOG=1");
+        last_keepalive = now;
+      }
+    }
+  }
+  return unused;
+}
+
+
+static bool check_frames(long *missed_minute) {
+  /*
+   * Returns TRUE if the main loop looks healthy - this minute's frame
+   * is either up or not due yet, and nothing but waiting has taken
+   * longer than the deadline.  Each missed minute is reported once.
+   */
+  int             deadline;
+  long            into;
+  bool            late;
+  long            minute;
+  struct timespec now;
+  int             phase;
+  long            stuck_for;
+
+  deadline = get_frame_deadline();
+  vclock_gettime(&now);
+  minute = now.tv_sec / 60;
+  into = (now.tv_sec % 60) * 1000 + now.tv_nsec / 1000000;
+  phase = current_phase;
+  __sync_synchronize();
+  stuck_for = (long) (monotonic_ms() - phase_entered);
+  late = (presented_minute < minute) && (into >= deadline);
+  if (late && (minute != *missed_minute)) {
+    *missed_minute = minute;
+    metric_add(missed_metric, 1);
+    QLOG_Warning(("Minute frame not presented after %ld ms - "
+                  "main loop %s for %ld ms.\n",
+                  into,
+                  phase_names[phase],
+                  stuck_for));
+  }
+  return !late && ((phase == wp_waiting) || (stuck_for < deadline));
+}
+
+
+static void open_notify_socket(void) {
+  const char *path;
+
+  path = get_watchdog_socket();
+  if (*path == '\0') {
+    path = getenv("NOTIFY_SOCKET");
+  }
+  if ((path != NULL) && (*path != '\0')) {
+    memset(&notify_address, 0, sizeof(notify_address));
+    notify_address.sun_family = AF_UNIX;
+    safe_copy(notify_address.sun_path,
+              path,
+              sizeof(notify_address.sun_path) - 1,
+              "Watchdog socket");
+    notify_length = offsetof(struct sockaddr_un, sun_path) + strlen(path);
+    if (*path == '@') {
+      notify_address.sun_path[0] = '\0';
+    } else {
+      notify_length++;
+    }
+    notify_fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+    if (notify_fd < 0) {
+      LOG_Error("Failed to open watchdog socket \"%s\".\n", path);
+    }
+  }
+}
+
+
+static void notify(const char *message) {
+  if ((notify_fd >= 0) &&
+      (sendto(notify_fd,
+              message,
+              strlen(message),
+              MSG_DONTWAIT | MSG_NOSIGNAL,
+              (struct sockaddr *) &notify_address,
+              notify_length) >= 0)) {
+    metric_add(keepalive_metric, 1);
+  }
+}
+
+
+static unsigned long monotonic_ms(void) {
+  /*
+   * Wraps after a month or so with a 32-bit long, so only differences
+   * between these mean anything.
+   */
+  struct timespec now;
+
+  vclock_monotonic(&now);
+  return now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
@@ -0,0 +1,46 @@
+/*
+ *  Frame watchdog.  A thread of its own checks that the frame for each
+ *  new minute is presented within the frame_deadline setting of the
+ *  minute starting.  A miss is counted and logged along with the part
+ *  of the main loop it was stuck in, and how long for.
+ *
+ *  While all's well it also sends sd_notify() style "WATCHDOG=1"
+ *  keepalives to a Unix datagram socket - the watchdog_socket setting,
+ *  or $NOTIFY_SOCKET if that's empty - and stops sending them as soon
+ *  as the main loop isn't, so whatever's supervising us can restart a
+ *  wedged clock.  A path starting with '@' is in the abstract
+ *  namespace.
+ */
+
+/*
+ *================================================================
+ *
+ *  Type definitions.
+ *
+ *================================================================
+ */
+
+typedef enum {
+  wp_waiting,                 /* For an event or a timeout */
+  wp_events,
+  wp_alarms,
+  wp_painting,
+  wp_presenting,
+  NUM_WATCH_PHASES
+} t_watch_phase;
+
+/*
+ *================================================================
+ *
+ *  External declarations.
+ *
+ *================================================================
+ */
+
+extern void watchdog_start(void);
+
+extern void watchdog_stop(void);
+
+extern void watchdog_phase(t_watch_phase phase);
+
+extern void watchdog_presented(time_t shown);
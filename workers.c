@@ -0,0 +1,166 @@
+/*
+ *  Start-up worker pool.
+ *
+ *  This is only used during start-up so a plain mutex and condition
+ *  variables are fine.  If the threads can't be started, jobs are
+ *  simply run in line by worker_submit().
+ */
+
+#include "includes.h"
+
+/*
+ *================================================================
+ *
+ *  Constants.
+ *
+ *================================================================
+ */
+
+#define MAX_WORKERS 4
+#define MAX_QUEUED  16
+
+/*
+ *================================================================
+ *
+ *  Local data.
+ *
+ *================================================================
+ */
+
+static pthread_t workers[MAX_WORKERS];
+static int       num_workers = 0;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  work_available = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t  work_done = PTHREAD_COND_INITIALIZER;
+
+static t_job *queue[MAX_QUEUED];
+static int    queue_head = 0;
+static int    queue_length = 0;
+static bool   stopping = FALSE;
+
+/*
+ *================================================================
+ *
+ *  Forward declarations.
+ *
+ *================================================================
+ */
+
+static void *worker_main(void *unused);
+
+static void run_job(t_job *job);
+
+/*
+ *================================================================
+ *
+ *  Externally visible routines.
+ *
+ *================================================================
+ */
+
+void workers_start(int count) {
+  if (count > MAX_WORKERS) {
+    count = MAX_WORKERS;
+  }
+  stopping = FALSE;
+  while (num_workers < count) {
+    if (pthread_create(workers + num_workers, NULL, worker_main, NULL) != 0) {
+      LOG_Warning("Failed to start worker thread.\n");
+      break;
+    }
+    num_workers++;
+  }
+}
+
+void workers_stop(void) {
+  /*
+   * Waits for anything queued to finish first.
+   */
+  int i;
+
+  pthread_mutex_lock(&lock);
+  stopping = TRUE;
+  pthread_cond_broadcast(&work_available);
+  pthread_mutex_unlock(&lock);
+  for (i = 0; i < num_workers; i++) {
+    pthread_join(workers[i], NULL);
+  }
+  num_workers = 0;
+}
+
+void worker_submit(
+    t_job          *job,
+    const char     *name,
+    t_job_function  function,
+    void           *arg) {
+
+  bool queued = FALSE;
+
+  job->name = name;
+  job->function = function;
+  job->arg = arg;
+  job->done = FALSE;
+  pthread_mutex_lock(&lock);
+  if ((num_workers > 0) && !stopping && (queue_length < MAX_QUEUED)) {
+    queue[(queue_head + queue_length) % MAX_QUEUED] = job;
+    queue_length++;
+    pthread_cond_signal(&work_available);
+    queued = TRUE;
+  }
+  pthread_mutex_unlock(&lock);
+  if (!queued) {
+    run_job(job);
+  }
+}
+
+void worker_join(t_job *job) {
+  pthread_mutex_lock(&lock);
+  while (!job->done) {
+    pthread_cond_wait(&work_done, &lock);
+  }
+  pthread_mutex_unlock(&lock);
+}
+
+/*
+ *================================================================
+ *
+ *  Local routines.
+ *
+ *================================================================
+ */
+
+static void *worker_main(void *unused) {
+  t_job *job;
+
+  pthread_mutex_lock(&lock);
+  while (TRUE) {
+    if (queue_length > 0) {
+      job = queue[queue_head];
+      queue_head = (queue_head + 1) % MAX_QUEUED;
+      queue_length--;
+      pthread_mutex_unlock(&lock);
+      run_job(job);
+      pthread_mutex_lock(&lock);
+    } else if (stopping) {
+      break;
+    } else {
+      pthread_cond_wait(&work_available, &lock);
+    }
+  }
+  pthread_mutex_unlock(&lock);
+  return NULL;
+}
+
+
+static void run_job(t_job *job) {
+  int phase;
+
+  phase = startup_phase_begin(job->name);
+  job->function(job->arg);
+  startup_phase_end(phase);
+  pthread_mutex_lock(&lock);
+  job->done = TRUE;
+  pthread_cond_broadcast(&work_done);
+  pthread_mutex_unlock(&lock);
+}
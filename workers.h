@@ -0,0 +1,42 @@
+/*
+ *  A small pool of worker threads used to run the independent parts
+ *  of start-up concurrently.  Jobs are owned by the caller - typically
+ *  static - so submitting one doesn't allocate.
+ */
+
+/*
+ *================================================================
+ *
+ *  Type definitions.
+ *
+ *================================================================
+ */
+
+typedef void (*t_job_function)(void *arg);
+
+typedef struct {
+  const char     *name;       /* Used as the start-up phase name */
+  t_job_function  function;
+  void           *arg;
+  bool            done;
+} t_job;
+
+/*
+ *================================================================
+ *
+ *  External declarations.
+ *
+ *================================================================
+ */
+
+extern void workers_start(int count);
+
+extern void workers_stop(void);
+
+extern void worker_submit(
+    t_job          *job,
+    const char     *name,
+    t_job_function  function,
+    void           *arg);
+
+extern void worker_join(t_job *job);
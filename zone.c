@@ -0,0 +1,245 @@
+/*
+ *  Local time zone.  See zone.h.
+ */
+
+#include "includes.h"
+
+/*
+ *================================================================
+ *
+ *  Constants.
+ *
+ *================================================================
+ */
+
+#define MAX_TRANSITIONS  32
+#define WINDOW_DAYS      400
+#define WINDOW_LEAD_DAYS 2            /* Start this far before asked for */
+
+/*
+ *  Transitions are found by checking the offset once a day and then
+ *  homing in on the second it changed.  Two in the same day would be
+ *  missed, but no zone does that.
+ */
+#define PROBE_STEP       SECONDS_PER_DAY
+
+/*
+ *================================================================
+ *
+ *  Type definitions.
+ *
+ *================================================================
+ */
+
+typedef struct {
+  time_t at;                  /* First second of the new offset */
+  int    before;
+  int    after;
+} t_transition;
+
+/*
+ *================================================================
+ *
+ *  Local data.
+ *
+ *================================================================
+ */
+
+static t_transition transitions[MAX_TRANSITIONS];
+static int          num_transitions = 0;
+static bool         window_valid = FALSE;
+static time_t       window_start;
+static time_t       window_end;
+static int          base_offset;            /* At window_start */
+
+/*
+ *================================================================
+ *
+ *  Forward declarations.
+ *
+ *================================================================
+ */
+
+static void build_window(time_t around);
+
+static int probe_offset(time_t when);
+
+static int transition_after(time_t when);
+
+/*
+ *================================================================
+ *
+ *  Externally visible routines.
+ *
+ *================================================================
+ */
+
+int zone_offset(time_t when) {
+  /*
+   * Seconds to add to UTC to get local time at this moment.
+   */
+  int index;
+  int result;
+
+  if (!window_valid || (when < window_start) || (when >= window_end)) {
+    build_window(when);
+  }
+  index = transition_after(when) - 1;
+  if (index < 0) {
+    result = base_offset;
+  } else {
+    result = transitions[index].after;
+  }
+  return result;
+}
+
+void zone_local(time_t when, int *day, int *seconds) {
+  /*
+   * The local day number (as recurrence.h) and seconds since local
+   * midnight.
+   */
+  time_t local;
+
+  local = when + zone_offset(when);
+  *day = local / SECONDS_PER_DAY;
+  if ((local % SECONDS_PER_DAY) < 0) {
+    (*day)--;
+  }
+  *seconds = local - ((time_t) *day * SECONDS_PER_DAY);
+}
+
+time_t zone_utc(int day, int seconds) {
+  /*
+   * When is this local time?  Transitions are months apart so the
+   * offsets a day either side are the only two it could be using.
+   */
+  time_t early;
+  bool   early_ok;
+  int    index;
+  time_t late;
+  bool   late_ok;
+  time_t local;
+  time_t result;
+
+  local = ((time_t) day * SECONDS_PER_DAY) + seconds;
+  early = local - zone_offset(local - SECONDS_PER_DAY);
+  late = local - zone_offset(local + SECONDS_PER_DAY);
+  early_ok = (early + zone_offset(early) == local);
+  late_ok = (late + zone_offset(late) == local);
+  if (early_ok && late_ok) {
+    /*
+     * Normally the same.  If not, it's happening twice.
+     */
+    result = (early < late) ? early : late;
+  } else if (early_ok) {
+    result = early;
+  } else if (late_ok) {
+    result = late;
+  } else {
+    /*
+     * Skipped over.  Use the moment of the jump.
+     */
+    result = (early < late) ? early : late;
+    zone_offset(result);
+    index = transition_after(result);
+    if (index < num_transitions) {
+      result = transitions[index].at;
+    }
+  }
+  return result;
+}
+
+void zone_reset(void) {
+  /*
+   * Forget what we know - the zone may have changed.
+   */
+  window_valid = FALSE;
+}
+
+/*
+ *================================================================
+ *
+ *  Local routines.
+ *
+ *================================================================
+ */
+
+static void build_window(time_t around) {
+  time_t high;
+  time_t low;
+  time_t middle;
+  int    offset;
+  int    previous;
+  time_t probe;
+
+  num_transitions = 0;
+  window_start = around - (WINDOW_LEAD_DAYS * SECONDS_PER_DAY);
+  window_end = window_start + ((time_t) WINDOW_DAYS * SECONDS_PER_DAY);
+  base_offset = probe_offset(window_start);
+  previous = base_offset;
+  for (probe = window_start + PROBE_STEP;
+       probe < window_end;
+       probe += PROBE_STEP) {
+    offset = probe_offset(probe);
+    if (offset != previous) {
+      if (num_transitions == MAX_TRANSITIONS) {
+        window_end = probe - PROBE_STEP;
+        break;
+      }
+      low = probe - PROBE_STEP;
+      high = probe;
+      while (high - low > 1) {
+        middle = low + ((high - low) / 2);
+        if (probe_offset(middle) == previous) {
+          low = middle;
+        } else {
+          high = middle;
+        }
+      }
+      transitions[num_transitions].at = high;
+      transitions[num_transitions].before = previous;
+      transitions[num_transitions].after = offset;
+      num_transitions++;
+      QLOG_Debug(("Zone offset goes from %d to %d at %ld.\n",
+                  previous, offset, (long) high));
+      previous = offset;
+    }
+  }
+  window_valid = TRUE;
+}
+
+
+static int probe_offset(time_t when) {
+  /*
+   * Ask the C library.  Only used to fill the cache.
+   */
+  struct tm tm;
+
+  localtime_r(&when, &tm);
+  return (time_t) day_number(tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday) *
+         SECONDS_PER_DAY +
+         (((tm.tm_hour * 60) + tm.tm_min) * 60) + tm.tm_sec - when;
+}
+
+
+static int transition_after(time_t when) {
+  /*
+   * Index of the first transition after this moment, or
+   * num_transitions if there isn't one in the window.
+   */
+  int high;
+  int low;
+  int middle;
+
+  low = 0;
+  high = num_transitions;
+  while (low < high) {
+    middle = (low + high) / 2;
+    if (transitions[middle].at <= when) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  return low;
+}
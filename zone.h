@@ -0,0 +1,25 @@
+/*
+ *  Local time zone.  The zone's changes of UTC offset over the coming
+ *  year or so are found once and kept, so converting between UTC and
+ *  local time is then just arithmetic.
+ *
+ *  A local time which falls in the gap when the clocks go forward is
+ *  taken to be the moment they jump, and one which happens twice when
+ *  they go back is taken to be the first of the two.
+ */
+
+/*
+ *================================================================
+ *
+ *  External declarations.
+ *
+ *================================================================
+ */
+
+extern int zone_offset(time_t when);
+
+extern void zone_local(time_t when, int *day, int *seconds);
+
+extern time_t zone_utc(int day, int seconds);
+
+extern void zone_reset(void);